@@ -15,53 +15,23 @@ G_PASTE(g_io_module_, G_PASTE(name, _load_static)) ()
 
 /* Declaration of static plugins */
   GST_PLUGIN_STATIC_DECLARE(coreelements);
-  GST_PLUGIN_STATIC_DECLARE(app);
   GST_PLUGIN_STATIC_DECLARE(audioconvert);
-  GST_PLUGIN_STATIC_DECLARE(audiorate);
   GST_PLUGIN_STATIC_DECLARE(audioresample);
   GST_PLUGIN_STATIC_DECLARE(typefindfunctions);
-  GST_PLUGIN_STATIC_DECLARE(volume);
   GST_PLUGIN_STATIC_DECLARE(autodetect);
   GST_PLUGIN_STATIC_DECLARE(playback);
-  GST_PLUGIN_STATIC_DECLARE(audiofx);
-  GST_PLUGIN_STATIC_DECLARE(interleave);
-  GST_PLUGIN_STATIC_DECLARE(level);
-  GST_PLUGIN_STATIC_DECLARE(multifile);
-  GST_PLUGIN_STATIC_DECLARE(replaygain);
-  GST_PLUGIN_STATIC_DECLARE(autoconvert);
-  GST_PLUGIN_STATIC_DECLARE(inter);
-  GST_PLUGIN_STATIC_DECLARE(liveadder);
-  GST_PLUGIN_STATIC_DECLARE(rawparse);
-  GST_PLUGIN_STATIC_DECLARE(segmentclip);
-  GST_PLUGIN_STATIC_DECLARE(speed);
-  GST_PLUGIN_STATIC_DECLARE(audiomixer);
-  GST_PLUGIN_STATIC_DECLARE(tcp);
-  GST_PLUGIN_STATIC_DECLARE(rtsp);
-  GST_PLUGIN_STATIC_DECLARE(rtp);
-  GST_PLUGIN_STATIC_DECLARE(rtpmanager);
   GST_PLUGIN_STATIC_DECLARE(soup);
-  GST_PLUGIN_STATIC_DECLARE(udp);
-  GST_PLUGIN_STATIC_DECLARE(dataurisrc);
-  GST_PLUGIN_STATIC_DECLARE(sdp);
-  GST_PLUGIN_STATIC_DECLARE(srtp);
   GST_PLUGIN_STATIC_DECLARE(opensles);
-  GST_PLUGIN_STATIC_DECLARE(subparse);
   GST_PLUGIN_STATIC_DECLARE(ogg);
   GST_PLUGIN_STATIC_DECLARE(vorbis);
-  GST_PLUGIN_STATIC_DECLARE(apetag);
   GST_PLUGIN_STATIC_DECLARE(audioparsers);
-  GST_PLUGIN_STATIC_DECLARE(auparse);
-  GST_PLUGIN_STATIC_DECLARE(flv);
   GST_PLUGIN_STATIC_DECLARE(flac);
   GST_PLUGIN_STATIC_DECLARE(icydemux);
   GST_PLUGIN_STATIC_DECLARE(id3demux);
+  GST_PLUGIN_STATIC_DECLARE(apetag);
   GST_PLUGIN_STATIC_DECLARE(isomp4);
-  GST_PLUGIN_STATIC_DECLARE(multipart);
-  GST_PLUGIN_STATIC_DECLARE(taglib);
   GST_PLUGIN_STATIC_DECLARE(wavparse);
   GST_PLUGIN_STATIC_DECLARE(fragmented);
-  GST_PLUGIN_STATIC_DECLARE(id3tag);
-  GST_PLUGIN_STATIC_DECLARE(gdp);
   GST_PLUGIN_STATIC_DECLARE(mad);
   GST_PLUGIN_STATIC_DECLARE(faad);
 
@@ -75,53 +45,23 @@ void
 gst_android_register_static_plugins (void)
 {
   GST_PLUGIN_STATIC_REGISTER(coreelements);
-  GST_PLUGIN_STATIC_REGISTER(app);
   GST_PLUGIN_STATIC_REGISTER(audioconvert);
-  GST_PLUGIN_STATIC_REGISTER(audiorate);
   GST_PLUGIN_STATIC_REGISTER(audioresample);
   GST_PLUGIN_STATIC_REGISTER(typefindfunctions);
-  GST_PLUGIN_STATIC_REGISTER(volume);
   GST_PLUGIN_STATIC_REGISTER(autodetect);
   GST_PLUGIN_STATIC_REGISTER(playback);
-  GST_PLUGIN_STATIC_REGISTER(audiofx);
-  GST_PLUGIN_STATIC_REGISTER(interleave);
-  GST_PLUGIN_STATIC_REGISTER(level);
-  GST_PLUGIN_STATIC_REGISTER(multifile);
-  GST_PLUGIN_STATIC_REGISTER(replaygain);
-  GST_PLUGIN_STATIC_REGISTER(autoconvert);
-  GST_PLUGIN_STATIC_REGISTER(inter);
-  GST_PLUGIN_STATIC_REGISTER(liveadder);
-  GST_PLUGIN_STATIC_REGISTER(rawparse);
-  GST_PLUGIN_STATIC_REGISTER(segmentclip);
-  GST_PLUGIN_STATIC_REGISTER(speed);
-  GST_PLUGIN_STATIC_REGISTER(audiomixer);
-  GST_PLUGIN_STATIC_REGISTER(tcp);
-  GST_PLUGIN_STATIC_REGISTER(rtsp);
-  GST_PLUGIN_STATIC_REGISTER(rtp);
-  GST_PLUGIN_STATIC_REGISTER(rtpmanager);
   GST_PLUGIN_STATIC_REGISTER(soup);
-  GST_PLUGIN_STATIC_REGISTER(udp);
-  GST_PLUGIN_STATIC_REGISTER(dataurisrc);
-  GST_PLUGIN_STATIC_REGISTER(sdp);
-  GST_PLUGIN_STATIC_REGISTER(srtp);
   GST_PLUGIN_STATIC_REGISTER(opensles);
-  GST_PLUGIN_STATIC_REGISTER(subparse);
   GST_PLUGIN_STATIC_REGISTER(ogg);
   GST_PLUGIN_STATIC_REGISTER(vorbis);
-  GST_PLUGIN_STATIC_REGISTER(apetag);
   GST_PLUGIN_STATIC_REGISTER(audioparsers);
-  GST_PLUGIN_STATIC_REGISTER(auparse);
-  GST_PLUGIN_STATIC_REGISTER(flv);
   GST_PLUGIN_STATIC_REGISTER(flac);
   GST_PLUGIN_STATIC_REGISTER(icydemux);
   GST_PLUGIN_STATIC_REGISTER(id3demux);
+  GST_PLUGIN_STATIC_REGISTER(apetag);
   GST_PLUGIN_STATIC_REGISTER(isomp4);
-  GST_PLUGIN_STATIC_REGISTER(multipart);
-  GST_PLUGIN_STATIC_REGISTER(taglib);
   GST_PLUGIN_STATIC_REGISTER(wavparse);
   GST_PLUGIN_STATIC_REGISTER(fragmented);
-  GST_PLUGIN_STATIC_REGISTER(id3tag);
-  GST_PLUGIN_STATIC_REGISTER(gdp);
   GST_PLUGIN_STATIC_REGISTER(mad);
   GST_PLUGIN_STATIC_REGISTER(faad);
 
@@ -13,153 +13,25 @@ G_PASTE(g_io_module_, G_PASTE(name, _load_static)) ()
 
 /* Declaration of static plugins */
   GST_PLUGIN_STATIC_DECLARE(coreelements);
-  GST_PLUGIN_STATIC_DECLARE(adder);
-  GST_PLUGIN_STATIC_DECLARE(app);
   GST_PLUGIN_STATIC_DECLARE(audioconvert);
-  GST_PLUGIN_STATIC_DECLARE(audiorate);
   GST_PLUGIN_STATIC_DECLARE(audioresample);
-  GST_PLUGIN_STATIC_DECLARE(audiotestsrc);
-  GST_PLUGIN_STATIC_DECLARE(gio);
-  GST_PLUGIN_STATIC_DECLARE(pango);
   GST_PLUGIN_STATIC_DECLARE(typefindfunctions);
-  GST_PLUGIN_STATIC_DECLARE(videoconvert);
-  GST_PLUGIN_STATIC_DECLARE(videorate);
-  GST_PLUGIN_STATIC_DECLARE(videoscale);
-  GST_PLUGIN_STATIC_DECLARE(videotestsrc);
-  GST_PLUGIN_STATIC_DECLARE(volume);
   GST_PLUGIN_STATIC_DECLARE(autodetect);
-  GST_PLUGIN_STATIC_DECLARE(videofilter);
   GST_PLUGIN_STATIC_DECLARE(playback);
-  GST_PLUGIN_STATIC_DECLARE(alpha);
-  GST_PLUGIN_STATIC_DECLARE(alphacolor);
-  GST_PLUGIN_STATIC_DECLARE(audiofx);
-  GST_PLUGIN_STATIC_DECLARE(cairo);
-  GST_PLUGIN_STATIC_DECLARE(cutter);
-  GST_PLUGIN_STATIC_DECLARE(debug);
-  GST_PLUGIN_STATIC_DECLARE(deinterlace);
-  GST_PLUGIN_STATIC_DECLARE(dtmf);
-  GST_PLUGIN_STATIC_DECLARE(effectv);
-  GST_PLUGIN_STATIC_DECLARE(equalizer);
-  GST_PLUGIN_STATIC_DECLARE(gdkpixbuf);
-  GST_PLUGIN_STATIC_DECLARE(imagefreeze);
-  GST_PLUGIN_STATIC_DECLARE(interleave);
-  GST_PLUGIN_STATIC_DECLARE(level);
-  GST_PLUGIN_STATIC_DECLARE(multifile);
-  GST_PLUGIN_STATIC_DECLARE(replaygain);
-  GST_PLUGIN_STATIC_DECLARE(shapewipe);
-  GST_PLUGIN_STATIC_DECLARE(smpte);
-  GST_PLUGIN_STATIC_DECLARE(spectrum);
-  GST_PLUGIN_STATIC_DECLARE(videobox);
-  GST_PLUGIN_STATIC_DECLARE(videocrop);
-  GST_PLUGIN_STATIC_DECLARE(videomixer);
-  GST_PLUGIN_STATIC_DECLARE(accurip);
-  GST_PLUGIN_STATIC_DECLARE(aiff);
-  GST_PLUGIN_STATIC_DECLARE(audiofxbad);
-  GST_PLUGIN_STATIC_DECLARE(autoconvert);
-  GST_PLUGIN_STATIC_DECLARE(bayer);
-  GST_PLUGIN_STATIC_DECLARE(coloreffects);
-  GST_PLUGIN_STATIC_DECLARE(debugutilsbad);
-  GST_PLUGIN_STATIC_DECLARE(fieldanalysis);
-  GST_PLUGIN_STATIC_DECLARE(freeverb);
-  GST_PLUGIN_STATIC_DECLARE(frei0r);
-  GST_PLUGIN_STATIC_DECLARE(gaudieffects);
-  GST_PLUGIN_STATIC_DECLARE(geometrictransform);
-  GST_PLUGIN_STATIC_DECLARE(interlace);
-  GST_PLUGIN_STATIC_DECLARE(ivtc);
-  GST_PLUGIN_STATIC_DECLARE(liveadder);
-  GST_PLUGIN_STATIC_DECLARE(rawparse);
-  GST_PLUGIN_STATIC_DECLARE(removesilence);
-  GST_PLUGIN_STATIC_DECLARE(segmentclip);
-  GST_PLUGIN_STATIC_DECLARE(smooth);
-  GST_PLUGIN_STATIC_DECLARE(speed);
-  GST_PLUGIN_STATIC_DECLARE(videofiltersbad);
-  GST_PLUGIN_STATIC_DECLARE(audiomixer);
-  GST_PLUGIN_STATIC_DECLARE(compositor);
-  GST_PLUGIN_STATIC_DECLARE(tcp);
-  GST_PLUGIN_STATIC_DECLARE(rtsp);
-  GST_PLUGIN_STATIC_DECLARE(rtp);
-  GST_PLUGIN_STATIC_DECLARE(rtpmanager);
   GST_PLUGIN_STATIC_DECLARE(soup);
-  GST_PLUGIN_STATIC_DECLARE(udp);
-  GST_PLUGIN_STATIC_DECLARE(dataurisrc);
-  GST_PLUGIN_STATIC_DECLARE(sdp);
   GST_PLUGIN_STATIC_DECLARE(opensles);
-  GST_PLUGIN_STATIC_DECLARE(opengl);
-  GST_PLUGIN_STATIC_DECLARE(subparse);
   GST_PLUGIN_STATIC_DECLARE(ogg);
-  GST_PLUGIN_STATIC_DECLARE(theora);
   GST_PLUGIN_STATIC_DECLARE(vorbis);
-  GST_PLUGIN_STATIC_DECLARE(ivorbisdec);
-  GST_PLUGIN_STATIC_DECLARE(alaw);
-  GST_PLUGIN_STATIC_DECLARE(apetag);
   GST_PLUGIN_STATIC_DECLARE(audioparsers);
-  GST_PLUGIN_STATIC_DECLARE(auparse);
-  GST_PLUGIN_STATIC_DECLARE(avi);
-  GST_PLUGIN_STATIC_DECLARE(dv);
   GST_PLUGIN_STATIC_DECLARE(flac);
-  GST_PLUGIN_STATIC_DECLARE(flv);
-  GST_PLUGIN_STATIC_DECLARE(flxdec);
   GST_PLUGIN_STATIC_DECLARE(icydemux);
   GST_PLUGIN_STATIC_DECLARE(id3demux);
+  GST_PLUGIN_STATIC_DECLARE(apetag);
   GST_PLUGIN_STATIC_DECLARE(isomp4);
-  GST_PLUGIN_STATIC_DECLARE(jpeg);
-  GST_PLUGIN_STATIC_DECLARE(matroska);
-  GST_PLUGIN_STATIC_DECLARE(mulaw);
-  GST_PLUGIN_STATIC_DECLARE(multipart);
-  GST_PLUGIN_STATIC_DECLARE(png);
-  GST_PLUGIN_STATIC_DECLARE(speex);
-  GST_PLUGIN_STATIC_DECLARE(taglib);
-  GST_PLUGIN_STATIC_DECLARE(vpx);
-  GST_PLUGIN_STATIC_DECLARE(wavenc);
-  GST_PLUGIN_STATIC_DECLARE(wavpack);
   GST_PLUGIN_STATIC_DECLARE(wavparse);
-  GST_PLUGIN_STATIC_DECLARE(y4menc);
-  GST_PLUGIN_STATIC_DECLARE(adpcmdec);
-  GST_PLUGIN_STATIC_DECLARE(adpcmenc);
-  GST_PLUGIN_STATIC_DECLARE(dashdemux);
-  GST_PLUGIN_STATIC_DECLARE(dvbsuboverlay);
-  GST_PLUGIN_STATIC_DECLARE(dvdspu);
   GST_PLUGIN_STATIC_DECLARE(fragmented);
-  GST_PLUGIN_STATIC_DECLARE(id3tag);
-  GST_PLUGIN_STATIC_DECLARE(kate);
-  GST_PLUGIN_STATIC_DECLARE(midi);
-  GST_PLUGIN_STATIC_DECLARE(mxf);
-  GST_PLUGIN_STATIC_DECLARE(opus);
-  GST_PLUGIN_STATIC_DECLARE(pcapparse);
-  GST_PLUGIN_STATIC_DECLARE(pnm);
-  GST_PLUGIN_STATIC_DECLARE(rfbsrc);
-  GST_PLUGIN_STATIC_DECLARE(schro);
-  GST_PLUGIN_STATIC_DECLARE(gstsiren);
-  GST_PLUGIN_STATIC_DECLARE(smoothstreaming);
-  GST_PLUGIN_STATIC_DECLARE(subenc);
-  GST_PLUGIN_STATIC_DECLARE(videoparsersbad);
-  GST_PLUGIN_STATIC_DECLARE(y4mdec);
-  GST_PLUGIN_STATIC_DECLARE(jpegformat);
-  GST_PLUGIN_STATIC_DECLARE(gdp);
-  GST_PLUGIN_STATIC_DECLARE(rsvg);
-  GST_PLUGIN_STATIC_DECLARE(androidmedia);
-  GST_PLUGIN_STATIC_DECLARE(asfmux);
-  GST_PLUGIN_STATIC_DECLARE(dtsdec);
-  GST_PLUGIN_STATIC_DECLARE(faad);
-  GST_PLUGIN_STATIC_DECLARE(mpegpsdemux);
-  GST_PLUGIN_STATIC_DECLARE(mpegpsmux);
-  GST_PLUGIN_STATIC_DECLARE(mpegtsdemux);
-  GST_PLUGIN_STATIC_DECLARE(mpegtsmux);
-  GST_PLUGIN_STATIC_DECLARE(voaacenc);
-  GST_PLUGIN_STATIC_DECLARE(a52dec);
-  GST_PLUGIN_STATIC_DECLARE(amrnb);
-  GST_PLUGIN_STATIC_DECLARE(amrwbdec);
-  GST_PLUGIN_STATIC_DECLARE(asf);
-  GST_PLUGIN_STATIC_DECLARE(dvdsub);
-  GST_PLUGIN_STATIC_DECLARE(dvdlpcmdec);
   GST_PLUGIN_STATIC_DECLARE(mad);
-  GST_PLUGIN_STATIC_DECLARE(mpeg2dec);
-  GST_PLUGIN_STATIC_DECLARE(xingmux);
-  GST_PLUGIN_STATIC_DECLARE(realmedia);
-  GST_PLUGIN_STATIC_DECLARE(x264);
-  GST_PLUGIN_STATIC_DECLARE(libav);
-  GST_PLUGIN_STATIC_DECLARE(mms);
-  GST_PLUGIN_STATIC_DECLARE(rtmp);
+  GST_PLUGIN_STATIC_DECLARE(faad);
 
 
 /* Declaration of static gio modules */
@@ -171,153 +43,25 @@ void
 gst_android_register_static_plugins (void)
 {
   GST_PLUGIN_STATIC_REGISTER(coreelements);
-  GST_PLUGIN_STATIC_REGISTER(adder);
-  GST_PLUGIN_STATIC_REGISTER(app);
   GST_PLUGIN_STATIC_REGISTER(audioconvert);
-  GST_PLUGIN_STATIC_REGISTER(audiorate);
   GST_PLUGIN_STATIC_REGISTER(audioresample);
-  GST_PLUGIN_STATIC_REGISTER(audiotestsrc);
-  GST_PLUGIN_STATIC_REGISTER(gio);
-  GST_PLUGIN_STATIC_REGISTER(pango);
   GST_PLUGIN_STATIC_REGISTER(typefindfunctions);
-  GST_PLUGIN_STATIC_REGISTER(videoconvert);
-  GST_PLUGIN_STATIC_REGISTER(videorate);
-  GST_PLUGIN_STATIC_REGISTER(videoscale);
-  GST_PLUGIN_STATIC_REGISTER(videotestsrc);
-  GST_PLUGIN_STATIC_REGISTER(volume);
   GST_PLUGIN_STATIC_REGISTER(autodetect);
-  GST_PLUGIN_STATIC_REGISTER(videofilter);
   GST_PLUGIN_STATIC_REGISTER(playback);
-  GST_PLUGIN_STATIC_REGISTER(alpha);
-  GST_PLUGIN_STATIC_REGISTER(alphacolor);
-  GST_PLUGIN_STATIC_REGISTER(audiofx);
-  GST_PLUGIN_STATIC_REGISTER(cairo);
-  GST_PLUGIN_STATIC_REGISTER(cutter);
-  GST_PLUGIN_STATIC_REGISTER(debug);
-  GST_PLUGIN_STATIC_REGISTER(deinterlace);
-  GST_PLUGIN_STATIC_REGISTER(dtmf);
-  GST_PLUGIN_STATIC_REGISTER(effectv);
-  GST_PLUGIN_STATIC_REGISTER(equalizer);
-  GST_PLUGIN_STATIC_REGISTER(gdkpixbuf);
-  GST_PLUGIN_STATIC_REGISTER(imagefreeze);
-  GST_PLUGIN_STATIC_REGISTER(interleave);
-  GST_PLUGIN_STATIC_REGISTER(level);
-  GST_PLUGIN_STATIC_REGISTER(multifile);
-  GST_PLUGIN_STATIC_REGISTER(replaygain);
-  GST_PLUGIN_STATIC_REGISTER(shapewipe);
-  GST_PLUGIN_STATIC_REGISTER(smpte);
-  GST_PLUGIN_STATIC_REGISTER(spectrum);
-  GST_PLUGIN_STATIC_REGISTER(videobox);
-  GST_PLUGIN_STATIC_REGISTER(videocrop);
-  GST_PLUGIN_STATIC_REGISTER(videomixer);
-  GST_PLUGIN_STATIC_REGISTER(accurip);
-  GST_PLUGIN_STATIC_REGISTER(aiff);
-  GST_PLUGIN_STATIC_REGISTER(audiofxbad);
-  GST_PLUGIN_STATIC_REGISTER(autoconvert);
-  GST_PLUGIN_STATIC_REGISTER(bayer);
-  GST_PLUGIN_STATIC_REGISTER(coloreffects);
-  GST_PLUGIN_STATIC_REGISTER(debugutilsbad);
-  GST_PLUGIN_STATIC_REGISTER(fieldanalysis);
-  GST_PLUGIN_STATIC_REGISTER(freeverb);
-  GST_PLUGIN_STATIC_REGISTER(frei0r);
-  GST_PLUGIN_STATIC_REGISTER(gaudieffects);
-  GST_PLUGIN_STATIC_REGISTER(geometrictransform);
-  GST_PLUGIN_STATIC_REGISTER(interlace);
-  GST_PLUGIN_STATIC_REGISTER(ivtc);
-  GST_PLUGIN_STATIC_REGISTER(liveadder);
-  GST_PLUGIN_STATIC_REGISTER(rawparse);
-  GST_PLUGIN_STATIC_REGISTER(removesilence);
-  GST_PLUGIN_STATIC_REGISTER(segmentclip);
-  GST_PLUGIN_STATIC_REGISTER(smooth);
-  GST_PLUGIN_STATIC_REGISTER(speed);
-  GST_PLUGIN_STATIC_REGISTER(videofiltersbad);
-  GST_PLUGIN_STATIC_REGISTER(audiomixer);
-  GST_PLUGIN_STATIC_REGISTER(compositor);
-  GST_PLUGIN_STATIC_REGISTER(tcp);
-  GST_PLUGIN_STATIC_REGISTER(rtsp);
-  GST_PLUGIN_STATIC_REGISTER(rtp);
-  GST_PLUGIN_STATIC_REGISTER(rtpmanager);
   GST_PLUGIN_STATIC_REGISTER(soup);
-  GST_PLUGIN_STATIC_REGISTER(udp);
-  GST_PLUGIN_STATIC_REGISTER(dataurisrc);
-  GST_PLUGIN_STATIC_REGISTER(sdp);
   GST_PLUGIN_STATIC_REGISTER(opensles);
-  GST_PLUGIN_STATIC_REGISTER(opengl);
-  GST_PLUGIN_STATIC_REGISTER(subparse);
   GST_PLUGIN_STATIC_REGISTER(ogg);
-  GST_PLUGIN_STATIC_REGISTER(theora);
   GST_PLUGIN_STATIC_REGISTER(vorbis);
-  GST_PLUGIN_STATIC_REGISTER(ivorbisdec);
-  GST_PLUGIN_STATIC_REGISTER(alaw);
-  GST_PLUGIN_STATIC_REGISTER(apetag);
   GST_PLUGIN_STATIC_REGISTER(audioparsers);
-  GST_PLUGIN_STATIC_REGISTER(auparse);
-  GST_PLUGIN_STATIC_REGISTER(avi);
-  GST_PLUGIN_STATIC_REGISTER(dv);
   GST_PLUGIN_STATIC_REGISTER(flac);
-  GST_PLUGIN_STATIC_REGISTER(flv);
-  GST_PLUGIN_STATIC_REGISTER(flxdec);
   GST_PLUGIN_STATIC_REGISTER(icydemux);
   GST_PLUGIN_STATIC_REGISTER(id3demux);
+  GST_PLUGIN_STATIC_REGISTER(apetag);
   GST_PLUGIN_STATIC_REGISTER(isomp4);
-  GST_PLUGIN_STATIC_REGISTER(jpeg);
-  GST_PLUGIN_STATIC_REGISTER(matroska);
-  GST_PLUGIN_STATIC_REGISTER(mulaw);
-  GST_PLUGIN_STATIC_REGISTER(multipart);
-  GST_PLUGIN_STATIC_REGISTER(png);
-  GST_PLUGIN_STATIC_REGISTER(speex);
-  GST_PLUGIN_STATIC_REGISTER(taglib);
-  GST_PLUGIN_STATIC_REGISTER(vpx);
-  GST_PLUGIN_STATIC_REGISTER(wavenc);
-  GST_PLUGIN_STATIC_REGISTER(wavpack);
   GST_PLUGIN_STATIC_REGISTER(wavparse);
-  GST_PLUGIN_STATIC_REGISTER(y4menc);
-  GST_PLUGIN_STATIC_REGISTER(adpcmdec);
-  GST_PLUGIN_STATIC_REGISTER(adpcmenc);
-  GST_PLUGIN_STATIC_REGISTER(dashdemux);
-  GST_PLUGIN_STATIC_REGISTER(dvbsuboverlay);
-  GST_PLUGIN_STATIC_REGISTER(dvdspu);
   GST_PLUGIN_STATIC_REGISTER(fragmented);
-  GST_PLUGIN_STATIC_REGISTER(id3tag);
-  GST_PLUGIN_STATIC_REGISTER(kate);
-  GST_PLUGIN_STATIC_REGISTER(midi);
-  GST_PLUGIN_STATIC_REGISTER(mxf);
-  GST_PLUGIN_STATIC_REGISTER(opus);
-  GST_PLUGIN_STATIC_REGISTER(pcapparse);
-  GST_PLUGIN_STATIC_REGISTER(pnm);
-  GST_PLUGIN_STATIC_REGISTER(rfbsrc);
-  GST_PLUGIN_STATIC_REGISTER(schro);
-  GST_PLUGIN_STATIC_REGISTER(gstsiren);
-  GST_PLUGIN_STATIC_REGISTER(smoothstreaming);
-  GST_PLUGIN_STATIC_REGISTER(subenc);
-  GST_PLUGIN_STATIC_REGISTER(videoparsersbad);
-  GST_PLUGIN_STATIC_REGISTER(y4mdec);
-  GST_PLUGIN_STATIC_REGISTER(jpegformat);
-  GST_PLUGIN_STATIC_REGISTER(gdp);
-  GST_PLUGIN_STATIC_REGISTER(rsvg);
-  GST_PLUGIN_STATIC_REGISTER(androidmedia);
-  GST_PLUGIN_STATIC_REGISTER(asfmux);
-  GST_PLUGIN_STATIC_REGISTER(dtsdec);
-  GST_PLUGIN_STATIC_REGISTER(faad);
-  GST_PLUGIN_STATIC_REGISTER(mpegpsdemux);
-  GST_PLUGIN_STATIC_REGISTER(mpegpsmux);
-  GST_PLUGIN_STATIC_REGISTER(mpegtsdemux);
-  GST_PLUGIN_STATIC_REGISTER(mpegtsmux);
-  GST_PLUGIN_STATIC_REGISTER(voaacenc);
-  GST_PLUGIN_STATIC_REGISTER(a52dec);
-  GST_PLUGIN_STATIC_REGISTER(amrnb);
-  GST_PLUGIN_STATIC_REGISTER(amrwbdec);
-  GST_PLUGIN_STATIC_REGISTER(asf);
-  GST_PLUGIN_STATIC_REGISTER(dvdsub);
-  GST_PLUGIN_STATIC_REGISTER(dvdlpcmdec);
   GST_PLUGIN_STATIC_REGISTER(mad);
-  GST_PLUGIN_STATIC_REGISTER(mpeg2dec);
-  GST_PLUGIN_STATIC_REGISTER(xingmux);
-  GST_PLUGIN_STATIC_REGISTER(realmedia);
-  GST_PLUGIN_STATIC_REGISTER(x264);
-  GST_PLUGIN_STATIC_REGISTER(libav);
-  GST_PLUGIN_STATIC_REGISTER(mms);
-  GST_PLUGIN_STATIC_REGISTER(rtmp);
+  GST_PLUGIN_STATIC_REGISTER(faad);
 
 }
 
@@ -12,9 +12,17 @@ SHELL := PATH=/usr/bin:/bin:/usr/sbin:/sbin:/usr/local/bin /bin/bash
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := gplayer
-LOCAL_SRC_FILES := gplayer.c java_callbacks.c nativecalls.c
+LOCAL_SRC_FILES := gplayer.c bandwidth.c cache.c frameindex.c gain.c http.c metadata.c pcmtap.c prefetch.c trace.c java_callbacks.c nativecalls.c
 LOCAL_SHARED_LIBRARIES := gstreamer_android
-LOCAL_LDLIBS := -llog -landroid
+# armeabi has no 64 bit atomic instructions, libatomic provides them
+LOCAL_LDLIBS := -llog -landroid -latomic
+# Not every armeabi-v7a CPU has NEON, so only the gain kernels are built with it and gain_init checks the CPU.
+# armeabi has neither NEON nor an FPU, there the gain stage stays on the fixed point S16 path.
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += gain_neon.c.neon
+LOCAL_CFLAGS += -DGPLAYER_GAIN_NEON
+LOCAL_STATIC_LIBRARIES := cpufeatures
+endif
 include $(BUILD_SHARED_LIBRARY)
 
 
@@ -28,14 +36,36 @@ endif
 GSTREAMER_NDK_BUILD_PATH  := $(GSTREAMER_ROOT)/share/gst-android/ndk-build
 
 
-GSTREAMER_PLUGINS_CODECS_RESTRICTED := mad faad
+# Every plugin is registered in GStreamer.init at each cold start. The audio profile has what the pipeline of
+# build_pipeline needs: uridecodebin, queue2 and typefind, audioconvert, audioresample, autoaudiosink with the
+# OpenSL ES sink, souphttpsrc, and the demuxers, parsers and decoders uridecodebin plugs for MP3, AAC, Ogg
+# Vorbis, FLAC, WAV and ICY streams. hlsdemux (fragmented) only plays HLS of packed audio segments, MPEG-TS
+# segments would need mpegtsdemux, which neither profile has. The baseline profile,
+# ndk-build GPLAYER_PLUGIN_PROFILE=baseline, is the list the library was built with before the audio one.
+# linux/bench-startup compares the two.
+GPLAYER_PLUGIN_PROFILE ?= audio
+
+ifeq ($(GPLAYER_PLUGIN_PROFILE),baseline)
+GSTREAMER_PLUGINS_CODECS_RESTRICTED := mad faad
 GSTREAMER_PLUGINS_CORE := coreelements audioconvert audioresample typefindfunctions volume autodetect
 GSTREAMER_PLUGINS_SYS := opensles
 GSTREAMER_PLUGINS_PLAYBACK := playback
-GSTREAMER_PLUGINS_EFFECTS := 
-GSTREAMER_PLUGINS_CODECS := ogg vorbis audioparsers flac icydemux id3demux isomp4 wavparse fragmented id3tag 
+GSTREAMER_PLUGINS_EFFECTS :=
+GSTREAMER_PLUGINS_CODECS := ogg vorbis audioparsers flac icydemux id3demux isomp4 wavparse fragmented id3tag
 GSTREAMER_PLUGINS_NET := tcp soup
+else
+GSTREAMER_PLUGINS_CODECS_RESTRICTED := mad faad
+GSTREAMER_PLUGINS_CORE := coreelements audioconvert audioresample typefindfunctions autodetect
+GSTREAMER_PLUGINS_SYS := opensles
+GSTREAMER_PLUGINS_PLAYBACK := playback
+GSTREAMER_PLUGINS_EFFECTS :=
+GSTREAMER_PLUGINS_CODECS := ogg vorbis audioparsers flac icydemux id3demux apetag isomp4 wavparse fragmented
+GSTREAMER_PLUGINS_NET := soup
+endif
 GSTREAMER_PLUGINS         := $(GSTREAMER_PLUGINS_CORE) $(GSTREAMER_PLUGINS_PLAYBACK) $(GSTREAMER_PLUGINS_EFFECTS) $(GSTREAMER_PLUGINS_NET) $(GSTREAMER_PLUGINS_SYS) $(GSTREAMER_PLUGINS_CODECS) $(GSTREAMER_PLUGINS_CODECS_RESTRICTED)
 G_IO_MODULES              := gnutls
+GSTREAMER_EXTRA_DEPS      := gstreamer-base-1.0 libsoup-2.4
 
 include $(GSTREAMER_NDK_BUILD_PATH)/gstreamer-1.0.mk
+
+$(call import-module,android/cpufeatures)
@@ -1,2 +1,2 @@
-APP_ABI := armeabi
+APP_ABI := armeabi armeabi-v7a
 APP_PLATFORM := android-14
\ No newline at end of file
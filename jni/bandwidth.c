@@ -0,0 +1,91 @@
+/*
+ * bandwidth.c
+ *
+ *  Throughput estimate of the network source, taken from the buffers leaving its src pad.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <gst/gst.h>
+#include "include/bandwidth.h"
+
+/* Buffers further apart than this belong to different transfers */
+#define IDLE_GAP (1000 * GST_MSECOND)
+/* Active time collected into one sample */
+#define SAMPLE_TIME (500 * GST_MSECOND)
+/* Time constant of the moving average, older samples weigh e^(-t/AVERAGE_TIME) */
+#define AVERAGE_TIME (4 * GST_SECOND)
+
+void bandwidth_init(BandwidthEstimator *bw)
+{
+	memset(bw, 0, sizeof(BandwidthEstimator));
+	g_mutex_init(&bw->lock);
+	bw->last_arrival = GST_CLOCK_TIME_NONE;
+}
+
+void bandwidth_clear(BandwidthEstimator *bw)
+{
+	g_mutex_clear(&bw->lock);
+}
+
+void bandwidth_restart(BandwidthEstimator *bw)
+{
+	g_mutex_lock(&bw->lock);
+	bw->last_arrival = GST_CLOCK_TIME_NONE;
+	g_mutex_unlock(&bw->lock);
+}
+
+void bandwidth_add(BandwidthEstimator *bw, gsize bytes, GstClockTime now, gboolean blocking)
+{
+	g_mutex_lock(&bw->lock);
+	bw->total_bytes += bytes;
+	/* The bytes of a buffer arrived since the previous one, after an idle gap we do not know since when and
+	 * after a blocking push the source spent part of that time waiting instead of reading */
+	if (GST_CLOCK_TIME_IS_VALID(bw->last_arrival) && now - bw->last_arrival < IDLE_GAP && !bw->last_blocked)
+	{
+		bw->window_bytes += bytes;
+		bw->window_time += now - bw->last_arrival;
+	}
+	bw->last_arrival = now;
+	bw->last_blocked = blocking;
+
+	if (bw->window_time >= SAMPLE_TIME)
+	{
+		gdouble sample = (gdouble) bw->window_bytes * GST_SECOND / bw->window_time;
+		if (bw->observed == 0)
+		{
+			bw->estimate = sample;
+			bw->variance = 0;
+		}
+		else
+		{
+			gdouble alpha = 1 - exp(-(gdouble) bw->window_time / AVERAGE_TIME);
+			gdouble diff = sample - bw->estimate;
+			bw->estimate += alpha * diff;
+			bw->variance = (1 - alpha) * (bw->variance + alpha * diff * diff);
+		}
+		bw->observed += bw->window_time;
+		bw->window_bytes = 0;
+		bw->window_time = 0;
+	}
+	g_mutex_unlock(&bw->lock);
+}
+
+gint64 bandwidth_get(BandwidthEstimator *bw, gint *confidence)
+{
+	gint64 estimate;
+	gdouble certainty = 0;
+
+	g_mutex_lock(&bw->lock);
+	estimate = (gint64) bw->estimate;
+	if (bw->observed > 0 && bw->estimate > 0)
+	{
+		/* Grows with the observed time, shrinks with the spread of the samples */
+		certainty = (1 - exp(-(gdouble) bw->observed / AVERAGE_TIME)) / (1 + sqrt(bw->variance) / bw->estimate);
+	}
+	g_mutex_unlock(&bw->lock);
+
+	if (confidence)
+		*confidence = (gint) (certainty * 1000);
+	return estimate;
+}
@@ -0,0 +1,783 @@
+/*
+ * cache.c
+ *
+ *  Disk cache of progressive downloads, its background validation and index scans, and the
+ *  source element that plays a cached copy.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+#include "include/customdata.h"
+#include "include/http.h"
+#include "include/cache.h"
+
+#define CACHE_GROUP "entry"
+/* A validated entry is used without asking the server again for this long */
+#define CACHE_FRESH_TIME (5 * 60 * G_USEC_PER_SEC)
+/* Leftovers of a crash */
+#define CACHE_STALE_PART_TIME (24 * 60 * 60)
+
+struct _CacheWriter
+{
+	gchar *uri;
+	gchar *key;
+	gchar *part_path;
+	FILE *file;
+	guint64 offset;
+	gchar *etag;
+	gchar *last_modified;
+	gboolean started;
+	gboolean failed;
+	gboolean committed;
+	FrameIndex *index;
+};
+
+typedef struct _CacheEntry
+{
+	gchar *key;
+	gint64 used;
+	guint64 size;
+} CacheEntry;
+
+/* Work on an entry that must not hold up playback */
+typedef struct _CacheTask
+{
+	gchar *uri;
+	/* Build the missing frame index, otherwise validate */
+	gboolean scan;
+} CacheTask;
+
+static GMutex cache_lock;
+static gchar *cache_dir;
+static guint64 cache_max_size = CACHE_DEFAULT_SIZE;
+/* Held while the files of an entry change, the players and the background work share them */
+static GMutex entry_lock;
+static GThreadPool *background;
+
+void cache_configure(guint64 max_size)
+{
+	g_mutex_lock(&cache_lock);
+	cache_max_size = max_size;
+	g_mutex_unlock(&cache_lock);
+}
+
+/* The directory is looked up on first use, gst_android_init sets XDG_CACHE_HOME before */
+static const gchar *get_cache_dir(void)
+{
+	g_mutex_lock(&cache_lock);
+	if (!cache_dir)
+	{
+		cache_dir = g_build_filename(g_get_user_cache_dir(), "gplayer", NULL);
+		g_mkdir_with_parents(cache_dir, 0700);
+	}
+	g_mutex_unlock(&cache_lock);
+	return cache_dir;
+}
+
+static guint64 get_max_size(void)
+{
+	guint64 max_size;
+
+	g_mutex_lock(&cache_lock);
+	max_size = cache_max_size;
+	g_mutex_unlock(&cache_lock);
+	return max_size;
+}
+
+static gboolean is_cacheable(const gchar *uri)
+{
+	return get_max_size() > 0 && uri && (gst_uri_has_protocol(uri, "http") || gst_uri_has_protocol(uri, "https"));
+}
+
+static gchar *entry_path(const gchar *key, const gchar *suffix)
+{
+	gchar *name = g_strconcat(key, suffix, NULL);
+	gchar *path = g_build_filename(get_cache_dir(), name, NULL);
+
+	g_free(name);
+	return path;
+}
+
+static void remove_entry(const gchar *key)
+{
+	gchar *meta_path = entry_path(key, ".meta");
+	gchar *data_path = entry_path(key, ".data");
+	gchar *index_path = entry_path(key, ".index");
+
+	g_unlink(meta_path);
+	g_unlink(data_path);
+	g_unlink(index_path);
+	g_free(meta_path);
+	g_free(data_path);
+	g_free(index_path);
+}
+
+static gint compare_used(gconstpointer a, gconstpointer b)
+{
+	const CacheEntry *first = a, *second = b;
+
+	return first->used < second->used ? -1 : first->used > second->used;
+}
+
+/* Remove the least recently used entries until the cache fits its size */
+static void evict(void)
+{
+	GDir *dir = g_dir_open(get_cache_dir(), 0, NULL);
+	GArray *entries = g_array_new(FALSE, FALSE, sizeof(CacheEntry));
+	guint64 total = 0, max_size = get_max_size();
+	const gchar *name;
+	guint i;
+
+	if (!dir)
+	{
+		g_array_free(entries, TRUE);
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)))
+	{
+		gchar *path = g_build_filename(get_cache_dir(), name, NULL);
+
+		if (g_str_has_suffix(name, ".meta"))
+		{
+			GKeyFile *meta = g_key_file_new();
+			CacheEntry entry;
+
+			if (g_key_file_load_from_file(meta, path, G_KEY_FILE_NONE, NULL))
+			{
+				entry.key = g_strndup(name, strlen(name) - strlen(".meta"));
+				entry.used = g_key_file_get_int64(meta, CACHE_GROUP, "used", NULL);
+				entry.size = g_key_file_get_uint64(meta, CACHE_GROUP, "size", NULL);
+				total += entry.size;
+				g_array_append_val(entries, entry);
+			}
+			g_key_file_free(meta);
+		}
+		else if (g_str_has_suffix(name, ".part"))
+		{
+			GStatBuf st;
+
+			if (g_stat(path, &st) == 0 && st.st_mtime < g_get_real_time() / G_USEC_PER_SEC - CACHE_STALE_PART_TIME)
+				g_unlink(path);
+		}
+		g_free(path);
+	}
+	g_dir_close(dir);
+
+	g_array_sort(entries, compare_used);
+	for (i = 0; i < entries->len; i++)
+	{
+		CacheEntry *entry = &g_array_index(entries, CacheEntry, i);
+
+		if (total > max_size)
+		{
+			remove_entry(entry->key);
+			total -= entry->size;
+		}
+		g_free(entry->key);
+	}
+	g_array_free(entries, TRUE);
+}
+
+/* Ask the server whether our copy is still current. Without a connection it is served as it is. */
+static gboolean validate(const gchar *uri, GKeyFile *meta)
+{
+	gchar *etag = g_key_file_get_string(meta, CACHE_GROUP, "etag", NULL);
+	gchar *last_modified = g_key_file_get_string(meta, CACHE_GROUP, "last-modified", NULL);
+	guint64 size = g_key_file_get_uint64(meta, CACHE_GROUP, "size", NULL);
+	SoupMessage *msg;
+	gboolean valid = FALSE;
+	guint status;
+
+	msg = soup_message_new("HEAD", uri);
+	if (!msg)
+		goto exit;
+	if (etag)
+		soup_message_headers_append(msg->request_headers, "If-None-Match", etag);
+	if (last_modified)
+		soup_message_headers_append(msg->request_headers, "If-Modified-Since", last_modified);
+
+	/* The connection stays open for the download if the copy turns out stale */
+	status = soup_session_send_message(http_get_session(), msg);
+	if (status == SOUP_STATUS_NOT_MODIFIED || SOUP_STATUS_IS_TRANSPORT_ERROR(status))
+	{
+		valid = TRUE;
+	}
+	else if (SOUP_STATUS_IS_SUCCESSFUL(status))
+	{
+		/* Servers ignoring conditional requests answer in full, compare what they send */
+		const gchar *current_etag = soup_message_headers_get_one(msg->response_headers, "ETag");
+		const gchar *current_modified = soup_message_headers_get_one(msg->response_headers, "Last-Modified");
+
+		if (etag)
+			valid = g_strcmp0(etag, current_etag) == 0;
+		else
+			valid = g_strcmp0(last_modified, current_modified) == 0;
+		if (soup_message_headers_get_content_length(msg->response_headers) != size)
+			valid = FALSE;
+	}
+	GPlayerDEBUG("validated %s: status %u, valid %d", uri, status, valid);
+	g_object_unref(msg);
+
+exit:
+	g_free(etag);
+	g_free(last_modified);
+	return valid;
+}
+
+/* When the copy was last validated, it changes with every new copy of the entry. -1 if there is none. */
+static gint64 get_validated(const gchar *meta_path)
+{
+	GKeyFile *meta = g_key_file_new();
+	gint64 validated = -1;
+
+	if (g_key_file_load_from_file(meta, meta_path, G_KEY_FILE_NONE, NULL))
+		validated = g_key_file_get_int64(meta, CACHE_GROUP, "validated", NULL);
+	g_key_file_free(meta);
+	return validated;
+}
+
+/* Validate a copy served without, one the server changed is marked for removal */
+static void revalidate(const gchar *uri)
+{
+	gchar *key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+	gchar *meta_path = entry_path(key, ".meta");
+	GKeyFile *meta = g_key_file_new();
+	gint64 validated = -1;
+	gboolean valid;
+
+	g_mutex_lock(&entry_lock);
+	if (g_key_file_load_from_file(meta, meta_path, G_KEY_FILE_NONE, NULL))
+		validated = g_key_file_get_int64(meta, CACHE_GROUP, "validated", NULL);
+	g_mutex_unlock(&entry_lock);
+
+	if (validated >= 0)
+	{
+		valid = validate(uri, meta);
+		g_mutex_lock(&entry_lock);
+		/* Unless the entry was replaced or removed meanwhile */
+		if (g_key_file_load_from_file(meta, meta_path, G_KEY_FILE_NONE, NULL)
+				&& g_key_file_get_int64(meta, CACHE_GROUP, "validated", NULL) == validated)
+		{
+			if (valid)
+				g_key_file_set_int64(meta, CACHE_GROUP, "validated", g_get_real_time());
+			else
+				g_key_file_set_boolean(meta, CACHE_GROUP, "changed", TRUE);
+			g_key_file_save_to_file(meta, meta_path, NULL);
+		}
+		g_mutex_unlock(&entry_lock);
+	}
+	g_key_file_free(meta);
+	g_free(meta_path);
+	g_free(key);
+}
+
+/* Scan an entry cached before it had an index, it is used from its next playback */
+static void build_index(const gchar *uri)
+{
+	gchar *key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+	gchar *meta_path = entry_path(key, ".meta");
+	gchar *data_path = entry_path(key, ".data");
+	gchar *index_path = entry_path(key, ".index");
+	FrameIndex *index;
+	gint64 validated;
+
+	g_mutex_lock(&entry_lock);
+	validated = g_file_test(index_path, G_FILE_TEST_EXISTS) ? -1 : get_validated(meta_path);
+	g_mutex_unlock(&entry_lock);
+
+	index = validated >= 0 ? frame_index_scan_file(data_path) : NULL;
+	if (index)
+	{
+		g_mutex_lock(&entry_lock);
+		if (get_validated(meta_path) == validated)
+			frame_index_save(index, index_path);
+		g_mutex_unlock(&entry_lock);
+		frame_index_unref(index);
+	}
+	g_free(index_path);
+	g_free(data_path);
+	g_free(meta_path);
+	g_free(key);
+}
+
+static void run_task(CacheTask *task, gpointer unused)
+{
+	if (task->scan)
+		build_index(task->uri);
+	else
+		revalidate(task->uri);
+	g_free(task->uri);
+	g_free(task);
+}
+
+static void queue_task(const gchar *uri, gboolean scan)
+{
+	CacheTask *task = g_new(CacheTask, 1);
+
+	task->uri = g_strdup(uri);
+	task->scan = scan;
+	g_thread_pool_push(background, task, NULL);
+}
+
+gchar *cache_lookup(const gchar *uri)
+{
+	gchar *key, *meta_path, *data_path, *stored_uri = NULL, *result = NULL;
+	GKeyFile *meta;
+	GStatBuf st;
+	gint64 now = g_get_real_time();
+
+	if (!is_cacheable(uri))
+		return NULL;
+
+	key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+	meta_path = entry_path(key, ".meta");
+	data_path = entry_path(key, ".data");
+	meta = g_key_file_new();
+
+	g_mutex_lock(&entry_lock);
+	if (!g_key_file_load_from_file(meta, meta_path, G_KEY_FILE_NONE, NULL))
+		goto exit;
+
+	stored_uri = g_key_file_get_string(meta, CACHE_GROUP, "uri", NULL);
+	if (g_strcmp0(stored_uri, uri) != 0 || g_stat(data_path, &st) != 0
+			|| (guint64) st.st_size != g_key_file_get_uint64(meta, CACHE_GROUP, "size", NULL)
+			|| g_key_file_get_boolean(meta, CACHE_GROUP, "changed", NULL))
+	{
+		remove_entry(key);
+		goto exit;
+	}
+
+	if (now - g_key_file_get_int64(meta, CACHE_GROUP, "validated", NULL) > CACHE_FRESH_TIME)
+		queue_task(uri, FALSE);
+
+	g_key_file_set_int64(meta, CACHE_GROUP, "used", now);
+	g_key_file_save_to_file(meta, meta_path, NULL);
+	result = g_filename_to_uri(data_path, NULL, NULL);
+
+exit:
+	g_mutex_unlock(&entry_lock);
+	g_key_file_free(meta);
+	g_free(stored_uri);
+	g_free(meta_path);
+	g_free(data_path);
+	g_free(key);
+	return result;
+}
+
+/* Entries cached before they had an index are scanned once, in the background */
+FrameIndex *cache_get_index(const gchar *uri)
+{
+	gchar *key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+	gchar *index_path = entry_path(key, ".index");
+	FrameIndex *index;
+
+	g_mutex_lock(&entry_lock);
+	index = frame_index_load(index_path);
+	g_mutex_unlock(&entry_lock);
+	if (!index)
+		queue_task(uri, TRUE);
+	g_free(index_path);
+	g_free(key);
+	return index;
+}
+
+CacheWriter *cache_writer_new(const gchar *uri)
+{
+	CacheWriter *writer;
+	gchar *name;
+
+	if (!is_cacheable(uri))
+		return NULL;
+
+	writer = g_new0(CacheWriter, 1);
+	writer->uri = g_strdup(uri);
+	writer->key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, uri, -1);
+	/* Another player may be downloading the same uri */
+	name = g_strdup_printf("%s.%p.part", writer->key, writer);
+	writer->part_path = g_build_filename(get_cache_dir(), name, NULL);
+	g_free(name);
+	writer->index = frame_index_new();
+	writer->file = g_fopen(writer->part_path, "wb");
+	if (!writer->file)
+	{
+		cache_writer_free(writer);
+		return NULL;
+	}
+	return writer;
+}
+
+void cache_writer_free(CacheWriter *writer)
+{
+	if (writer->file)
+		fclose(writer->file);
+	if (!writer->committed)
+		g_unlink(writer->part_path);
+	g_free(writer->uri);
+	g_free(writer->key);
+	g_free(writer->part_path);
+	g_free(writer->etag);
+	g_free(writer->last_modified);
+	if (writer->index)
+		frame_index_unref(writer->index);
+	g_free(writer);
+}
+
+FrameIndex *cache_writer_get_index(CacheWriter *writer)
+{
+	return writer->index;
+}
+
+static void fail(CacheWriter *writer)
+{
+	writer->failed = TRUE;
+	if (writer->file)
+	{
+		fclose(writer->file);
+		writer->file = NULL;
+	}
+	g_unlink(writer->part_path);
+}
+
+static void commit(CacheWriter *writer)
+{
+	gchar *meta_path, *data_path, *index_path;
+	GKeyFile *meta;
+	gint64 now = g_get_real_time();
+
+	if (fclose(writer->file) != 0)
+	{
+		writer->file = NULL;
+		fail(writer);
+		return;
+	}
+	writer->file = NULL;
+
+	meta_path = entry_path(writer->key, ".meta");
+	data_path = entry_path(writer->key, ".data");
+	meta = g_key_file_new();
+	g_mutex_lock(&entry_lock);
+	g_key_file_set_string(meta, CACHE_GROUP, "uri", writer->uri);
+	if (writer->etag)
+		g_key_file_set_string(meta, CACHE_GROUP, "etag", writer->etag);
+	if (writer->last_modified)
+		g_key_file_set_string(meta, CACHE_GROUP, "last-modified", writer->last_modified);
+	g_key_file_set_uint64(meta, CACHE_GROUP, "size", writer->offset);
+	g_key_file_set_int64(meta, CACHE_GROUP, "validated", now);
+	g_key_file_set_int64(meta, CACHE_GROUP, "used", now);
+
+	if (g_rename(writer->part_path, data_path) == 0 && g_key_file_save_to_file(meta, meta_path, NULL))
+	{
+		writer->committed = TRUE;
+		GPlayerDEBUG("cached %s, %" G_GUINT64_FORMAT " bytes", writer->uri, writer->offset);
+		frame_index_finish(writer->index);
+		index_path = entry_path(writer->key, ".index");
+		frame_index_save(writer->index, index_path);
+		g_free(index_path);
+		evict();
+	}
+	else
+	{
+		remove_entry(writer->key);
+		fail(writer);
+	}
+	g_mutex_unlock(&entry_lock);
+	g_key_file_free(meta);
+	g_free(meta_path);
+	g_free(data_path);
+}
+
+static gboolean find_validator(GQuark field, const GValue *value, gpointer userdata)
+{
+	CacheWriter *writer = userdata;
+	const gchar *name = g_quark_to_string(field);
+
+	if (!G_VALUE_HOLDS_STRING(value))
+		return TRUE;
+	if (g_ascii_strcasecmp(name, "ETag") == 0)
+		writer->etag = g_value_dup_string(value);
+	else if (g_ascii_strcasecmp(name, "Last-Modified") == 0)
+		writer->last_modified = g_value_dup_string(value);
+	return TRUE;
+}
+
+static void write_buffer(CacheWriter *writer, GstPad *pad, GstBuffer *buffer)
+{
+	GstMapInfo map;
+	gint64 length;
+
+	if (!writer->started)
+	{
+		/* Endless streams and downloads that would take up the whole cache are not kept */
+		writer->started = TRUE;
+		if (!gst_pad_query_duration(pad, GST_FORMAT_BYTES, &length) || length <= 0 || (guint64) length > get_max_size() / 2)
+		{
+			fail(writer);
+			return;
+		}
+	}
+
+	/* Only a download from the start to the end, without seeks, is kept */
+	if (GST_BUFFER_OFFSET_IS_VALID(buffer) && GST_BUFFER_OFFSET(buffer) != writer->offset)
+	{
+		fail(writer);
+		return;
+	}
+
+	gst_buffer_map(buffer, &map, GST_MAP_READ);
+	frame_index_add(writer->index, writer->offset, map.data, map.size);
+	if (fwrite(map.data, 1, map.size, writer->file) != map.size)
+		fail(writer);
+	writer->offset += map.size;
+	gst_buffer_unmap(buffer, &map);
+}
+
+GstPadProbeReturn cache_writer_probe(GstPad *pad, GstPadProbeInfo *info, CacheWriter *writer)
+{
+	if (writer->failed || writer->committed)
+		return GST_PAD_PROBE_OK;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER)
+	{
+		write_buffer(writer, pad, GST_PAD_PROBE_INFO_BUFFER(info));
+	}
+	else if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+	{
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+		guint i;
+
+		for (i = 0; i < gst_buffer_list_length(list) && !writer->failed; i++)
+			write_buffer(writer, pad, gst_buffer_list_get(list, i));
+	}
+	else if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+	{
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+		const GstStructure *structure;
+		const GstSegment *segment;
+		gint64 length;
+
+		switch (GST_EVENT_TYPE(event))
+		{
+		case GST_EVENT_CUSTOM_DOWNSTREAM_STICKY:
+			/* souphttpsrc tells the response headers */
+			structure = gst_event_get_structure(event);
+			if (structure && gst_structure_has_name(structure, "http-headers") && gst_structure_has_field(structure, "response-headers"))
+			{
+				g_free(writer->etag);
+				g_free(writer->last_modified);
+				writer->etag = writer->last_modified = NULL;
+				gst_structure_foreach(gst_value_get_structure(gst_structure_get_value(structure, "response-headers")), find_validator, writer);
+			}
+			break;
+		case GST_EVENT_SEGMENT:
+			gst_event_parse_segment(event, &segment);
+			if (segment->format == GST_FORMAT_BYTES && segment->start != writer->offset)
+				fail(writer);
+			break;
+		case GST_EVENT_EOS:
+			if (!writer->etag && !writer->last_modified)
+			{
+				/* It could never be validated */
+				fail(writer);
+			}
+			else if (gst_pad_query_duration(pad, GST_FORMAT_BYTES, &length) && (guint64) length == writer->offset)
+				commit(writer);
+			else
+				fail(writer);
+			break;
+		default:
+			break;
+		}
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+/*
+ * Source element reading a cached copy in push mode
+ */
+
+/* Parsers in pull mode seek on their own, only in push mode do they pass the byte seeks of the frame index
+ * upstream, so indexed copies are played through this source instead of filesrc */
+typedef struct _CacheSrc
+{
+	GstBaseSrc parent;
+	gchar *uri;
+	FILE *file;
+	guint64 file_offset;
+	guint64 size;
+} CacheSrc;
+
+typedef struct _CacheSrcClass
+{
+	GstBaseSrcClass parent_class;
+} CacheSrcClass;
+
+static void cache_src_uri_handler_init(gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE(CacheSrc, cache_src, GST_TYPE_BASE_SRC, G_IMPLEMENT_INTERFACE(GST_TYPE_URI_HANDLER, cache_src_uri_handler_init));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static gboolean cache_src_start(GstBaseSrc *src)
+{
+	CacheSrc *self = (CacheSrc *) src;
+	gchar *path = self->uri ? g_filename_from_uri(self->uri + strlen(CACHE_SCHEME_PREFIX), NULL, NULL) : NULL;
+	GStatBuf st;
+
+	if (path)
+		self->file = g_fopen(path, "rb");
+	if (!self->file || g_stat(path, &st) != 0)
+	{
+		GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, ("Could not open %s", self->uri), (NULL));
+		g_free(path);
+		return FALSE;
+	}
+	self->size = st.st_size;
+	self->file_offset = 0;
+	g_free(path);
+	return TRUE;
+}
+
+static gboolean cache_src_stop(GstBaseSrc *src)
+{
+	CacheSrc *self = (CacheSrc *) src;
+
+	if (self->file)
+	{
+		fclose(self->file);
+		self->file = NULL;
+	}
+	return TRUE;
+}
+
+static gboolean cache_src_get_size(GstBaseSrc *src, guint64 *size)
+{
+	*size = ((CacheSrc *) src)->size;
+	return TRUE;
+}
+
+static gboolean cache_src_is_seekable(GstBaseSrc *src)
+{
+	return TRUE;
+}
+
+static gboolean cache_src_query(GstBaseSrc *src, GstQuery *query)
+{
+	if (GST_QUERY_TYPE(query) == GST_QUERY_SCHEDULING)
+	{
+		gst_query_set_scheduling(query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+		gst_query_add_scheduling_mode(query, GST_PAD_MODE_PUSH);
+		return TRUE;
+	}
+	return GST_BASE_SRC_CLASS(cache_src_parent_class)->query(src, query);
+}
+
+static GstFlowReturn cache_src_create(GstBaseSrc *src, guint64 offset, guint length, GstBuffer **buffer)
+{
+	CacheSrc *self = (CacheSrc *) src;
+	GstMapInfo map;
+	size_t n;
+
+	if (offset >= self->size)
+		return GST_FLOW_EOS;
+	if (offset != self->file_offset && fseeko(self->file, offset, SEEK_SET) != 0)
+	{
+		GST_ELEMENT_ERROR(self, RESOURCE, SEEK, ("Could not seek in %s", self->uri), (NULL));
+		return GST_FLOW_ERROR;
+	}
+
+	*buffer = gst_buffer_new_allocate(NULL, length, NULL);
+	gst_buffer_map(*buffer, &map, GST_MAP_WRITE);
+	n = fread(map.data, 1, length, self->file);
+	gst_buffer_unmap(*buffer, &map);
+	if (n == 0)
+	{
+		gst_buffer_unref(*buffer);
+		*buffer = NULL;
+		GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not read %s", self->uri), (NULL));
+		return GST_FLOW_ERROR;
+	}
+
+	gst_buffer_set_size(*buffer, n);
+	GST_BUFFER_OFFSET(*buffer) = offset;
+	self->file_offset = offset + n;
+	return GST_FLOW_OK;
+}
+
+static void cache_src_finalize(GObject *object)
+{
+	g_free(((CacheSrc *) object)->uri);
+	G_OBJECT_CLASS(cache_src_parent_class)->finalize(object);
+}
+
+static void cache_src_class_init(CacheSrcClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS(klass);
+
+	gobject_class->finalize = cache_src_finalize;
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_template));
+	gst_element_class_set_static_metadata(element_class, "GPlayer cache source", "Source/File",
+			"Plays a cached copy in push mode", "GPlayer");
+	basesrc_class->start = cache_src_start;
+	basesrc_class->stop = cache_src_stop;
+	basesrc_class->get_size = cache_src_get_size;
+	basesrc_class->is_seekable = cache_src_is_seekable;
+	basesrc_class->query = cache_src_query;
+	basesrc_class->create = cache_src_create;
+}
+
+static void cache_src_init(CacheSrc *self)
+{
+	gst_base_src_set_format(GST_BASE_SRC(self), GST_FORMAT_BYTES);
+}
+
+static GstURIType cache_src_uri_get_type(GType type)
+{
+	return GST_URI_SRC;
+}
+
+static const gchar * const *cache_src_uri_get_protocols(GType type)
+{
+	static const gchar *protocols[] = { CACHE_SCHEME_PREFIX "file", NULL };
+	return protocols;
+}
+
+static gchar *cache_src_uri_get_uri(GstURIHandler *handler)
+{
+	return g_strdup(((CacheSrc *) handler)->uri);
+}
+
+static gboolean cache_src_uri_set_uri(GstURIHandler *handler, const gchar *uri, GError **error)
+{
+	CacheSrc *self = (CacheSrc *) handler;
+
+	if (!g_str_has_prefix(uri, CACHE_SCHEME_PREFIX "file://"))
+	{
+		g_set_error(error, GST_URI_ERROR, GST_URI_ERROR_UNSUPPORTED_PROTOCOL, "Not a cached copy: %s", uri);
+		return FALSE;
+	}
+	g_free(self->uri);
+	self->uri = g_strdup(uri);
+	return TRUE;
+}
+
+static void cache_src_uri_handler_init(gpointer g_iface, gpointer iface_data)
+{
+	GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+	iface->get_type = cache_src_uri_get_type;
+	iface->get_protocols = cache_src_uri_get_protocols;
+	iface->get_uri = cache_src_uri_get_uri;
+	iface->set_uri = cache_src_uri_set_uri;
+}
+
+void cache_init(void)
+{
+	gst_element_register(NULL, "gplayercachesrc", GST_RANK_PRIMARY, cache_src_get_type());
+	background = g_thread_pool_new((GFunc) run_task, NULL, 1, FALSE, NULL);
+}
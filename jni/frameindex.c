@@ -0,0 +1,518 @@
+/*
+ * frameindex.c
+ *
+ *  Frame header parsing for MP3 and ADTS, and the frame index file kept next to a cached copy.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include "include/frameindex.h"
+
+/* Enough for an ID3v2 tag header, the longest of the headers looked at */
+#define HEADER_SIZE 10
+#define SCAN_CHUNK_SIZE (64 * 1024)
+/* "GPIX" */
+#define INDEX_MAGIC 0x58495047
+#define INDEX_VERSION 1
+
+typedef enum
+{
+	FORMAT_UNKNOWN,
+	FORMAT_MPEG,
+	FORMAT_ADTS
+} StreamFormat;
+
+typedef struct _FrameIndexEntry
+{
+	guint64 offset;
+	guint64 sample;
+} FrameIndexEntry;
+
+/* Stored in host byte order, the cache never leaves the device */
+typedef struct _FrameIndexFileHeader
+{
+	guint32 magic;
+	guint32 version;
+	guint32 rate;
+	guint32 count;
+	guint64 samples;
+} FrameIndexFileHeader;
+
+struct _FrameIndex
+{
+	gint refcount;
+	GMutex lock;
+	GArray *entries;
+	StreamFormat format;
+	/* Header bits every frame of the stream shares */
+	guint32 reference;
+	guint rate;
+	gboolean tag_checked;
+	guint64 tag_size;
+	/* Two frames in a row were found, anything else is no MP3 or ADTS stream */
+	gboolean locked;
+	gboolean broken;
+	/* No frames follow, an ID3v1 tag or the end of the data was reached */
+	gboolean ended;
+	guint frames;
+	/* Bytes seen from the start of the stream, the last ones kept for headers crossing buffers */
+	guint64 covered;
+	guint8 carry[HEADER_SIZE - 1];
+	guint carry_length;
+	guint64 next_frame;
+	/* Samples of the frames before next_frame */
+	guint64 samples;
+};
+
+static const guint16 mpeg_bitrates[5][15] = {
+	{ 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+	{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+	{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+	{ 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+	{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+};
+
+static const guint mpeg_rates[3] = { 44100, 48000, 32000 };
+
+static const guint adts_rates[13] = { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350 };
+
+FrameIndex *frame_index_new(void)
+{
+	FrameIndex *index = g_new0(FrameIndex, 1);
+
+	index->refcount = 1;
+	g_mutex_init(&index->lock);
+	index->entries = g_array_new(FALSE, FALSE, sizeof(FrameIndexEntry));
+	return index;
+}
+
+FrameIndex *frame_index_ref(FrameIndex *index)
+{
+	g_atomic_int_inc(&index->refcount);
+	return index;
+}
+
+void frame_index_unref(FrameIndex *index)
+{
+	if (!g_atomic_int_dec_and_test(&index->refcount))
+		return;
+	g_array_free(index->entries, TRUE);
+	g_mutex_clear(&index->lock);
+	g_free(index);
+}
+
+static gboolean parse_mpeg(FrameIndex *index, const guint8 *h, guint *length, guint *samples)
+{
+	guint version = (h[1] >> 3) & 3, layer = 4 - ((h[1] >> 1) & 3), bitrate_index = h[2] >> 4, rate_index = (h[2] >> 2) & 3;
+	guint padding = (h[2] >> 1) & 1, rate, bitrate;
+
+	/* Reserved version, layer and sample rate, free format and bad bitrates */
+	if (version == 1 || layer == 4 || rate_index == 3 || bitrate_index == 0 || bitrate_index == 15)
+		return FALSE;
+
+	rate = mpeg_rates[rate_index] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+	bitrate = mpeg_bitrates[version == 3 ? layer - 1 : layer == 1 ? 3 : 4][bitrate_index] * 1000;
+
+	if (layer == 1)
+	{
+		*length = (12 * bitrate / rate + padding) * 4;
+		*samples = 384;
+	}
+	else if (layer == 2 || version == 3)
+	{
+		*length = 144 * bitrate / rate + padding;
+		*samples = 1152;
+	}
+	else
+	{
+		*length = 72 * bitrate / rate + padding;
+		*samples = 576;
+	}
+	index->rate = rate;
+	return TRUE;
+}
+
+static gboolean parse_adts(FrameIndex *index, const guint8 *h, guint *length, guint *samples)
+{
+	guint rate_index = (h[2] >> 2) & 0xf;
+
+	if (rate_index >= G_N_ELEMENTS(adts_rates))
+		return FALSE;
+	*length = ((h[3] & 3) << 11) | (h[4] << 3) | (h[5] >> 5);
+	*samples = 1024 * ((h[6] & 3) + 1);
+	index->rate = adts_rates[rate_index];
+	return *length >= 7;
+}
+
+/* The first header decides the format, the following ones have to share its version, layer and rate */
+static gboolean parse_header(FrameIndex *index, const guint8 *h, guint *length, guint *samples)
+{
+	StreamFormat format;
+	guint32 reference;
+
+	if (h[0] != 0xff || (h[1] & 0xe0) != 0xe0)
+		return FALSE;
+
+	if ((h[1] & 0xf6) == 0xf0)
+	{
+		format = FORMAT_ADTS;
+		reference = (h[1] & 0xf6) << 16 | (h[2] & 0xfd) << 8 | (h[3] & 0xc0);
+	}
+	else
+	{
+		format = FORMAT_MPEG;
+		reference = (h[1] & 0xfe) << 16 | (h[2] & 0x0c) << 8;
+	}
+
+	if (index->format == FORMAT_UNKNOWN)
+	{
+		index->format = format;
+		index->reference = reference;
+	}
+	else if (format != index->format || reference != index->reference)
+	{
+		return FALSE;
+	}
+
+	if (format == FORMAT_ADTS)
+		return parse_adts(index, h, length, samples);
+	return parse_mpeg(index, h, length, samples);
+}
+
+/* n bytes at the stream offset position, out of the kept bytes and the current buffer */
+static gboolean get_bytes(FrameIndex *index, guint64 offset, const guint8 *data, gsize size, guint64 position, guint8 *out, guint n)
+{
+	guint64 first = offset - index->carry_length;
+	guint i;
+
+	if (position < first || position + n > offset + size)
+		return FALSE;
+	for (i = 0; i < n; i++)
+	{
+		guint64 p = position + i;
+		out[i] = p < offset ? index->carry[p - first] : data[p - offset];
+	}
+	return TRUE;
+}
+
+/* A Xing, Info or VBRI frame at the start of an MP3 carries no audio */
+static gboolean is_info_frame(FrameIndex *index, guint64 offset, const guint8 *data, gsize size)
+{
+	guint8 frame[40];
+	guint i;
+
+	if (index->format != FORMAT_MPEG || !get_bytes(index, offset, data, size, index->next_frame, frame, sizeof(frame)))
+		return FALSE;
+	for (i = 4; i + 4 <= sizeof(frame); i++)
+	{
+		if (memcmp(frame + i, "Xing", 4) == 0 || memcmp(frame + i, "Info", 4) == 0 || memcmp(frame + i, "VBRI", 4) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void keep_tail(FrameIndex *index, guint64 offset, const guint8 *data, gsize size)
+{
+	guint8 tail[HEADER_SIZE - 1];
+	guint64 end = offset + size;
+	guint length = MIN(sizeof(tail), end);
+
+	if (get_bytes(index, offset, data, size, end - length, tail, length))
+	{
+		memcpy(index->carry, tail, length);
+		index->carry_length = length;
+	}
+	else
+	{
+		index->carry_length = 0;
+	}
+}
+
+void frame_index_add(FrameIndex *index, guint64 offset, const guint8 *data, gsize size)
+{
+	guint8 header[HEADER_SIZE];
+	guint length, samples;
+
+	g_mutex_lock(&index->lock);
+	if (index->broken || index->ended || offset != index->covered)
+	{
+		g_mutex_unlock(&index->lock);
+		return;
+	}
+
+	while (get_bytes(index, offset, data, size, index->next_frame, header, HEADER_SIZE))
+	{
+		if (!index->tag_checked)
+		{
+			index->tag_checked = TRUE;
+			if (memcmp(header, "ID3", 3) == 0)
+			{
+				index->tag_size = 10 + ((header[6] & 0x7f) << 21 | (header[7] & 0x7f) << 14 | (header[8] & 0x7f) << 7 | (header[9] & 0x7f));
+				if (header[5] & 0x10)
+					index->tag_size += 10;
+				index->next_frame = index->tag_size;
+			}
+			continue;
+		}
+
+		if (!parse_header(index, header, &length, &samples))
+		{
+			if (index->locked)
+				index->ended = TRUE;
+			else
+				index->broken = TRUE;
+			break;
+		}
+		if (index->frames == 0 && is_info_frame(index, offset, data, size))
+			samples = 0;
+
+		if (index->entries->len == 0
+				|| gst_util_uint64_scale(index->samples - g_array_index(index->entries, FrameIndexEntry, index->entries->len - 1).sample, GST_SECOND,
+						index->rate) >= FRAME_INDEX_INTERVAL)
+		{
+			FrameIndexEntry entry = { index->next_frame - index->tag_size, index->samples };
+			g_array_append_val(index->entries, entry);
+		}
+
+		index->samples += samples;
+		index->next_frame += length;
+		if (++index->frames >= 2)
+			index->locked = TRUE;
+	}
+
+	keep_tail(index, offset, data, size);
+	index->covered = offset + size;
+	g_mutex_unlock(&index->lock);
+}
+
+void frame_index_finish(FrameIndex *index)
+{
+	g_mutex_lock(&index->lock);
+	index->ended = TRUE;
+	g_mutex_unlock(&index->lock);
+}
+
+gboolean frame_index_lookup(FrameIndex *index, GstClockTime position, guint64 *offset, GstClockTime *time)
+{
+	FrameIndexEntry *entry;
+	guint64 sample;
+	guint low, high;
+	gboolean found = FALSE;
+
+	g_mutex_lock(&index->lock);
+	if (!index->locked || index->broken || index->entries->len == 0
+			|| position >= gst_util_uint64_scale(index->samples, GST_SECOND, index->rate))
+		goto exit;
+
+	sample = gst_util_uint64_scale(position > FRAME_INDEX_PREROLL ? position - FRAME_INDEX_PREROLL : 0, index->rate, GST_SECOND);
+
+	/* The last entry at or before sample, the first one starts at sample 0 */
+	low = 0;
+	high = index->entries->len - 1;
+	while (low < high)
+	{
+		guint middle = (low + high + 1) / 2;
+
+		if (g_array_index(index->entries, FrameIndexEntry, middle).sample <= sample)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	entry = &g_array_index(index->entries, FrameIndexEntry, low);
+	*offset = entry->offset;
+	*time = gst_util_uint64_scale(entry->sample, GST_SECOND, index->rate);
+	found = TRUE;
+
+exit:
+	g_mutex_unlock(&index->lock);
+	return found;
+}
+
+gboolean frame_index_save(FrameIndex *index, const gchar *path)
+{
+	FrameIndexFileHeader header;
+	GByteArray *bytes;
+	gboolean saved = FALSE;
+
+	g_mutex_lock(&index->lock);
+	if (index->locked && !index->broken)
+	{
+		header.magic = INDEX_MAGIC;
+		header.version = INDEX_VERSION;
+		header.rate = index->rate;
+		header.count = index->entries->len;
+		header.samples = index->samples;
+		bytes = g_byte_array_new();
+		g_byte_array_append(bytes, (const guint8 *) &header, sizeof(header));
+		g_byte_array_append(bytes, (const guint8 *) index->entries->data, index->entries->len * sizeof(FrameIndexEntry));
+		saved = g_file_set_contents(path, (const gchar *) bytes->data, bytes->len, NULL);
+		g_byte_array_free(bytes, TRUE);
+	}
+	g_mutex_unlock(&index->lock);
+	return saved;
+}
+
+FrameIndex *frame_index_load(const gchar *path)
+{
+	FrameIndexFileHeader header;
+	FrameIndex *index;
+	gchar *contents;
+	gsize length;
+
+	if (!g_file_get_contents(path, &contents, &length, NULL))
+		return NULL;
+
+	if (length < sizeof(header))
+	{
+		g_free(contents);
+		return NULL;
+	}
+	memcpy(&header, contents, sizeof(header));
+	if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION || header.rate == 0 || header.count == 0
+			|| length != sizeof(header) + header.count * sizeof(FrameIndexEntry))
+	{
+		g_free(contents);
+		return NULL;
+	}
+
+	index = frame_index_new();
+	index->rate = header.rate;
+	index->samples = header.samples;
+	index->locked = TRUE;
+	index->ended = TRUE;
+	g_array_append_vals(index->entries, contents + sizeof(header), header.count);
+	g_free(contents);
+	return index;
+}
+
+FrameIndex *frame_index_scan_file(const gchar *path)
+{
+	FrameIndex *index;
+	guint8 *chunk;
+	guint64 offset = 0;
+	gsize size;
+	FILE *file = g_fopen(path, "rb");
+
+	if (!file)
+		return NULL;
+
+	index = frame_index_new();
+	chunk = g_malloc(SCAN_CHUNK_SIZE);
+	while (!index->broken && !index->ended && (size = fread(chunk, 1, SCAN_CHUNK_SIZE, file)) > 0)
+	{
+		frame_index_add(index, offset, chunk, size);
+		offset += size;
+	}
+	g_free(chunk);
+	fclose(file);
+
+	frame_index_finish(index);
+	if (!index->locked || index->broken)
+	{
+		frame_index_unref(index);
+		return NULL;
+	}
+	return index;
+}
+
+gboolean indexed_seek_start(IndexedSeek *seek, GstElement *pipeline, FrameIndex *index, GstClockTime position)
+{
+	guint64 offset;
+	GstClockTime time;
+
+	if (!index || !frame_index_lookup(index, position, &offset, &time))
+		return FALSE;
+
+	seek->state = INDEXED_SEEK_ARMED;
+	seek->pad = NULL;
+	seek->target = position;
+	seek->frame_time = time;
+	if (!gst_element_seek(pipeline, 1.0, GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, offset, GST_SEEK_TYPE_NONE, -1))
+	{
+		seek->state = INDEXED_SEEK_NONE;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* The parser only estimates the time of a byte position, its segment and timestamps are moved to the time of
+ * the frame the seek went to */
+GstPadProbeReturn indexed_seek_probe(GstPad *pad, GstPadProbeInfo *info, IndexedSeek *seek)
+{
+	GstEvent *event;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER)
+	{
+		GstBuffer *buffer;
+		GstClockTimeDiff pts;
+
+		if (seek->state != INDEXED_SEEK_ACTIVE || pad != seek->pad)
+			return GST_PAD_PROBE_OK;
+		buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+		if (GST_BUFFER_PTS_IS_VALID(buffer))
+		{
+			pts = (GstClockTimeDiff) GST_BUFFER_PTS(buffer) + seek->pts_offset;
+			GST_BUFFER_PTS(buffer) = MAX(pts, 0);
+		}
+		GST_PAD_PROBE_INFO_DATA(info) = buffer;
+		return GST_PAD_PROBE_OK;
+	}
+
+	event = GST_PAD_PROBE_INFO_EVENT(info);
+	switch (GST_EVENT_TYPE(event))
+	{
+	case GST_EVENT_FLUSH_STOP:
+		if (seek->state == INDEXED_SEEK_ARMED)
+		{
+			seek->state = INDEXED_SEEK_FLUSHED;
+			seek->pad = pad;
+		}
+		else if (pad == seek->pad)
+		{
+			seek->state = INDEXED_SEEK_NONE;
+		}
+		break;
+	case GST_EVENT_SEGMENT:
+		if (pad != seek->pad)
+			break;
+		if (seek->state == INDEXED_SEEK_FLUSHED)
+		{
+			const GstSegment *in;
+			GstSegment segment;
+			GstEvent *replacement;
+
+			gst_event_parse_segment(event, &in);
+			if (in->format != GST_FORMAT_TIME)
+			{
+				seek->state = INDEXED_SEEK_NONE;
+				break;
+			}
+			gst_segment_init(&segment, GST_FORMAT_TIME);
+			segment.rate = in->rate;
+			segment.start = seek->target;
+			segment.position = seek->target;
+			segment.time = seek->target;
+			seek->pts_offset = (GstClockTimeDiff) seek->frame_time - (GstClockTimeDiff) in->start;
+
+			replacement = gst_event_new_segment(&segment);
+			gst_event_set_seqnum(replacement, gst_event_get_seqnum(event));
+			gst_event_unref(event);
+			GST_PAD_PROBE_INFO_DATA(info) = replacement;
+			seek->state = INDEXED_SEEK_ACTIVE;
+		}
+		else
+		{
+			seek->state = INDEXED_SEEK_NONE;
+		}
+		break;
+	case GST_EVENT_STREAM_START:
+		if (pad == seek->pad)
+			seek->state = INDEXED_SEEK_NONE;
+		break;
+	default:
+		break;
+	}
+	return GST_PAD_PROBE_OK;
+}
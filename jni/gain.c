@@ -0,0 +1,373 @@
+/*
+ * gain.c
+ *
+ *  The gplayergain element, separate left and right gains applied in place to S16 and F32 audio.
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include <gst/audio/audio.h>
+#include "include/gain.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(GPLAYER_GAIN_NEON)
+#include <cpu-features.h>
+#endif
+
+/* Fixed point of the S16 ramps, fine enough for steps of a 20 ms ramp */
+#define RAMP_FRAC_BITS 24
+
+#ifdef GAIN_NEON
+/* Set in gain_init, if the NEON kernels of gain_neon.c can run on this CPU */
+static gboolean use_neon;
+#endif
+
+/*
+ * Kernels, over interleaved samples of one or two channels. The gains alternate left and right, so any
+ * run of whole frames starts with the left one.
+ */
+
+static inline gint16 scale_s16(gint16 sample, gint gain)
+{
+	return CLAMP((sample * gain) >> GAIN_FRAC_BITS, G_MININT16, G_MAXINT16);
+}
+
+static void gain_s16(gint16 *samples, gsize count, gint left, gint right)
+{
+	gsize i = 0;
+
+#if defined(__SSE2__)
+	__m128i gain = _mm_set_epi16(right, left, right, left, right, left, right, left);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i *) (samples + i));
+		__m128i low = _mm_mullo_epi16(in, gain);
+		__m128i high = _mm_mulhi_epi16(in, gain);
+		__m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(low, high), GAIN_FRAC_BITS);
+		__m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(low, high), GAIN_FRAC_BITS);
+		_mm_storeu_si128((__m128i *) (samples + i), _mm_packs_epi32(a, b));
+	}
+#elif defined(GAIN_NEON)
+	if (use_neon)
+		i = gain_s16_neon(samples, count, left, right);
+#endif
+	for (; i + 2 <= count; i += 2)
+	{
+		samples[i] = scale_s16(samples[i], left);
+		samples[i + 1] = scale_s16(samples[i + 1], right);
+	}
+	if (i < count)
+		samples[i] = scale_s16(samples[i], left);
+}
+
+static void gain_f32(gfloat *samples, gsize count, gfloat left, gfloat right)
+{
+	gsize i = 0;
+
+#if defined(__SSE2__)
+	__m128 gain = _mm_set_ps(right, left, right, left);
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gain));
+#elif defined(GAIN_NEON)
+	if (use_neon)
+		i = gain_f32_neon(samples, count, left, right);
+#endif
+	for (; i + 2 <= count; i += 2)
+	{
+		samples[i] *= left;
+		samples[i + 1] *= right;
+	}
+	if (i < count)
+		samples[i] *= left;
+}
+
+/* Ramps are short, they are done per frame without vectors. The S16 one stays on integer math like the
+ * kernels, so armeabi does not run soft-float per sample; F32 audio is float anyway. */
+static void ramp_s16(gint16 *samples, gsize frames, gint channels, gfloat *gain, const gfloat *step)
+{
+	gint32 g[2], s[2];
+	gsize i;
+	gint c;
+
+	for (c = 0; c < channels; c++)
+	{
+		g[c] = gain[c] * (1 << RAMP_FRAC_BITS);
+		s[c] = step[c] * (1 << RAMP_FRAC_BITS);
+	}
+	for (i = 0; i < frames; i++)
+	{
+		for (c = 0; c < channels; c++, samples++)
+		{
+			g[c] += s[c];
+			*samples = CLAMP(((gint64) *samples * g[c]) >> RAMP_FRAC_BITS, G_MININT16, G_MAXINT16);
+		}
+	}
+	for (c = 0; c < channels; c++)
+		gain[c] = (gfloat) g[c] / (1 << RAMP_FRAC_BITS);
+}
+
+static void ramp_f32(gfloat *samples, gsize frames, gint channels, gfloat *gain, const gfloat *step)
+{
+	gsize i;
+	gint c;
+
+	for (i = 0; i < frames; i++)
+	{
+		for (c = 0; c < channels; c++, samples++)
+		{
+			gain[c] += step[c];
+			*samples *= gain[c];
+		}
+	}
+}
+
+/*
+ * Element
+ */
+
+enum
+{
+	PROP_0,
+	PROP_LEFT,
+	PROP_RIGHT
+};
+
+typedef struct _GainFilter
+{
+	GstBaseTransform parent;
+	/* Set by the application. The lock also orders the passthrough switches of both threads. */
+	GMutex lock;
+	gdouble left;
+	gdouble right;
+	/* Streaming thread only */
+	GstAudioInfo info;
+	gboolean started;
+	gfloat target[2];
+	gfloat gain[2];
+	gfloat step[2];
+	gsize ramp_frames;
+} GainFilter;
+
+typedef struct _GainFilterClass
+{
+	GstBaseTransformClass parent_class;
+} GainFilterClass;
+
+G_DEFINE_TYPE(GainFilter, gain_filter, GST_TYPE_BASE_TRANSFORM);
+
+#define GAIN_CAPS "audio/x-raw, format = (string) { " GST_AUDIO_NE(S16) ", " GST_AUDIO_NE(F32) " }, " \
+	"rate = (int) [ 1, MAX ], channels = (int) [ 1, 2 ], layout = (string) interleaved"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(GAIN_CAPS));
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(GAIN_CAPS));
+
+static gboolean is_unity(const gfloat *gain)
+{
+	return gain[0] == 1.0f && gain[1] == 1.0f;
+}
+
+static gboolean gain_filter_set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+	return gst_audio_info_from_caps(&((GainFilter *) trans)->info, incaps);
+}
+
+static gboolean gain_filter_start(GstBaseTransform *trans)
+{
+	((GainFilter *) trans)->started = FALSE;
+	return TRUE;
+}
+
+static void get_target(GainFilter *self, gfloat *target)
+{
+	g_mutex_lock(&self->lock);
+	target[0] = self->left;
+	target[1] = self->right;
+	g_mutex_unlock(&self->lock);
+	if (GST_AUDIO_INFO_CHANNELS(&self->info) == 1)
+		target[0] = target[1] = (target[0] + target[1]) / 2;
+}
+
+/* The first buffer of a stream is played at the gains as they are, also when it is passed through */
+static void gain_filter_before_transform(GstBaseTransform *trans, GstBuffer *buffer)
+{
+	GainFilter *self = (GainFilter *) trans;
+
+	if (self->started)
+		return;
+	get_target(self, self->target);
+	self->gain[0] = self->target[0];
+	self->gain[1] = self->target[1];
+	self->ramp_frames = 0;
+	self->started = TRUE;
+}
+
+/* Starts a ramp to changed gains */
+static void update_target(GainFilter *self)
+{
+	gfloat target[2];
+	gint c;
+
+	get_target(self, target);
+	if (target[0] == self->target[0] && target[1] == self->target[1])
+		return;
+	self->target[0] = target[0];
+	self->target[1] = target[1];
+	self->ramp_frames = MAX(gst_util_uint64_scale_int(GAIN_RAMP_TIME, GST_AUDIO_INFO_RATE(&self->info), GST_SECOND), 1);
+	for (c = 0; c < 2; c++)
+		self->step[c] = (target[c] - self->gain[c]) / self->ramp_frames;
+}
+
+static GstFlowReturn gain_filter_transform_ip(GstBaseTransform *trans, GstBuffer *buffer)
+{
+	GainFilter *self = (GainFilter *) trans;
+	gint channels = GST_AUDIO_INFO_CHANNELS(&self->info);
+	gsize frames, ramp;
+	GstMapInfo map;
+	guint8 *data;
+
+	update_target(self);
+	if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP) && self->ramp_frames == 0)
+		return GST_FLOW_OK;
+
+	gst_buffer_map(buffer, &map, GST_MAP_READWRITE);
+	data = map.data;
+	frames = map.size / GST_AUDIO_INFO_BPF(&self->info);
+
+	ramp = MIN(frames, self->ramp_frames);
+	if (ramp > 0)
+	{
+		if (GST_AUDIO_INFO_FORMAT(&self->info) == GST_AUDIO_FORMAT_S16)
+			ramp_s16((gint16 *) data, ramp, channels, self->gain, self->step);
+		else
+			ramp_f32((gfloat *) data, ramp, channels, self->gain, self->step);
+		self->ramp_frames -= ramp;
+		if (self->ramp_frames == 0)
+		{
+			self->gain[0] = self->target[0];
+			self->gain[1] = self->target[1];
+		}
+		data += ramp * GST_AUDIO_INFO_BPF(&self->info);
+		frames -= ramp;
+	}
+
+	if (frames > 0 && !is_unity(self->gain))
+	{
+		if (self->gain[0] == 0.0f && self->gain[1] == 0.0f)
+			memset(data, 0, frames * GST_AUDIO_INFO_BPF(&self->info));
+		else if (GST_AUDIO_INFO_FORMAT(&self->info) == GST_AUDIO_FORMAT_S16)
+			gain_s16((gint16 *) data, frames * channels, MIN(self->gain[0] * (1 << GAIN_FRAC_BITS), G_MAXINT16),
+					MIN(self->gain[1] * (1 << GAIN_FRAC_BITS), G_MAXINT16));
+		else
+			gain_f32((gfloat *) data, frames * channels, self->gain[0], self->gain[1]);
+	}
+	gst_buffer_unmap(buffer, &map);
+
+	/* Back to passing buffers untouched, unless the gains changed meanwhile */
+	if (self->ramp_frames == 0 && is_unity(self->gain))
+	{
+		g_mutex_lock(&self->lock);
+		if (self->left == 1.0 && self->right == 1.0)
+			gst_base_transform_set_passthrough(trans, TRUE);
+		g_mutex_unlock(&self->lock);
+	}
+	return GST_FLOW_OK;
+}
+
+static void gain_filter_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GainFilter *self = (GainFilter *) object;
+
+	g_mutex_lock(&self->lock);
+	switch (prop_id)
+	{
+	case PROP_LEFT:
+		self->left = g_value_get_double(value);
+		break;
+	case PROP_RIGHT:
+		self->right = g_value_get_double(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+	if (self->left != 1.0 || self->right != 1.0)
+		gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(self), FALSE);
+	g_mutex_unlock(&self->lock);
+}
+
+static void gain_filter_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GainFilter *self = (GainFilter *) object;
+
+	g_mutex_lock(&self->lock);
+	switch (prop_id)
+	{
+	case PROP_LEFT:
+		g_value_set_double(value, self->left);
+		break;
+	case PROP_RIGHT:
+		g_value_set_double(value, self->right);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+	g_mutex_unlock(&self->lock);
+}
+
+static void gain_filter_finalize(GObject *object)
+{
+	g_mutex_clear(&((GainFilter *) object)->lock);
+	G_OBJECT_CLASS(gain_filter_parent_class)->finalize(object);
+}
+
+static void gain_filter_class_init(GainFilterClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->finalize = gain_filter_finalize;
+	gobject_class->set_property = gain_filter_set_property;
+	gobject_class->get_property = gain_filter_get_property;
+	g_object_class_install_property(gobject_class, PROP_LEFT,
+			g_param_spec_double("left", "Left", "Gain of the left channel", 0.0, GAIN_MAX, 1.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_RIGHT,
+			g_param_spec_double("right", "Right", "Gain of the right channel", 0.0, GAIN_MAX, 1.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_template));
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_template));
+	gst_element_class_set_static_metadata(element_class, "GPlayer gain", "Filter/Effect/Audio",
+			"Applies separate left and right gains", "GPlayer");
+
+	transform_class->set_caps = gain_filter_set_caps;
+	transform_class->start = gain_filter_start;
+	transform_class->before_transform = gain_filter_before_transform;
+	transform_class->transform_ip = gain_filter_transform_ip;
+	/* Unity gain is a plain passthrough, transform_ip is not called at all */
+	transform_class->transform_ip_on_passthrough = FALSE;
+}
+
+static void gain_filter_init(GainFilter *self)
+{
+	g_mutex_init(&self->lock);
+	self->left = self->right = 1.0;
+	self->target[0] = self->target[1] = 1.0f;
+	self->gain[0] = self->gain[1] = 1.0f;
+	gst_base_transform_set_in_place(GST_BASE_TRANSFORM(self), TRUE);
+	gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(self), TRUE);
+}
+
+void gain_init(void)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	use_neon = TRUE;
+#elif defined(GPLAYER_GAIN_NEON)
+	use_neon = android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM && (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON);
+#endif
+	gst_element_register(NULL, "gplayergain", GST_RANK_NONE, gain_filter_get_type());
+}
@@ -0,0 +1,42 @@
+/*
+ * gain_neon.c
+ *
+ *  NEON kernels of the gain stage. Built with NEON where the compiler targets it and, on armeabi-v7a, as
+ *  the only file of the library that is (gain_neon.c.neon in Android.mk); gain.c calls them if the CPU has
+ *  NEON. Empty everywhere else.
+ */
+
+#include <gst/gst.h>
+#include "include/gain.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+gsize gain_s16_neon(gint16 *samples, gsize count, gint left, gint right)
+{
+	const gint16 gains[4] = { left, right, left, right };
+	int16x4_t gain = vld1_s16(gains);
+	gsize i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		int16x8_t in = vld1q_s16(samples + i);
+		int32x4_t a = vmull_s16(vget_low_s16(in), gain);
+		int32x4_t b = vmull_s16(vget_high_s16(in), gain);
+		vst1q_s16(samples + i, vcombine_s16(vqshrn_n_s32(a, GAIN_FRAC_BITS), vqshrn_n_s32(b, GAIN_FRAC_BITS)));
+	}
+	return i;
+}
+
+gsize gain_f32_neon(gfloat *samples, gsize count, gfloat left, gfloat right)
+{
+	const gfloat gains[4] = { left, right, left, right };
+	float32x4_t gain = vld1q_f32(gains);
+	gsize i = 0;
+
+	for (; i + 4 <= count; i += 4)
+		vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), gain));
+	return i;
+}
+
+#endif
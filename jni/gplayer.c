@@ -5,15 +5,165 @@
  *      Author: Krzysztof Gawrys
  */
 
-#include <jni.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
 #include "include/gplayer.h"
 
-void buffer_size(CustomData *data, int size)
+/* All players share one thread running one main loop, and one worker timer serving those waiting on a buffering decision */
+static GMutex players_lock;
+static GList *players;
+static GMainContext *shared_context;
+static GMainLoop *shared_loop;
+static GSource *shared_worker;
+static pthread_t main_loop_thread;
+/* Players filling their buffer, counted on the shared thread */
+static gint filling_players;
+
+gboolean enable_logs;
+
+static GMutex call_lock;
+static GCond call_cond;
+
+typedef struct _MainLoopCall
+{
+	GSourceFunc func;
+	gpointer data;
+	gboolean done;
+} MainLoopCall;
+
+/*
+ * Callbacks into the application
+ */
+
+void gplayer_error(const gint message, CustomData *data)
+{
+	TRACE_INFO(TRACE_ERROR_CODE, message, 0, 0);
+	if (data->callbacks.error)
+		data->callbacks.error(message, data->user_data);
+}
+
+void gplayer_notify_time(CustomData *data, int time)
+{
+	TRACE_DEBUG(TRACE_NOTIFY_TIME, time, 0, 0);
+	if (data->callbacks.notify_time)
+		data->callbacks.notify_time(time, data->user_data);
+}
+
+void gplayer_playback_complete(CustomData *data)
+{
+	TRACE_INFO(TRACE_PLAYBACK_COMPLETE, 0, 0, 0);
+	if (data->callbacks.playback_complete)
+		data->callbacks.playback_complete(data->user_data);
+}
+
+void gplayer_playback_running(CustomData *data)
+{
+	TRACE_INFO(TRACE_PLAYBACK_RUNNING, 0, 0, 0);
+	if (data->callbacks.playback_running)
+		data->callbacks.playback_running(data->user_data);
+}
+
+void gplayer_prepare_complete(CustomData *data)
+{
+	TRACE_INFO(TRACE_PREPARE_COMPLETE, 0, 0, 0);
+	if (data->callbacks.prepare_complete)
+		data->callbacks.prepare_complete(data->user_data);
+}
+
+void gplayer_notify_init_complete(CustomData *data)
+{
+	TRACE_INFO(TRACE_INIT_COMPLETE, 0, 0, 0);
+	if (data->callbacks.init_complete)
+		data->callbacks.init_complete(data->user_data);
+}
+
+void gplayer_metadata_update(CustomData *data)
+{
+	GPlayerMetadata metadata;
+
+	TRACE_INFO(TRACE_METADATA, 0, 0, 0);
+	if (data->callbacks.metadata_update)
+	{
+		metadata_get(&data->metadata, &metadata);
+		data->callbacks.metadata_update(&metadata, data->user_data);
+	}
+}
+
+void gplayer_track_changed(CustomData *data)
+{
+	TRACE_INFO(TRACE_TRACK_CHANGED, 0, 0, 0);
+	if (data->callbacks.track_changed)
+		data->callbacks.track_changed(data->user_data);
+}
+
+/* uridecodebin puts a queue2 in front of the decoder for streams, compressed buffering happens there.
+ * Returns a new reference, NULL before it is created and for local files. */
+static GstElement *get_compressed_queue(GstElement *source)
+{
+	GstIterator *it = gst_bin_iterate_elements(GST_BIN(source));
+	GValue item = G_VALUE_INIT;
+	GstElement *queue = NULL;
+	gboolean done = FALSE;
+
+	while (!done && !queue)
+	{
+		switch (gst_iterator_next(it, &item))
+		{
+		case GST_ITERATOR_OK:
+		{
+			GstElementFactory *factory = gst_element_get_factory(g_value_get_object(&item));
+			if (factory && strcmp(GST_OBJECT_NAME(factory), "queue2") == 0)
+				queue = gst_object_ref(g_value_get_object(&item));
+			g_value_reset(&item);
+			break;
+		}
+		case GST_ITERATOR_RESYNC:
+			gst_iterator_resync(it);
+			break;
+		default:
+			done = TRUE;
+			break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+	return queue;
+}
+
+/* With compressed buffering uridecodebin holds the download in memory, sized in bytes of the stream
+ * instead of seconds of PCM. Set before the uri, its queue2 is made when the stream type is known. */
+static void configure_source(CustomData *data, GstElement *source)
+{
+	if (data->compressed_buffering)
+	{
+		g_object_set(source, "use-buffering", (gboolean) TRUE, NULL);
+		g_object_set(source, "download", (gboolean) FALSE, NULL);
+		g_object_set(source, "buffer-size", (gint) data->compressed_buffer_size, NULL);
+		g_object_set(source, "buffer-duration", (gint64) COMPRESSED_BUFFER_TIME * GST_SECOND, NULL);
+	}
+	else
+	{
+		g_object_set(source, "buffer-size", (gint) -1, NULL);
+		g_object_set(source, "buffer-duration", (gint64) -1, NULL);
+	}
+}
+
+static void configure_buffer(CustomData *data, GstElement *source, GstElement *buffer, int size)
 {
 	guint maxsizebytes;
-	g_object_get(data->buffer, "max-size-bytes", &maxsizebytes, NULL);
+
+	if (data->compressed_buffering)
+	{
+		/* Our queue only decouples decoding from the sink */
+		g_object_set(buffer, "use-buffering", (gboolean) FALSE, NULL);
+		g_object_set(buffer, "max-size-bytes", (guint) 0, NULL);
+		g_object_set(buffer, "max-size-buffers", (guint) 0, NULL);
+		g_object_set(buffer, "max-size-time", (guint64) SECOND_IN_NANOS, NULL);
+		return;
+	}
+
+	g_object_get(buffer, "max-size-bytes", &maxsizebytes, NULL);
 
 	if (size != maxsizebytes)
 	{
@@ -21,15 +171,172 @@ void buffer_size(CustomData *data, int size)
 			size = MAX_BUFFER_SIZE;
 		}
 		GPlayerDEBUG("Set buffer size to %i", size);
-		g_object_set(data->source, "use-buffering", (gboolean) TRUE, NULL);
-		g_object_set(data->source, "download", (gboolean) TRUE, NULL);
-		g_object_set(data->buffer, "use-buffering", (gboolean) TRUE, NULL);
-		g_object_set(data->buffer, "low-percent", (gint) 98, NULL);
-		g_object_set(data->buffer, "use-rate-estimate", (gboolean) FALSE, NULL);
-		g_object_set(data->buffer, "max-size-bytes", (guint) size, NULL);
-		g_object_set(data->buffer, "max-size-buffers", (guint) 1024, NULL);
-		g_object_set(data->buffer, "max-size-time", (guint64) BUFFER_TIME * SECOND_IN_NANOS, NULL);
+		g_object_set(source, "use-buffering", (gboolean) TRUE, NULL);
+		g_object_set(source, "download", (gboolean) TRUE, NULL);
+		g_object_set(buffer, "use-buffering", (gboolean) TRUE, NULL);
+		g_object_set(buffer, "low-percent", (gint) 98, NULL);
+		g_object_set(buffer, "use-rate-estimate", (gboolean) FALSE, NULL);
+		g_object_set(buffer, "max-size-bytes", (guint) size, NULL);
+		g_object_set(buffer, "max-size-buffers", (guint) 1024, NULL);
+		g_object_set(buffer, "max-size-time", (guint64) BUFFER_TIME * SECOND_IN_NANOS, NULL);
+	}
+}
+
+void buffer_size(CustomData *data, int size)
+{
+	GstElement *queue;
+
+	if (!data->compressed_buffering)
+	{
+		configure_buffer(data, data->source, data->buffer, size);
+		return;
+	}
+
+	data->compressed_buffer_size = MIN(size, MAX_BUFFER_SIZE);
+	GPlayerDEBUG("Set compressed buffer size to %i", data->compressed_buffer_size);
+	g_object_set(data->source, "buffer-size", (gint) data->compressed_buffer_size, NULL);
+	queue = get_compressed_queue(data->source);
+	if (queue)
+	{
+		g_object_set(queue, "max-size-bytes", (guint) data->compressed_buffer_size, NULL);
+		gst_object_unref(queue);
+	}
+}
+
+/* Snapshot slots are 64 bit, plain stores could be torn on 32 bit ARM */
+static inline void snapshot_set(CustomData *data, GPlayerSnapshotSlot slot, gint64 value)
+{
+	__atomic_store_n(&data->snapshot[slot], value, __ATOMIC_RELAXED);
+}
+
+static inline void snapshot_add(CustomData *data, GPlayerSnapshotSlot slot, gint64 value)
+{
+	__atomic_add_fetch(&data->snapshot[slot], value, __ATOMIC_RELAXED);
+}
+
+static inline gint64 snapshot_get(CustomData *data, GPlayerSnapshotSlot slot)
+{
+	return __atomic_load_n(&data->snapshot[slot], __ATOMIC_RELAXED);
+}
+
+/* Start timing a track requested at the given time. Called on the shared thread once the streams of the
+ * previous track stopped, so none of them marks a phase of the new one. */
+static void start_startup(CustomData *data, GstClockTime time)
+{
+	int i;
+
+	for (i = 0; i < GPLAYER_STARTUP_PHASES; i++)
+	{
+		__atomic_store_n(&data->startup[i], GST_CLOCK_TIME_NONE, __ATOMIC_RELAXED);
+		snapshot_set(data, GPLAYER_SNAPSHOT_STARTUP_TIMES + i, -1);
+	}
+	snapshot_set(data, GPLAYER_SNAPSHOT_STARTUP_TIMES + GPLAYER_STARTUP_SET_URI, 0);
+	__atomic_store_n(&data->startup[GPLAYER_STARTUP_SET_URI], time, __ATOMIC_RELEASE);
+}
+
+/* Record the first time a startup phase is reached after set_uri, together with the session histogram.
+ * Phases are reached on streaming threads too, the first one to swap the slot records it. */
+void mark_startup(CustomData *data, GPlayerStartupPhase phase)
+{
+	GstClockTime start = __atomic_load_n(&data->startup[GPLAYER_STARTUP_SET_URI], __ATOMIC_ACQUIRE);
+	GstClockTime none = GST_CLOCK_TIME_NONE;
+	GstClockTime now;
+	guint64 elapsed;
+	gint bucket;
+
+	/* Every buffer of a stream may end up here, most find the phase already taken */
+	if (!GST_CLOCK_TIME_IS_VALID(start) || GST_CLOCK_TIME_IS_VALID(__atomic_load_n(&data->startup[phase], __ATOMIC_RELAXED)))
+		return;
+	now = gst_util_get_timestamp();
+	if (!__atomic_compare_exchange_n(&data->startup[phase], &none, now, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return;
+
+	snapshot_set(data, GPLAYER_SNAPSHOT_STARTUP_TIMES + phase, (now - start) / GST_USECOND);
+	elapsed = (now - start) / GST_MSECOND;
+	for (bucket = 0; bucket < GPLAYER_STARTUP_BUCKETS - 1 && elapsed >= (50 << bucket); bucket++)
+		;
+	g_atomic_int_inc((gint *) &data->startup_histogram[phase][bucket]);
+	TRACE_INFO(TRACE_STARTUP, phase, elapsed, 0);
+}
+
+/* Blame a stall on a seek still waiting for its audio, on the network while the download is behind the stream
+ * or delivered nothing lately, else on decoding */
+static GPlayerStallCause stall_cause(CustomData *data)
+{
+	GstClockTime last_bytes = __atomic_load_n(&data->last_source_bytes, __ATOMIC_RELAXED);
+
+	if (GST_CLOCK_TIME_IS_VALID(data->seek_issued))
+		return GPLAYER_STALL_SEEK;
+	if (!data->from_cache && !g_atomic_int_get(&data->input_eos)
+			&& (data->network_slow || !GST_CLOCK_TIME_IS_VALID(last_bytes)
+					|| last_bytes + NETWORK_IDLE_TIME <= gst_util_get_timestamp()))
+		return GPLAYER_STALL_NETWORK;
+	return GPLAYER_STALL_DECODE;
+}
+
+/* Count a stall in the histogram and the snapshot. Rebuffers are recorded from the main loop, underruns from
+ * the streaming thread of the sink. */
+static void record_stall(CustomData *data, GPlayerStallCause cause, gint64 position, GstClockTime duration)
+{
+	guint64 elapsed = duration / GST_MSECOND;
+	gint bucket;
+
+	for (bucket = 0; bucket < GPLAYER_STALL_BUCKETS - 1 && elapsed >= (20 << bucket); bucket++)
+		;
+	g_atomic_int_inc((gint *) &data->stall_histogram[cause][bucket]);
+	if (cause != GPLAYER_STALL_SEEK)
+		snapshot_add(data, GPLAYER_SNAPSHOT_STALL_TIME, duration / GST_USECOND);
+	snapshot_set(data, GPLAYER_SNAPSHOT_LAST_STALL_POSITION, position);
+	snapshot_set(data, GPLAYER_SNAPSHOT_LAST_STALL_DURATION, duration / GST_USECOND);
+	snapshot_set(data, GPLAYER_SNAPSHOT_LAST_STALL_CAUSE, cause);
+	TRACE_INFO(TRACE_STALL, elapsed, position / 1000, cause);
+}
+
+/* The current pipeline stopped playing while it should play */
+static void start_rebuffer(CustomData *data)
+{
+	if (GST_CLOCK_TIME_IS_VALID(data->rebuffer_start))
+		return;
+	data->rebuffer_start = gst_util_get_timestamp();
+	data->rebuffer_cause = stall_cause(data);
+	data->rebuffer_position = data->counters ? __atomic_load_n(&data->counters->sink_position, __ATOMIC_RELAXED) : -1;
+}
+
+/* Playback resumed, or the pause turned out to be no stall: paused by the application, or another track */
+static void end_rebuffer(CustomData *data, gboolean resumed)
+{
+	if (!GST_CLOCK_TIME_IS_VALID(data->rebuffer_start))
+		return;
+	if (resumed)
+	{
+		if (data->rebuffer_cause != GPLAYER_STALL_SEEK)
+			snapshot_add(data, GPLAYER_SNAPSHOT_REBUFFERS, 1);
+		record_stall(data, data->rebuffer_cause, data->rebuffer_position, gst_util_get_timestamp() - data->rebuffer_start);
 	}
+	data->rebuffer_start = GST_CLOCK_TIME_NONE;
+}
+
+/* A reference to the current pipeline or one of its elements, for threads other than the shared one, which
+ * may release them any time. NULL while there is none. */
+static GstElement *ref_element(CustomData *data, GstElement **element)
+{
+	GstElement *ref;
+
+	g_mutex_lock(&data->pipeline_lock);
+	ref = *element ? gst_object_ref(*element) : NULL;
+	g_mutex_unlock(&data->pipeline_lock);
+	return ref;
+}
+
+/* Elements are looked up by name, so the same callbacks can serve the current and the pre-rolled next pipeline */
+static GstElement *get_element(GstElement *pipeline, const gchar *name)
+{
+	GstElement *element = gst_bin_get_by_name(GST_BIN(pipeline), name);
+
+	/* The pipeline keeps its own reference for as long as we use the element */
+	if (element)
+		gst_object_unref(element);
+	return element;
 }
 
 static gboolean gst_notify_time_cb(CustomData *data)
@@ -52,231 +359,486 @@ static gboolean gst_notify_time_cb(CustomData *data)
 	return TRUE;
 }
 
-static gboolean gst_worker_cb(CustomData *data)
+/* Query the duration once it is known or changes, short tracks get a buffer just big enough for them */
+static void update_duration(CustomData *data)
 {
-	gint64 current = -1;
-	gint mean = 0;
-
-	/* We do not want to update anything unless we have a working pipeline in the PAUSED or PLAYING state */
-	if (!data)
-		return TRUE;
-
 	data->duration = -1;
-	if (data->state >= GST_STATE_PAUSED)
+	if (gst_element_query_duration(data->pipeline, GST_FORMAT_TIME, &data->duration))
 	{
-		if (gst_element_query_duration(data->pipeline, GST_FORMAT_TIME, &data->duration))
+		if (data->duration > 0)
 		{
-			if (data->duration > 0)
-			{
-				GPlayerDEBUG("detected duration: %0.3f", ((gfloat) data->duration / SECOND_IN_NANOS));
-				if ((gfloat) data->duration / SECOND_IN_NANOS < (gfloat) 15) {
-					gint req_buffer_size = data->audio_info.rate * data->audio_info.channels * data->audio_info.finfo->width / 8 * (data->duration / SECOND_IN_NANOS);
-					buffer_size(data, req_buffer_size);
-				}
+			GPlayerDEBUG("detected duration: %0.3f", ((gfloat) data->duration / SECOND_IN_NANOS));
+			if ((gfloat) data->duration / SECOND_IN_NANOS < (gfloat) 15 && !data->compressed_buffering) {
+				gint req_buffer_size = data->audio_info.rate * data->audio_info.channels * data->audio_info.finfo->width / 8 * (data->duration / SECOND_IN_NANOS);
+				buffer_size(data, req_buffer_size);
 			}
 		}
+	}
 
-		if (data->duration == -1)
-		{
-			GPlayerDEBUG("NO duration, assuming stream!");
-		}
+	if (data->duration == -1)
+	{
+		GPlayerDEBUG("NO duration, assuming stream!");
 	}
+}
 
+/* The stream bitrate from its tags, or from the size of the download when they have none */
+static guint stream_bitrate(CustomData *data)
+{
+	gint64 bytes;
+
+	if (data->bitrate > 0)
+		return data->bitrate;
+	if (data->duration > 0 && gst_element_query_duration(data->source, GST_FORMAT_BYTES, &bytes) && bytes > 0)
+		return (guint) gst_util_uint64_scale(bytes * 8, GST_SECOND, data->duration);
+	return 0;
+}
+
+/* Read the queue level. Compressed data is measured in seconds of playback at the stream bitrate, on the same
+ * scale as the PCM queue where 100% holds BUFFER_TIME seconds. */
+static void update_level(CustomData *data)
+{
 	guint maxsizebytes;
-	guint currentlevelbuffers;
 	guint currentlevelbytes;
-	g_object_get(data->buffer, "max-size-bytes", &maxsizebytes, NULL);
-	g_object_get(data->buffer, "current-level-buffers", &currentlevelbuffers, NULL);
-	g_object_get(data->buffer, "current-level-bytes", &currentlevelbytes, NULL);
-
-	if (maxsizebytes > 0) {
-		data->buffering_level = currentlevelbytes * HUNDRED_PERCENT / maxsizebytes;
-	}
 
-	GstState state;
-	gst_element_get_state(GST_ELEMENT(data->pipeline), &state, NULL, GST_CLOCK_TIME_NONE);
-	if ((data->buffering_level >= (data->fast_network ? HUNDRED_PERCENT : HUNDRED_PERCENT / 2) || data->allow_seek || (data->buffering_level > 0 && data->buffering_time >= (data->fast_network ? BUFFERING_TIMEOUT : BUFFERING_TIMEOUT * 2))) && data->target_state == GST_STATE_PLAYING && (data->state == GST_STATE_PAUSED || (data->state == GST_STATE_READY && data->allow_seek)))
+	if (data->compressed_buffering)
 	{
-		if (state != GST_STATE_PLAYING)
+		GstElement *queue = get_compressed_queue(data->source);
+		guint bitrate = stream_bitrate(data);
+		gchar *uri = NULL;
+
+		if (!queue)
 		{
-			if (GST_CLOCK_TIME_IS_VALID(data->desired_position))
-			{
-				execute_seek(data->desired_position, data);
-			}
-			GPlayerDEBUG("request GST_STATE_PLAYING");
-			data->target_state = GST_STATE_PLAYING;
-			data->buffering_time = 0;
-			data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_NO_PREROLL);
-			gplayer_error(BUFFER_FAST, data);
+			/* Local files are not buffered */
+			g_object_get(data->source, "uri", &uri, NULL);
+			data->buffering_level = (uri && gst_uri_has_protocol(uri, "file")) ? HUNDRED_PERCENT : 0;
+			g_free(uri);
+			return;
 		}
+		g_object_get(queue, "current-level-bytes", &currentlevelbytes, NULL);
+		gst_object_unref(queue);
+		if (bitrate == 0)
+			bitrate = DEFAULT_BITRATE;
+		data->buffering_level = MIN(HUNDRED_PERCENT, (gint) gst_util_uint64_scale(currentlevelbytes, 8 * HUNDRED_PERCENT, (guint64) bitrate * BUFFER_TIME));
+		return;
 	}
 
-	count_buffer_fill++;
+	g_object_get(data->buffer, "max-size-bytes", &maxsizebytes, "current-level-bytes", &currentlevelbytes, NULL);
 
-	if ((count_buffer_fill == 8) && (data->position > last_position + 1999))
-	{
-		no_buffer_fill = 0;
-		count_buffer_fill = 0;
-		last_position = data->position;
+	if (maxsizebytes > 0) {
+		data->buffering_level = currentlevelbytes * HUNDRED_PERCENT / maxsizebytes;
 	}
+}
+
+/* A stream without an end, a radio, is sent by the server at its bitrate. Its throughput tells nothing about
+ * the link. */
+static gboolean is_paced_stream(CustomData *data)
+{
+	GstElement *source = NULL;
+	gint64 size = -1;
+
+	g_object_get(data->source, "source", &source, NULL);
+	if (!source)
+		return FALSE;
+	if (!gst_element_query_duration(source, GST_FORMAT_BYTES, &size))
+		size = -1;
+	gst_object_unref(source);
+	return size <= 0;
+}
 
-	if (state == GST_STATE_PLAYING && data->buffering_level == 0 && data->duration == -1)
+/* Compare the network throughput with the bitrate of the stream, once a second. Only a confident estimate
+ * counts, and the gap between the slow and fast ratios keeps bursty links from flapping. Paced streams are
+ * left to the buffering level. */
+static void check_network_speed(CustomData *data, GstClockTime now)
+{
+	gint confidence;
+	gint64 throughput;
+	guint bitrate;
+
+	if (GST_CLOCK_TIME_IS_VALID(data->last_speed_check) && now - data->last_speed_check < GST_SECOND)
+		return;
+	data->last_speed_check = now;
+
+	throughput = bandwidth_get(&data->bandwidth, &confidence) * 8;
+	bitrate = stream_bitrate(data);
+	snapshot_set(data, GPLAYER_SNAPSHOT_BANDWIDTH, throughput);
+	snapshot_set(data, GPLAYER_SNAPSHOT_BANDWIDTH_CONFIDENCE, confidence);
+	snapshot_set(data, GPLAYER_SNAPSHOT_STREAM_BITRATE, bitrate);
+	TRACE_DEBUG(TRACE_NETWORK, throughput, bitrate, confidence);
+
+	/* Nothing left to download */
+	if (g_atomic_int_get(&data->input_eos))
 	{
-		GPlayerDEBUG("pausing, NO DATA");
-		gplayer_error(BUFFER_SLOW, data);
-		data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
+		data->buffer_is_slow = 0;
+		if (data->network_slow)
+		{
+			data->network_slow = FALSE;
+			gplayer_error(BUFFER_FAST, data);
+		}
+		return;
 	}
 
-	if (data->buffering_level < 5)
+	if (bitrate == 0 || confidence < NETWORK_MIN_CONFIDENCE || is_paced_stream(data))
+		return;
+
+	if (throughput < bitrate * NETWORK_SLOW_RATIO)
 	{
-		if (data->buffering_level == 0)
+		data->buffer_is_slow++;
+		if (!data->network_slow && data->buffer_is_slow >= 3)
 		{
-			no_buffer_fill++;
+			data->network_slow = TRUE;
+			gplayer_error(BUFFER_SLOW, data);
 		}
 	}
-	if (count_buffer_fill == 20)
+	else
 	{
-		count_buffer_fill = 0;
-		if (no_buffer_fill >= 16 && data->target_state == GST_STATE_PLAYING)
+		data->buffer_is_slow = 0;
+		if (data->network_slow && throughput > bitrate * NETWORK_FAST_RATIO)
 		{
-			gplayer_error(ERROR_BUFFERING, data);
+			data->network_slow = FALSE;
+			gplayer_error(BUFFER_FAST, data);
 		}
-		no_buffer_fill = 0;
 	}
+}
+
+/* Background downloads wait while any player fills its buffer. A paced stream fills at the pace of the
+ * server, once it plays the prefetch does not wait for it. */
+static void update_filling(CustomData *data)
+{
+	gboolean filling = data->pipeline && data->target_state == GST_STATE_PLAYING && data->buffering_level < HUNDRED_PERCENT
+			&& !g_atomic_int_get(&data->input_eos) && !(data->state == GST_STATE_PLAYING && is_paced_stream(data));
+
+	if (filling == data->filling)
+		return;
+	data->filling = filling;
+	filling_players += filling ? 1 : -1;
+	prefetch_set_foreground_busy(filling_players > 0);
+}
+
+/* Take the buffering decisions for the current queue level. They run on every buffering message and state
+ * change; returns TRUE while one of them waits for time to pass, which keeps the worker timer running. */
+static gboolean gst_worker_cb(CustomData *data)
+{
+	GstClockTime now = gst_util_get_timestamp();
+	gboolean waiting, starving;
 
-	counter++;
-	if (data->last_buffer_load)
+	/* We do not want to update anything unless we have a working pipeline in the PAUSED or PLAYING state */
+	if (!data || !data->pipeline)
+		return FALSE;
+
+	update_level(data);
+	update_filling(data);
+
+	waiting = data->target_state == GST_STATE_PLAYING && (data->state == GST_STATE_PAUSED || (data->state == GST_STATE_READY && data->allow_seek));
+	if (waiting)
 	{
-		data->deltas[data->delta_index] = currentlevelbytes - data->last_buffer_load;
-		data->delta_index++;
-		data->delta_index %= 5;
-		gint max = 0;
-		gint min = 0;
-		int i;
-		gint acc = 0;
-		for (i = 0; i < 5; i++)
+		guint64 buffering_time = (now - data->buffering_start) / GST_MSECOND;
+		if (data->buffering_level >= (data->fast_network ? HUNDRED_PERCENT : HUNDRED_PERCENT / 2) || data->allow_seek || (data->buffering_level > 0 && buffering_time >= (data->fast_network ? BUFFERING_TIMEOUT : BUFFERING_TIMEOUT * 2)))
 		{
-			max = MAX(data->deltas[i], max);
-			min = MIN(data->deltas[i], min);
-			acc += data->deltas[i];
-		}
-		mean = (acc - min - max) / 3;
-		if (counter >= 4)
-		{
-			counter = 0;
-			gint stream_speed = data->audio_info.channels * data->audio_info.rate * data->audio_info.finfo->width;
-			guint buffer_size = currentlevelbytes * 8;
-			gint buffer_delta = (currentlevelbytes - data->last_buffer_load) * 8;
-			gfloat time_left = INFINITY;
-			if (mean != 0) {
-				time_left = buffer_size / (gfloat) (mean * 4 * 8);
-			}
-			if (time_left < 0)
-				time_left = -time_left;
-			GPlayerDEBUG("stream_speed: %lu Mbit/s, buffer_size: %lu Mbit, buffer_delta: %ld Mbit/s, time left: %.3f s", stream_speed, buffer_size,
-					buffer_delta, time_left);
-			if (data->duration > 0 && time_left != INFINITY)
-			{
-				gint64 position;
-				gst_element_query_position(data->pipeline, GST_FORMAT_TIME, &position);
-				guint64 buffered_ahead = (guint64) ((time_left + 3) * SECOND_IN_NANOS) + position;
-				if (buffered_ahead < data->duration)
-				{
-					buffer_is_slow++;
-					if (buffer_is_slow >= 5)
-					{
-						gplayer_error(BUFFER_SLOW, data);
-					}
-				}
-				else
-				{
-					if (buffer_is_slow > 0)
-					{
-						buffer_is_slow = 0;
-						gplayer_error(BUFFER_FAST, data);
-					}
-				}
-			}
-			else if (data->buffering_level < HUNDRED_PERCENT && time_left != INFINITY && time_left < 15 && data->duration == -1)
-			{
-				buffer_is_slow++;
-				if (buffer_is_slow >= 5)
-				{
-					gplayer_error(BUFFER_SLOW, data);
-				}
-			}
-			else
+			if (GST_CLOCK_TIME_IS_VALID(data->desired_position))
 			{
-				if (buffer_is_slow > 0)
-				{
-					buffer_is_slow = 0;
-					gplayer_error(BUFFER_FAST, data);
-				}
+				execute_seek(data->desired_position, data);
 			}
+			TRACE_INFO(TRACE_REQUEST_PLAYING, data->buffering_level, buffering_time, 0);
+			data->buffering_start = now;
+			data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_NO_PREROLL);
+			gplayer_error(BUFFER_FAST, data);
+			waiting = FALSE;
 		}
 	}
-	data->last_buffer_load = currentlevelbytes;
-	data->buffering_time += WORKER_TIMEOUT;
 
-	GPlayerDEBUG("mean: %8i, errors: %2i, ubuf: %3i, buf: %10i/%10i [%3i]", mean, no_buffer_fill, data->buffering_level, currentlevelbytes, maxsizebytes,
-			currentlevelbuffers);
+	/* Once everything is downloaded an empty queue only means the track is ending */
+	if (data->state == GST_STATE_PLAYING && data->buffering_level == 0 && data->duration == -1 && !g_atomic_int_get(&data->input_eos))
+	{
+		TRACE_INFO(TRACE_NO_DATA, data->buffering_level, 0, 0);
+		gplayer_error(BUFFER_SLOW, data);
+		data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
+		waiting = TRUE;
+	}
+
+	starving = data->target_state == GST_STATE_PLAYING && data->buffering_level == 0 && !g_atomic_int_get(&data->input_eos);
+	if (!starving)
+	{
+		data->starve_start = GST_CLOCK_TIME_NONE;
+	}
+	else if (!GST_CLOCK_TIME_IS_VALID(data->starve_start))
+	{
+		data->starve_start = now;
+	}
+	else if (now - data->starve_start >= STARVING_TIMEOUT * GST_MSECOND)
+	{
+		data->starve_start = now;
+		gplayer_error(ERROR_BUFFERING, data);
+	}
+
+	/* Paused by the application while refilling */
+	if (data->target_state != GST_STATE_PLAYING)
+		end_rebuffer(data, FALSE);
 
-	return TRUE;
+	check_network_speed(data, now);
+
+	TRACE_DEBUG(TRACE_WORKER, data->buffering_level, waiting, starving);
+
+	return waiting || starving;
 }
 
-/* Perform seek, if we are not too close to the previous seek. Otherwise, schedule the seek for
- * some time in the future. */
-void execute_seek(gint64 desired_position, CustomData *data)
+static void cancel_seek(CustomData *data)
 {
-	gint64 diff;
+	if (data->seek_source)
+	{
+		g_source_destroy(data->seek_source);
+		data->seek_source = NULL;
+	}
+}
 
+/* Send the seek to the pipeline right away, a scheduled one is superseded */
+void execute_seek(gint64 desired_position, CustomData *data)
+{
 	if (desired_position == GST_CLOCK_TIME_NONE || !data->allow_seek)
 		return;
 
-	diff = gst_util_get_timestamp() - data->last_seek_time;
-
+	cancel_seek(data);
 	if (!data->is_live)
 	{
-		GPlayerDEBUG("Seeking to %" GST_TIME_FORMAT, GST_TIME_ARGS(desired_position));
 		data->last_seek_time = gst_util_get_timestamp();
-		gst_element_seek_simple(data->pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, desired_position);
+		data->seek_issued = data->last_seek_time;
+		data->seek_flushed = FALSE;
+		snapshot_add(data, GPLAYER_SNAPSHOT_SEEKS, 1);
+		/* Streams without a reliable table of contents land on the exact sample through the frame index */
+		if (indexed_seek_start(&data->indexed_seek, data->pipeline, data->frame_index, desired_position))
+		{
+			data->indexed_seeks++;
+			TRACE_INFO(TRACE_SEEK, desired_position / GST_MSECOND, TRUE, 0);
+		}
+		else
+		{
+			gst_element_seek_simple(data->pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, desired_position);
+			TRACE_INFO(TRACE_SEEK, desired_position / GST_MSECOND, FALSE, 0);
+		}
 		data->desired_position = GST_CLOCK_TIME_NONE;
 	}
 }
 
-static void error_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+static gboolean delayed_seek_cb(CustomData *data)
 {
-	GError *err;
-	gchar *debug_info;
-	gchar *message_string;
+	data->seek_source = NULL;
+	execute_seek(data->desired_position, data);
+	return FALSE;
+}
 
-	gst_message_parse_error(msg, &err, &debug_info);
-	GPlayerDEBUG("ERROR from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
-	GPlayerDEBUG("Debugging info: %s\n", (debug_info) ? debug_info : "none");
+/* Seek to desired_position at the trailing edge of a burst of requests: each request moves the seek to
+ * SEEK_COALESCE_DELAY after it. A scrub lasting longer still seeks SEEK_MIN_DELAY after the start of its
+ * burst, and no seek is sent within SEEK_MIN_DELAY of the previous one. */
+static void schedule_seek(CustomData *data)
+{
+	GstClockTime now = gst_util_get_timestamp();
+	GstClockTime due = now + SEEK_COALESCE_DELAY;
+
+	if (data->seek_source)
+		cancel_seek(data);
+	else
+		data->seek_burst_start = now;
+
+	due = MIN(due, data->seek_burst_start + SEEK_MIN_DELAY);
+	if (GST_CLOCK_TIME_IS_VALID(data->last_seek_time))
+		due = MAX(due, data->last_seek_time + SEEK_MIN_DELAY);
+
+	data->seek_source = g_timeout_source_new(due > now ? (due - now) / GST_MSECOND : 0);
+	g_source_set_callback(data->seek_source, (GSourceFunc) delayed_seek_cb, data, NULL);
+	g_source_attach(data->seek_source, data->context);
+	g_source_unref(data->seek_source);
+}
 
-	if (strcmp(err->message, "Not Found") == 0)
+/* The element reading an http(s) uri, directly or behind the prefetched bytes */
+static gboolean is_network_source(GstObject *object)
+{
+	gchar *uri, *protocol;
+	gboolean network;
+
+	if (!GST_IS_ELEMENT(object) || !GST_OBJECT_FLAG_IS_SET(object, GST_ELEMENT_FLAG_SOURCE) || !GST_IS_URI_HANDLER(object))
+		return FALSE;
+	uri = gst_uri_handler_get_uri(GST_URI_HANDLER(object));
+	protocol = uri ? gst_uri_get_protocol(uri) : NULL;
+	network = protocol && (g_str_has_suffix(protocol, "http") || g_str_has_suffix(protocol, "https"));
+	g_free(protocol);
+	g_free(uri);
+	return network;
+}
+
+/* The status of a refused request, souphttpsrc and the prefetch source put it into the debug text as
+ * "Reason (status), URL: ...". 0 when there is none to be found. */
+static guint get_http_status(const gchar *debug)
+{
+	const gchar *p;
+	gchar *end;
+	guint64 status;
+
+	for (p = debug ? strchr(debug, '(') : NULL; p; p = strchr(p + 1, '('))
 	{
-		gplayer_error(NOT_FOUND, data);
-		data->target_state = GST_STATE_NULL;
-		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+		status = g_ascii_strtoull(p + 1, &end, 10);
+		if (*end == ')' && status >= 100 && status < 600)
+			return (guint) status;
 	}
-	else if ((strstr(err->message, "missing") != NULL && strstr(err->message, "plug-in") != NULL)
-			|| (strstr(err->message, "No URI handler implemented for") != NULL))
+	return 0;
+}
+
+/* Errors a network source may get over by reconnecting: the connection failed or broke off, or the server had
+ * a problem of its own. A request the server refused for good fails the same way again. While reconnecting
+ * a failed name lookup is transient too. The GError of GStreamer 1.6 can not tell a 4xx from a 5xx, both are
+ * OPEN_READ, only the debug text has the status. Without one the request is taken as refused rather than
+ * retried; the prefetch source reports a request that got no response as READ instead. */
+static gboolean is_transient_error(const GError *err, const gchar *debug, gboolean reconnecting)
+{
+	guint status;
+
+	if (err->domain != GST_RESOURCE_ERROR)
+		return FALSE;
+	if (err->code == GST_RESOURCE_ERROR_OPEN_READ)
 	{
-		gplayer_error(NOT_SUPPORTED, data);
-		data->target_state = GST_STATE_NULL;
-		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+		status = get_http_status(debug);
+		return status >= 500;
 	}
-	else if (strstr(err->message, "type") != NULL && strstr(err->message, "stream") != NULL)
+	return err->code == GST_RESOURCE_ERROR_READ || err->code == GST_RESOURCE_ERROR_BUSY
+			|| (reconnecting && err->code == GST_RESOURCE_ERROR_NOT_FOUND);
+}
+
+/* Runs in the thread posting an error, so a failing network source is marked before it pushes its EOS, which
+ * source_resume_probe then holds back for error_cb to reconnect */
+static void source_error_sync_cb(GstBus *bus, GstMessage *msg, StreamCounters *counters)
+{
+	gint retries = g_atomic_int_get(&counters->source_retries);
+	GError *err;
+	gchar *debug;
+
+	if (g_atomic_int_get(&counters->source_failed) || retries >= RETRY_MAX_ATTEMPTS || !is_network_source(GST_MESSAGE_SRC(msg)))
+		return;
+	gst_message_parse_error(msg, &err, &debug);
+	if (is_transient_error(err, debug, retries > 0))
 	{
-		gplayer_error(UNKNOWN_ERROR, data);
-		data->target_state = GST_STATE_NULL;
-		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+		if (!GST_CLOCK_TIME_IS_VALID(__atomic_load_n(&counters->source_failure, __ATOMIC_RELAXED)))
+			__atomic_store_n(&counters->source_failure, gst_util_get_timestamp(), __ATOMIC_RELAXED);
+		g_atomic_int_set(&counters->source_failed, TRUE);
 	}
-	else if (strstr(err->message, "Stream") != NULL && strstr(err->message, "enough") != NULL)
+	g_error_free(err);
+	g_free(debug);
+}
+
+static void cancel_retry(CustomData *data)
+{
+	if (data->retry_source)
+	{
+		g_source_destroy(data->retry_source);
+		data->retry_source = NULL;
+	}
+}
+
+/* Restart only the source of the current pipeline. A seekable one continues with a range request at the byte
+ * after the last one it delivered, so the decoders and queues keep everything they hold. */
+static gboolean retry_cb(CustomData *data)
+{
+	StreamCounters *counters = data->counters;
+	guint64 offset = __atomic_load_n(&counters->source_offset, __ATOMIC_RELAXED);
+	GstElement *source = NULL;
+	gboolean seekable = FALSE;
+	GstQuery *query;
+
+	data->retry_source = NULL;
+	g_object_get(data->source, "source", &source, NULL);
+	if (!source)
+		return FALSE;
+
+	query = gst_query_new_seeking(GST_FORMAT_BYTES);
+	if (gst_element_query(source, query))
+		gst_query_parse_seeking(query, NULL, &seekable, NULL, NULL);
+	gst_query_unref(query);
+	if (!seekable)
+		offset = 0;
+
+	g_atomic_int_inc(&counters->source_retries);
+	snapshot_add(data, GPLAYER_SNAPSHOT_RETRIES, 1);
+	TRACE_INFO(TRACE_RECONNECT, g_atomic_int_get(&counters->source_retries), offset, 0);
+
+	gst_element_set_state(source, GST_STATE_READY);
+	__atomic_store_n(&counters->source_offset, offset, __ATOMIC_RELAXED);
+	g_atomic_int_set(&counters->source_failed, FALSE);
+	/* Kept by the stopped source until it starts */
+	if (offset > 0)
+		gst_element_send_event(source, gst_event_new_seek(1.0, GST_FORMAT_BYTES, GST_SEEK_FLAG_NONE, GST_SEEK_TYPE_SET, offset, GST_SEEK_TYPE_NONE, -1));
+	gst_element_sync_state_with_parent(source);
+	gst_object_unref(source);
+	return FALSE;
+}
+
+/* Reconnect after RETRY_MIN_DELAY ms, twice as long for every attempt that failed again */
+static void schedule_retry(CustomData *data)
+{
+	gint attempt = g_atomic_int_get(&data->counters->source_retries);
+	guint delay = attempt < 8 ? MIN(RETRY_MIN_DELAY << attempt, RETRY_MAX_DELAY) : RETRY_MAX_DELAY;
+
+	if (data->retry_source)
+		return;
+
+	TRACE_INFO(TRACE_RETRY, delay, attempt, 0);
+	data->retry_source = g_timeout_source_new(delay);
+	g_source_set_callback(data->retry_source, (GSourceFunc) retry_cb, data, NULL);
+	g_source_attach(data->retry_source, data->context);
+	g_source_unref(data->retry_source);
+}
+
+static void error_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+	GError *err;
+	gchar *debug_info;
+	gchar *message_string;
+	guint status;
+
+	gst_message_parse_error(msg, &err, &debug_info);
+	GPlayerDEBUG("ERROR from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+	GPlayerDEBUG("Debugging info: %s\n", (debug_info) ? debug_info : "none");
+
+	/* uridecodebin recreates everything below it for the next uri, anything else failing means
+	 * the fixed part of the graph can not be trusted anymore */
+	if (msg->src != GST_OBJECT(data->source) && !gst_object_has_ancestor(msg->src, GST_OBJECT(data->source)))
+	{
+		data->rebuild_pipeline = TRUE;
+	}
+
+	/* Marked by source_error_sync_cb. The streaming task of the source posts another error for the same failure. */
+	if (g_atomic_int_get(&data->counters->source_failed) && is_network_source(msg->src))
+	{
+		schedule_retry(data);
+	}
+	else if (g_error_matches(err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_NOT_FOUND))
+	{
+		gplayer_error(NOT_FOUND, data);
+		data->target_state = GST_STATE_NULL;
+		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+	}
+	else if (g_error_matches(err, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN)
+			|| g_error_matches(err, GST_STREAM_ERROR, GST_STREAM_ERROR_CODEC_NOT_FOUND))
+	{
+		gplayer_error(NOT_SUPPORTED, data);
+		data->target_state = GST_STATE_NULL;
+		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+	}
+	else if (g_error_matches(err, GST_STREAM_ERROR, GST_STREAM_ERROR_TYPE_NOT_FOUND)
+			|| g_error_matches(err, GST_STREAM_ERROR, GST_STREAM_ERROR_WRONG_TYPE))
 	{
 		gplayer_error(UNKNOWN_ERROR, data);
-		data->target_state = GST_STATE_PAUSED;
+		data->target_state = GST_STATE_NULL;
+		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+	}
+	else if (is_transient_error(err, debug_info, FALSE) && is_network_source(msg->src))
+	{
+		/* Reconnecting did not help, the EOS of the source went through and the queued audio plays out */
+		GPlayerDEBUG("Giving up on the source");
+		gplayer_error(UNKNOWN_ERROR, data);
+	}
+	else if (g_error_matches(err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_OPEN_READ))
+	{
+		/* Refused by the server. The prefetch source reports a 404 this way, a 410 Gone is as good. */
+		status = get_http_status(debug_info);
+		gplayer_error(status == SOUP_STATUS_NOT_FOUND || status == SOUP_STATUS_GONE ? NOT_FOUND : UNKNOWN_ERROR, data);
+		data->target_state = GST_STATE_NULL;
 		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
 	}
 
@@ -299,10 +861,6 @@ void print_one_tag(const GstTagList * list, const gchar * tag, CustomData *data)
 		if (G_VALUE_HOLDS_STRING(val))
 		{
 			GPlayerDEBUG("\t%20s : %s\n", tag, g_value_get_string(val));
-			if (strcmp(tag, "title") == 0)
-			{
-				gplayer_metadata_update(data, g_value_get_string(val));
-			}
 		}
 		else if (G_VALUE_HOLDS_UINT(val))
 		{
@@ -338,21 +896,72 @@ void print_one_tag(const GstTagList * list, const gchar * tag, CustomData *data)
 	}
 }
 
+static gboolean metadata_cb(CustomData *data)
+{
+	data->metadata_source = NULL;
+	gplayer_metadata_update(data);
+	return FALSE;
+}
+
+static void cancel_metadata(CustomData *data)
+{
+	if (data->metadata_source)
+	{
+		g_source_destroy(data->metadata_source);
+		data->metadata_source = NULL;
+	}
+}
+
+/* A change is delivered METADATA_DELAY later, together with the tags the other elements send for the same change */
+static void schedule_metadata(CustomData *data)
+{
+	if (data->metadata_source)
+		return;
+	data->metadata_source = g_timeout_source_new(METADATA_DELAY);
+	g_source_set_callback(data->metadata_source, (GSourceFunc) metadata_cb, data, NULL);
+	g_source_attach(data->metadata_source, data->context);
+	g_source_unref(data->metadata_source);
+}
+
+/* Tags are posted here as soon as an element parsed them, which is ahead of what is heard by the queued audio.
+ * Only the bitrate the buffering estimates need is taken, the metadata comes from the timeline of the sink. */
 static void tag_cb(GstBus *bus, GstMessage *msg, CustomData *data)
 {
 	GstTagList *tags = NULL;
+	guint bitrate;
+
 	gst_message_parse_tag(msg, &tags);
-	GPlayerDEBUG("Got tags from element %s:\n", GST_OBJECT_NAME(msg->src));
-	gst_tag_list_foreach(tags, (GstTagForeachFunc) print_one_tag, data);
+	if (enable_logs)
+	{
+		GPlayerDEBUG("Got tags from element %s:\n", GST_OBJECT_NAME(msg->src));
+		gst_tag_list_foreach(tags, (GstTagForeachFunc) print_one_tag, data);
+	}
+	if (gst_tag_list_get_uint(tags, GST_TAG_BITRATE, &bitrate)
+			|| (data->bitrate == 0 && gst_tag_list_get_uint(tags, GST_TAG_NOMINAL_BITRATE, &bitrate)))
+		data->bitrate = bitrate;
 	gst_tag_list_unref(tags);
-	gst_message_unref(msg);
 }
 
-/* Called when the End Of the Stream is reached. Just move to the beginning of the media and pause. */
+/* The next track plays, measure the silence since the end of the previous one */
+static void end_track_gap(CustomData *data)
+{
+	GstClockTime now;
+
+	if (!GST_CLOCK_TIME_IS_VALID(data->track_gap_start))
+		return;
+	now = gst_util_get_timestamp();
+	snapshot_set(data, GPLAYER_SNAPSHOT_TRACK_GAP, now > data->track_gap_start ? (now - data->track_gap_start) / GST_USECOND : 0);
+	data->track_gap_start = GST_CLOCK_TIME_NONE;
+}
+
+/* Called when the End Of the Stream is reached. Switch to the pre-rolled next track if there is one,
+ * otherwise just pause. */
 static void eos_cb(GstBus *bus, GstMessage *msg, CustomData *data)
 {
 	if (data->target_state >= GST_STATE_PLAYING)
 	{
+		if (switch_to_next_pipeline(data))
+			return;
 		data->target_state = GST_STATE_PAUSED;
 		data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
 		gplayer_playback_complete(data);
@@ -376,14 +985,37 @@ static void state_changed_cb(GstBus *bus, GstMessage *msg, CustomData *data)
 	if (GST_MESSAGE_SRC(msg) == GST_OBJECT(data->pipeline))
 	{
 		data->state = new_state;
+		snapshot_set(data, GPLAYER_SNAPSHOT_STATE, new_state);
+		/* Seeks while playing lose the state too, stall_cause tells them apart. Going down to READY is a new track. */
+		if (old_state == GST_STATE_PLAYING && data->target_state == GST_STATE_PLAYING
+				&& (pending_state == GST_STATE_VOID_PENDING || pending_state == GST_STATE_PLAYING))
+			start_rebuffer(data);
 		if (new_state == GST_STATE_PLAYING)
 		{
-			data->buffering_time = 0;
+			end_track_gap(data);
+			end_rebuffer(data, TRUE);
+			mark_startup(data, GPLAYER_STARTUP_PLAYING);
+			data->buffering_start = gst_util_get_timestamp();
 			gplayer_playback_running(data);
 		}
+		if (old_state == GST_STATE_READY && new_state == GST_STATE_PAUSED)
+			update_duration(data);
+		request_decision(data);
 	}
 }
 
+static void buffering_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+	request_decision(data);
+}
+
+static void duration_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+	if (data->state >= GST_STATE_PAUSED)
+		update_duration(data);
+	request_decision(data);
+}
+
 /* Check if all conditions are met to report GStreamer as initialized.
  * These conditions will change depending on the application */
 void check_initialization_complete(CustomData *data)
@@ -399,7 +1031,8 @@ void check_initialization_complete(CustomData *data)
 /* This function will be called by the pad-added signal */
 static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data)
 {
-	GstPad *sink_pad = gst_element_get_static_pad(data->buffer, "sink");
+	GstElement *pipeline = GST_ELEMENT(GST_ELEMENT_PARENT(src));
+	GstPad *sink_pad = gst_element_get_static_pad(get_element(pipeline, "buffer"), "sink");
 	GstPadLinkReturn ret;
 	GstCaps *new_pad_caps = NULL;
 	GstStructure *new_pad_struct = NULL;
@@ -429,9 +1062,13 @@ static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data
 	if (GST_PAD_LINK_FAILED(ret))
 	{
 		GPlayerDEBUG("  Type is '%s' but link failed.\n", new_pad_type);
-		gplayer_error(-1, data);
-		data->target_state = GST_STATE_NULL;
-		data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+		/* A next pipeline that fails here never pre-rolls and is dropped by switch_to_next_pipeline */
+		if (pipeline == data->pipeline)
+		{
+			gplayer_error(-1, data);
+			data->target_state = GST_STATE_NULL;
+			data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+		}
 	}
 	else
 	{
@@ -449,206 +1086,1722 @@ static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data
 
 static void cb_typefound(GstElement *typefind, guint probability, GstCaps *caps, CustomData *data)
 {
+	GstElement *pipeline = GST_ELEMENT(GST_ELEMENT_PARENT(typefind));
 	GstAudioInfo info;
 	gst_audio_info_from_caps(&info, caps);
-	data->audio_info = info;
+	if (pipeline == data->pipeline)
+	{
+		mark_startup(data, GPLAYER_STARTUP_TYPE_FOUND);
+		data->audio_info = info;
+	}
+	else
+		data->next_audio_info = info;
 	GPlayerDEBUG("  Rate is '%i'.\n", info.rate);
 	GPlayerDEBUG("  Channels is '%i'.\n", info.channels);
 	GPlayerDEBUG("  Width is '%i'.\n", info.finfo->width);
 	gint req_buffer_size = info.rate * info.channels * info.finfo->width / 8 * BUFFER_TIME;
 	GPlayerDEBUG("Request buffer size: %i for %i [s] of playback.\n", req_buffer_size, BUFFER_TIME);
-	buffer_size(data, req_buffer_size);
-	gst_object_unref(&info);
+	configure_buffer(data, get_element(pipeline, "source"), get_element(pipeline, "buffer"), req_buffer_size);
+}
+
+static gboolean add_buffer_size(GstBuffer **buffer, guint idx, gsize *size)
+{
+	*size += gst_buffer_get_size(*buffer);
+	return TRUE;
+}
+
+/* gst_buffer_list_calculate_size is only there since GStreamer 1.14 */
+static gsize buffer_list_size(GstBufferList *list)
+{
+	gsize size = 0;
+
+	gst_buffer_list_foreach(list, (GstBufferListFunc) add_buffer_size, &size);
+	return size;
 }
 
-static void worker_notify(CustomData *data)
+static GstPadProbeReturn first_byte_probe(GstPad *pad, GstPadProbeInfo *info, CustomData *data)
 {
-	GPlayerDEBUG("Worker destroyed... %p\n", data->timeout_worker);
-	if (data->main_loop != NULL && data->timeout_worker == NULL)
+	mark_startup(data, GPLAYER_STARTUP_FIRST_BYTE);
+	return GST_PAD_PROBE_REMOVE;
+}
+
+/* Whether the queue2 the source pushes into is above its high watermark, so a push may block until the
+ * decoder takes data out. Any other element downstream is taken as never blocking. */
+static gboolean peer_queue_filled(GstPad *pad)
+{
+	GstPad *peer = gst_pad_get_peer(pad);
+	GstElement *queue = peer ? gst_pad_get_parent_element(peer) : NULL;
+	GstElementFactory *factory = queue ? gst_element_get_factory(queue) : NULL;
+	guint level_buffers = 0, level_bytes = 0, max_buffers = 0, max_bytes = 0;
+	guint64 level_time = 0, max_time = 0;
+	gint high_percent = 100;
+
+	if (factory && strcmp(GST_OBJECT_NAME(factory), "queue2") == 0)
+		g_object_get(queue, "current-level-buffers", &level_buffers, "current-level-bytes", &level_bytes,
+				"current-level-time", &level_time, "max-size-buffers", &max_buffers, "max-size-bytes", &max_bytes,
+				"max-size-time", &max_time, "high-percent", &high_percent, NULL);
+	if (queue)
+		gst_object_unref(queue);
+	if (peer)
+		gst_object_unref(peer);
+
+	return (max_buffers > 0 && (guint64) level_buffers * 100 >= (guint64) max_buffers * high_percent)
+			|| (max_bytes > 0 && (guint64) level_bytes * 100 >= (guint64) max_bytes * high_percent)
+			|| (max_time > 0 && level_time >= gst_util_uint64_scale_int(max_time, high_percent, 100));
+}
+
+/* Count the bytes coming from the network for the bandwidth estimate */
+static GstPadProbeReturn source_bytes_probe(GstPad *pad, GstPadProbeInfo *info, CustomData *data)
+{
+	GstClockTime now;
+	gsize bytes;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+		bytes = buffer_list_size(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+	else if (GST_BUFFER_FLAG_IS_SET(GST_PAD_PROBE_INFO_BUFFER(info), PREFETCH_BUFFER_FLAG))
+		return GST_PAD_PROBE_OK;
+	else
+		bytes = gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+	now = gst_util_get_timestamp();
+	bandwidth_add(&data->bandwidth, bytes, now, peer_queue_filled(pad));
+	__atomic_store_n(&data->last_source_bytes, now, __ATOMIC_RELAXED);
+	snapshot_add(data, GPLAYER_SNAPSHOT_BYTES_DOWNLOADED, bytes);
+	return GST_PAD_PROBE_OK;
+}
+
+/* On every network source: remember where in the stream it is, hold back the EOS of a failed one and time
+ * its recovery at the first bytes after reconnecting */
+static GstPadProbeReturn source_resume_probe(GstPad *pad, GstPadProbeInfo *info, StreamCounters *counters)
+{
+	GstBufferList *list;
+	GstBuffer *buffer;
+	GstClockTime failure;
+	gsize size;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+	{
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS && g_atomic_int_get(&counters->source_failed))
+		{
+			TRACE_INFO(TRACE_EOS_HELD, 0, 0, 0);
+			return GST_PAD_PROBE_DROP;
+		}
+		return GST_PAD_PROBE_OK;
+	}
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+	{
+		list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+		if (gst_buffer_list_length(list) == 0)
+			return GST_PAD_PROBE_OK;
+		buffer = gst_buffer_list_get(list, 0);
+		size = buffer_list_size(list);
+	}
+	else
+	{
+		buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+		size = gst_buffer_get_size(buffer);
+	}
+	if (GST_BUFFER_OFFSET_IS_VALID(buffer))
+		__atomic_store_n(&counters->source_offset, GST_BUFFER_OFFSET(buffer) + size, __ATOMIC_RELAXED);
+	else
+		__atomic_add_fetch(&counters->source_offset, size, __ATOMIC_RELAXED);
+
+	failure = __atomic_exchange_n(&counters->source_failure, GST_CLOCK_TIME_NONE, __ATOMIC_RELAXED);
+	if (GST_CLOCK_TIME_IS_VALID(failure))
 	{
-		create_worker(data);
+		snapshot_add(counters->owner, GPLAYER_SNAPSHOT_RECOVERIES, 1);
+		snapshot_add(counters->owner, GPLAYER_SNAPSHOT_RECOVERY_TIME, (gst_util_get_timestamp() - failure) / GST_USECOND);
+		g_atomic_int_set(&counters->source_retries, 0);
+		TRACE_INFO(TRACE_RECOVERED, (gst_util_get_timestamp() - failure) / GST_MSECOND, 0, 0);
 	}
+	return GST_PAD_PROBE_OK;
 }
 
-static void create_worker(CustomData *data)
+static void set_frame_index(FrameIndex **slot, FrameIndex *index)
 {
-	GSource *bus_source;
-	GstBus *bus;
+	if (*slot)
+		frame_index_unref(*slot);
+	*slot = index;
+}
 
-	bus = gst_element_get_bus(data->pipeline);
-	bus_source = gst_bus_create_watch(bus);
-	if (data->timeout_worker)
+/* uridecodebin created the element reading the uri, for http(s) the gplayer+http(s) source over our HTTP
+ * session. Keep what it downloads, time its first buffer and measure the throughput. */
+static void source_setup_handler(GstElement *bin, GstElement *source, CustomData *data)
+{
+	CacheWriter *writer;
+	GstPad *pad;
+	gchar *uri;
+
+	/* Reconnecting is ours, with a backoff and the stats */
+	if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "retries"))
+		g_object_set(source, "retries", (gint) 0, NULL);
+	pad = is_network_source(GST_OBJECT(source)) ? gst_element_get_static_pad(source, "src") : NULL;
+	if (pad)
+	{
+		/* Ahead of the cache writer, which must not see a held back EOS */
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+				(GstPadProbeCallback) source_resume_probe, g_object_get_data(G_OBJECT(GST_ELEMENT_PARENT(bin)), "counters"), NULL);
+		gst_object_unref(pad);
+	}
+
+	g_object_get(bin, "uri", &uri, NULL);
+	/* A prefetched track is kept under its http uri */
+	writer = cache_writer_new(prefetch_get_original_uri(uri));
+	g_free(uri);
+	if (writer)
+	{
+		/* The first playback builds the index seeks can use before the download is complete */
+		if (GST_ELEMENT(GST_ELEMENT_PARENT(bin)) == data->pipeline)
+			set_frame_index(&data->frame_index, frame_index_ref(cache_writer_get_index(writer)));
+		else
+			set_frame_index(&data->next_frame_index, frame_index_ref(cache_writer_get_index(writer)));
+		pad = gst_element_get_static_pad(source, "src");
+		if (pad)
+		{
+			/* The probe owns the writer, an unfinished download is dropped with the source */
+			gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+					(GstPadProbeCallback) cache_writer_probe, writer, (GDestroyNotify) cache_writer_free);
+			gst_object_unref(pad);
+		}
+		else
+			cache_writer_free(writer);
+	}
+
+	if (GST_ELEMENT(GST_ELEMENT_PARENT(bin)) != data->pipeline)
+		return;
+
+	bandwidth_restart(&data->bandwidth);
+	__atomic_store_n(&data->last_source_bytes, GST_CLOCK_TIME_NONE, __ATOMIC_RELAXED);
+	pad = gst_element_get_static_pad(source, "src");
+	if (pad)
 	{
-		g_source_destroy(data->timeout_worker);
-		g_source_unref(data->timeout_worker);
-		data->timeout_worker = NULL;
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) first_byte_probe, data, NULL);
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, (GstPadProbeCallback) source_bytes_probe, data, NULL);
+		gst_object_unref(pad);
 	}
-	data->timeout_worker = g_timeout_source_new(WORKER_TIMEOUT);
-	g_source_set_callback(data->timeout_worker, (GSourceFunc) gst_worker_cb, data, (GDestroyNotify) worker_notify);
-	g_source_attach(data->timeout_worker, data->context);
-	g_source_attach(bus_source, data->context);
-	g_source_unref(bus_source);
-	GPlayerDEBUG("New worker ready... %p\n", data->timeout_worker);
 }
 
-void build_pipeline(CustomData *data)
+/* Time the first audio of a track, and of a seek: the first buffer after the seek flushed the sink */
+static GstPadProbeReturn sink_buffer_probe(GstPad *pad, GstPadProbeInfo *info, CustomData *data)
 {
-	GstBus *bus;
-	GError *error = NULL;
-	guint flags;
+	GstElement *sink = GST_ELEMENT(GST_PAD_PARENT(pad));
 
-	count_buffer_fill = 0;
-	no_buffer_fill = 0;
-	buffer_is_slow = 0;
-	counter = 0;
+	if (GST_ELEMENT(GST_ELEMENT_PARENT(sink)) != data->pipeline)
+		return GST_PAD_PROBE_OK;
 
-	gst_element_set_state(data->pipeline, GST_STATE_NULL);
-	gst_object_unref(data->pipeline);
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_FLUSH)
+	{
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_FLUSH_STOP)
+			data->seek_flushed = GST_CLOCK_TIME_IS_VALID(data->seek_issued);
+		return GST_PAD_PROBE_OK;
+	}
 
-	gplayer_error(BUFFER_SLOW, data);
-	data->delta_index = 0;
-	data->last_buffer_load = 0;
-	data->buffering_time = 0;
-	data->pipeline = gst_pipeline_new("test-pipeline");
-	data->allow_seek = FALSE;
+	mark_startup(data, GPLAYER_STARTUP_FIRST_AUDIO);
+	if (data->seek_flushed)
+	{
+		snapshot_set(data, GPLAYER_SNAPSHOT_SEEK_LATENCY, (gst_util_get_timestamp() - data->seek_issued) / GST_USECOND);
+		data->seek_issued = GST_CLOCK_TIME_NONE;
+		data->seek_flushed = FALSE;
+		TRACE_INFO(TRACE_SEEK_LATENCY, snapshot_get(data, GPLAYER_SNAPSHOT_SEEK_LATENCY), 0, 0);
+	}
+	return GST_PAD_PROBE_OK;
+}
 
-	/* Build pipeline */
-	data->source = gst_element_factory_make("uridecodebin", "source");
-	data->resample = gst_element_factory_make("audioresample", "resample");
-	data->typefinder = gst_element_factory_make("typefind", "typefind");
-	data->buffer = gst_element_factory_make("queue2", "buffer");
-	data->convert = gst_element_factory_make("audioconvert", "convert");
-	data->volume = gst_element_factory_make("volume", "volume");
-	data->sink = gst_element_factory_make("autoaudiosink", "sink");
+static void end_underrun(StreamCounters *counters)
+{
+	if (counters->underrun_lateness <= 0)
+		return;
+	snapshot_add(counters->owner, GPLAYER_SNAPSHOT_UNDERRUNS, 1);
+	record_stall(counters->owner, counters->underrun_cause, counters->underrun_position, counters->underrun_lateness);
+	counters->underrun_lateness = 0;
+}
 
-	if (!data->pipeline || !data->resample || !data->source || !data->convert || !data->buffer || !data->typefinder || !data->volume || !data->sink)
+/* Merge the tag changes whose audio is being heard into the metadata of the stream */
+static gboolean tags_due_cb(StreamCounters *counters)
+{
+	CustomData *data = counters->owner;
+	GstClockTime until;
+	GstTagList *tags;
+	gboolean changed = FALSE;
+
+	g_atomic_int_set(&counters->tags_pending, FALSE);
+	/* Those of the next pipeline wait until it plays */
+	if (counters != data->counters)
+		return FALSE;
+	until = __atomic_load_n(&counters->tags_due, __ATOMIC_ACQUIRE);
+	while ((tags = tag_timeline_pop(&counters->tags, until)))
 	{
-		gplayer_error(-1, data);
-		GPlayerDEBUG("Not all elements could be created.\n");
-		return;
+		changed |= metadata_merge(&data->metadata, tags);
+		gst_tag_list_unref(tags);
 	}
+	if (changed)
+		schedule_metadata(data);
+	return FALSE;
+}
+
+/* From the streaming thread of the sink, once the audio at until plays */
+static void release_tags(StreamCounters *counters, GstClockTime until)
+{
+	__atomic_store_n(&counters->tags_due, until, __ATOMIC_RELEASE);
+	if (g_atomic_int_compare_and_exchange(&counters->tags_pending, FALSE, TRUE))
+		g_main_context_invoke(counters->owner->context, (GSourceFunc) tags_due_cb, counters);
+}
 
-	gst_bin_add_many(GST_BIN(data->pipeline), data->source, data->buffer, data->typefinder, data->convert, data->resample, data->volume, data->sink,
-	NULL);
-	if (!gst_element_link(data->buffer, data->typefinder) || !gst_element_link(data->typefinder, data->convert)
-			|| !gst_element_link(data->convert, data->resample) || !gst_element_link(data->resample, data->volume) || !gst_element_link(data->volume, data->sink))
+/* Measure playback where it is heard: the audio played, and underruns, audio reaching the sink later than its
+ * running time on the pipeline clock, after the sink played silence in its place. An underrun lasts while audio
+ * keeps coming late, the gap is how late the latest of it was.
+ * Tag events come here in order with the audio. They are stamped with the running time the audio after them
+ * starts at and released once the clock passes it, tags before any audio right away. */
+static GstPadProbeReturn sink_timing_probe(GstPad *pad, GstPadProbeInfo *info, StreamCounters *counters)
+{
+	CustomData *data = counters->owner;
+	GstElement *pipeline = GST_ELEMENT(GST_ELEMENT_PARENT(GST_PAD_PARENT(pad)));
+	GstSegment *segment = &counters->sink_segment;
+	GstClockTimeDiff lateness = 0;
+	GstClockTime pts, running_time, stream_time;
+	GstBuffer *buffer;
+	GstEvent *event;
+	GstClock *clock;
+	GstTagList *tags;
+	GstClockTime now = GST_CLOCK_TIME_NONE;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & (GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH))
 	{
-		GPlayerDEBUG("Elements could not be linked.\n");
-		gst_object_unref(data->pipeline);
-		return;
+		event = GST_PAD_PROBE_INFO_EVENT(info);
+		switch (GST_EVENT_TYPE(event))
+		{
+		case GST_EVENT_SEGMENT:
+			gst_event_copy_segment(event, segment);
+			break;
+		case GST_EVENT_TAG:
+			gst_event_parse_tag(event, &tags);
+			tag_timeline_push(&counters->tags, counters->sink_running_end, tags);
+			if (!GST_CLOCK_TIME_IS_VALID(counters->sink_running_end))
+				release_tags(counters, 0);
+			break;
+		case GST_EVENT_EOS:
+			release_tags(counters, G_MAXUINT64);
+			/* The sink still plays what it holds, the EOS message follows once it is done */
+			clock = gst_element_get_clock(pipeline);
+			if (clock && GST_CLOCK_TIME_IS_VALID(counters->sink_running_end))
+			{
+				running_time = gst_clock_get_time(clock) - gst_element_get_base_time(pipeline);
+				__atomic_store_n(&counters->audio_end, gst_util_get_timestamp()
+						+ (counters->sink_running_end > running_time ? counters->sink_running_end - running_time : 0), __ATOMIC_RELEASE);
+			}
+			if (clock)
+				gst_object_unref(clock);
+			break;
+		case GST_EVENT_FLUSH_STOP:
+			/* The audio the waiting tags belong to is gone, those of the audio after the flush come again */
+			end_underrun(counters);
+			tag_timeline_flush(&counters->tags);
+			counters->sink_running_end = GST_CLOCK_TIME_NONE;
+			break;
+		default:
+			break;
+		}
+		return GST_PAD_PROBE_OK;
 	}
 
-	g_signal_connect(data->source, "pad-added", (GCallback ) pad_added_handler, data);
-	g_signal_connect(data->typefinder, "have-type", (GCallback ) cb_typefound, data);
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	pts = GST_BUFFER_PTS(buffer);
+	if (segment->format != GST_FORMAT_TIME || !GST_CLOCK_TIME_IS_VALID(pts))
+		return GST_PAD_PROBE_OK;
+	stream_time = gst_segment_to_stream_time(segment, GST_FORMAT_TIME, pts);
+	if (GST_CLOCK_TIME_IS_VALID(stream_time))
+		__atomic_store_n(&counters->sink_position, stream_time / GST_USECOND, __ATOMIC_RELAXED);
+	running_time = gst_segment_to_running_time(segment, GST_FORMAT_TIME, pts);
+	if (GST_CLOCK_TIME_IS_VALID(running_time))
+		counters->sink_running_end = running_time + (GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) : 0);
+
+	/* Audio waiting for the pipeline to go to PLAYING is prerolled, not late */
+	if (pipeline != data->pipeline || data->state != GST_STATE_PLAYING || GST_STATE(pipeline) != GST_STATE_PLAYING)
+		return GST_PAD_PROBE_OK;
+	if (GST_BUFFER_DURATION_IS_VALID(buffer))
+		snapshot_add(data, GPLAYER_SNAPSHOT_PLAYED_TIME, GST_BUFFER_DURATION(buffer) / GST_USECOND);
+
+	clock = gst_element_get_clock(pipeline);
+	if (clock)
+	{
+		now = gst_clock_get_time(clock) - gst_element_get_base_time(pipeline);
+		if (GST_CLOCK_TIME_IS_VALID(running_time))
+			lateness = GST_CLOCK_DIFF(running_time, now);
+		gst_object_unref(clock);
+	}
+	if (GST_CLOCK_TIME_IS_VALID(now) && tag_timeline_next_due(&counters->tags) <= now)
+		release_tags(counters, now);
 
-	data->target_state = GST_STATE_READY;
-	gst_element_set_state(data->pipeline, GST_STATE_READY);
+	if (lateness > (GstClockTimeDiff) UNDERRUN_THRESHOLD)
+	{
+		if (counters->underrun_lateness <= 0)
+		{
+			counters->underrun_position = GST_CLOCK_TIME_IS_VALID(stream_time) ? (gint64) (stream_time / GST_USECOND) : -1;
+			counters->underrun_cause = stall_cause(data);
+		}
+		counters->underrun_lateness = MAX(counters->underrun_lateness, lateness);
+	}
+	else
+		end_underrun(counters);
+	return GST_PAD_PROBE_OK;
+}
 
-	bus = gst_element_get_bus(data->pipeline);
+/* Copy the audio of the current pipeline into the PCM tap while it is enabled. The format is taken from
+ * the pad again once another pipeline became the current one. */
+static GstPadProbeReturn pcm_tap_probe(GstPad *pad, GstPadProbeInfo *info, CustomData *data)
+{
+	GstElement *volume = GST_ELEMENT(GST_PAD_PARENT(pad));
+	GstBuffer *buffer;
+	GstMapInfo map;
+	GstCaps *caps;
 
-	worker_notify(data);
+	if (!g_atomic_int_get(&data->pcm_tap_enabled) || GST_ELEMENT(GST_ELEMENT_PARENT(volume)) != data->pipeline)
+		return GST_PAD_PROBE_OK;
 
-	g_signal_connect(G_OBJECT(bus), "message::error", (GCallback ) error_cb, data);
-	g_signal_connect(G_OBJECT(bus), "message::eos", (GCallback ) eos_cb, data);
-	g_signal_connect(G_OBJECT(bus), "message::tag", (GCallback ) tag_cb, data);
-	g_signal_connect(G_OBJECT(bus), "message::state-changed", (GCallback ) state_changed_cb, data);
-	g_signal_connect(G_OBJECT(bus), "message::clock-lost", (GCallback ) clock_lost_cb, data);
-	gst_object_unref(bus);
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+	{
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_CAPS)
+		{
+			gst_event_parse_caps(GST_PAD_PROBE_INFO_EVENT(info), &caps);
+			pcm_tap_set_format(data->pcm_tap, pad, caps);
+		}
+		return GST_PAD_PROBE_OK;
+	}
 
+	if (data->pcm_tap->format_pad != pad)
+	{
+		caps = gst_pad_get_current_caps(pad);
+		pcm_tap_set_format(data->pcm_tap, pad, caps);
+		if (caps)
+			gst_caps_unref(caps);
+	}
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	gst_buffer_map(buffer, &map, GST_MAP_READ);
+	pcm_tap_write(data->pcm_tap, map.data, map.size);
+	gst_buffer_unmap(buffer, &map);
+	return GST_PAD_PROBE_OK;
 }
 
-/* Main method for the native code. This is executed on its own thread. */
-static void *
-app_function(void *userdata)
+/* Link typefind straight to the gain element, or through audioconvert and audioresample again */
+static void set_conversion_bypass(GstElement *pipeline, gboolean bypass)
 {
-	CustomData *data = (CustomData *) userdata;
+	GstElement *typefinder = get_element(pipeline, "typefind");
+	GstElement *convert = get_element(pipeline, "convert");
+	GstElement *resample = get_element(pipeline, "resample");
+	GstElement *volume = get_element(pipeline, "volume");
+	GstPad *pad = gst_element_get_static_pad(volume, "sink");
+	GstPad *peer = gst_pad_get_peer(pad);
+	gboolean bypassed = peer && GST_PAD_PARENT(peer) == typefinder;
+	GstEvent *event;
+
+	if (peer)
+		gst_object_unref(peer);
+	gst_object_unref(pad);
+	if (bypass == bypassed)
+		return;
 
-	GPlayerDEBUG("Creating pipeline in CustomData at %p", data);
+	GPlayerDEBUG("%s audioconvert and audioresample", bypass ? "Bypassing" : "Restoring");
+	if (bypass)
+	{
+		gst_element_unlink(typefinder, convert);
+		gst_element_unlink(resample, volume);
+		gst_element_link(typefinder, volume);
+	}
+	else
+	{
+		gst_element_unlink(typefinder, volume);
+		gst_element_link(typefinder, convert);
+		gst_element_link(resample, volume);
+	}
 
-	/* Create our own GLib Main Context and make it the default one */
-	data->context = g_main_context_new();
-	g_main_context_push_thread_default(data->context);
+	/* The other sticky events are sent again to the new peer on their own, but only after the caps
+	 * being pushed now, which have to follow the stream start */
+	pad = gst_element_get_static_pad(typefinder, "src");
+	event = gst_pad_get_sticky_event(pad, GST_EVENT_STREAM_START, 0);
+	peer = gst_pad_get_peer(pad);
+	if (event && peer)
+		gst_pad_send_event(peer, event);
+	else if (event)
+		gst_event_unref(event);
+	if (peer)
+		gst_object_unref(peer);
+	gst_object_unref(pad);
+}
 
-	data->pipeline = gst_pipeline_new("test-pipeline");
+/* Leave the converters out while the gain element and the sink take the decoded caps as they are. The
+ * caps are checked again on every change, a new track or a stream changing its rate gets them back when
+ * needed. Only the thread pushing this event streams behind typefind, so the pads can be relinked here,
+ * before the event goes to the peer. */
+static GstPadProbeReturn conversion_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	GstElement *pipeline = GST_ELEMENT(GST_ELEMENT_PARENT(GST_PAD_PARENT(pad)));
+	GstPad *volume_pad;
+	GstCaps *caps;
+
+	if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_CAPS)
+		return GST_PAD_PROBE_OK;
+
+	gst_event_parse_caps(GST_PAD_PROBE_INFO_EVENT(info), &caps);
+	volume_pad = gst_element_get_static_pad(get_element(pipeline, "volume"), "sink");
+	set_conversion_bypass(pipeline, gst_pad_query_accept_caps(volume_pad, caps));
+	gst_object_unref(volume_pad);
+	return GST_PAD_PROBE_OK;
+}
 
-	build_pipeline(data);
+/* Note which conversions the caps reaching the gain element went through */
+static GstPadProbeReturn conversions_probe(GstPad *pad, GstPadProbeInfo *info, StreamCounters *counters)
+{
+	GstElement *typefinder = get_element(GST_ELEMENT(GST_ELEMENT_PARENT(GST_PAD_PARENT(pad))), "typefind");
+	GstPad *decoded_pad, *peer;
+	GstCaps *caps, *decoded;
+	GstAudioInfo in, out;
+	gint conversions = 0;
+
+	if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_CAPS)
+		return GST_PAD_PROBE_OK;
+
+	gst_event_parse_caps(GST_PAD_PROBE_INFO_EVENT(info), &caps);
+	peer = gst_pad_get_peer(pad);
+	decoded_pad = gst_element_get_static_pad(typefinder, "src");
+	decoded = gst_pad_get_current_caps(decoded_pad);
+	if (peer && GST_PAD_PARENT(peer) == typefinder)
+		conversions = GPLAYER_CONVERSION_BYPASSED;
+	else if (decoded && gst_audio_info_from_caps(&in, decoded) && gst_audio_info_from_caps(&out, caps))
+	{
+		if (GST_AUDIO_INFO_FORMAT(&in) != GST_AUDIO_INFO_FORMAT(&out) || GST_AUDIO_INFO_CHANNELS(&in) != GST_AUDIO_INFO_CHANNELS(&out))
+			conversions |= GPLAYER_CONVERSION_FORMAT;
+		if (GST_AUDIO_INFO_RATE(&in) != GST_AUDIO_INFO_RATE(&out))
+			conversions |= GPLAYER_CONVERSION_RESAMPLE;
+	}
+	g_atomic_int_set(&counters->conversions, conversions);
+
+	if (decoded)
+		gst_caps_unref(decoded);
+	if (peer)
+		gst_object_unref(peer);
+	gst_object_unref(decoded_pad);
+	return GST_PAD_PROBE_OK;
+}
 
-	/* Create a GLib Main Loop and set it to run */
-	GPlayerDEBUG("Entering main loop... (CustomData:%p)", data);
-	data->main_loop = g_main_loop_new(data->context, FALSE);
-	check_initialization_complete(data);
-	g_main_loop_run(data->main_loop);
-	GPlayerDEBUG("Exited main loop");
-	g_main_loop_unref(data->main_loop);
-	data->main_loop = NULL;
+static gint64 thread_cpu_time(void)
+{
+	struct timespec ts;
 
-	/* Free resources */
-	g_main_context_pop_thread_default(data->context);
-	g_main_context_unref(data->context);
-	data->target_state = GST_STATE_NULL;
-	gst_element_set_state(data->pipeline, GST_STATE_NULL);
-	gst_object_unref(data->pipeline);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
 
-	return NULL;
+/* Count the audio entering the queue, and the CPU time the thread feeding it spent since its previous buffer */
+static GstPadProbeReturn queue_in_probe(GstPad *pad, GstPadProbeInfo *info, StreamCounters *counters)
+{
+	GstBuffer *buffer;
+	gpointer thread;
+	gint64 cpu;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_FLUSH)
+	{
+		/* The output side is stopped until this flush is over */
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_FLUSH_STOP)
+		{
+			__atomic_store_n(&counters->queue_bytes, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&counters->queue_time, 0, __ATOMIC_RELAXED);
+		}
+		return GST_PAD_PROBE_OK;
+	}
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	__atomic_add_fetch(&counters->queue_bytes, gst_buffer_get_size(buffer), __ATOMIC_RELAXED);
+	if (GST_BUFFER_DURATION_IS_VALID(buffer))
+		__atomic_add_fetch(&counters->queue_time, GST_BUFFER_DURATION(buffer) / GST_USECOND, __ATOMIC_RELAXED);
+
+	thread = g_thread_self();
+	cpu = thread_cpu_time();
+	if (thread == counters->decode_thread)
+		__atomic_add_fetch(counters->decode_cpu_total, cpu - counters->decode_cpu, __ATOMIC_RELAXED);
+	counters->decode_thread = thread;
+	counters->decode_cpu = cpu;
+	return GST_PAD_PROBE_OK;
 }
 
-/*
- * Java Bindings
- */
+static GstPadProbeReturn queue_out_probe(GstPad *pad, GstPadProbeInfo *info, StreamCounters *counters)
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
 
-void set_notifyfunction(CustomData *data)
+	__atomic_sub_fetch(&counters->queue_bytes, gst_buffer_get_size(buffer), __ATOMIC_RELAXED);
+	if (GST_BUFFER_DURATION_IS_VALID(buffer))
+		__atomic_sub_fetch(&counters->queue_time, GST_BUFFER_DURATION(buffer) / GST_USECOND, __ATOMIC_RELAXED);
+	return GST_PAD_PROBE_OK;
+}
+
+/* Track the input side of the queue, an empty queue after EOS on its input is no starvation */
+static GstPadProbeReturn buffer_event_probe(GstPad *pad, GstPadProbeInfo *info, CustomData *data)
 {
-	GstBus *bus;
-	GSource *bus_source;
+	GstElement *buffer = GST_ELEMENT(GST_PAD_PARENT(pad));
 
-	if (data->notify_time > 0)
+	if (GST_ELEMENT(GST_ELEMENT_PARENT(buffer)) != data->pipeline)
+		return GST_PAD_PROBE_OK;
+
+	switch (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)))
 	{
-		bus = gst_element_get_bus(data->pipeline);
-		bus_source = gst_bus_create_watch(bus);
-		g_source_set_callback(bus_source, (GSourceFunc) gst_bus_async_signal_func, NULL,
-		NULL);
-		g_source_attach(bus_source, data->context);
-		g_source_unref(bus_source);
+	case GST_EVENT_EOS:
+		g_atomic_int_set(&data->input_eos, TRUE);
+		break;
+	case GST_EVENT_STREAM_START:
+	case GST_EVENT_FLUSH_STOP:
+		g_atomic_int_set(&data->input_eos, FALSE);
+		break;
+	default:
+		break;
+	}
+	return GST_PAD_PROBE_OK;
+}
 
-		if (data->timeout_source)
+/* Run the buffering worker for every player waiting on a decision, on the shared main loop thread.
+ * The timer goes away when nobody waits any more, schedule_worker brings it back. */
+static gboolean shared_worker_cb(gpointer userdata)
+{
+	GList *snapshot, *l;
+	gboolean pending = FALSE;
+
+	g_mutex_lock(&players_lock);
+	snapshot = g_list_copy(players);
+	g_mutex_unlock(&players_lock);
+
+	for (l = snapshot; l; l = l->next)
+	{
+		/* One of the callbacks may have released a player meanwhile */
+		g_mutex_lock(&players_lock);
+		gboolean alive = g_list_find(players, l->data) != NULL;
+		g_mutex_unlock(&players_lock);
+		if (alive && ((CustomData *) l->data)->worker_pending)
 		{
-			g_source_destroy(data->timeout_source);
+			CustomData *data = l->data;
+			data->worker_wakeups++;
+			data->worker_pending = gst_worker_cb(data);
+			pending |= data->worker_pending;
 		}
-		/* Register a function that GLib will call 4 times per second */
-		data->timeout_source = g_timeout_source_new(data->notify_time);
-		g_source_set_callback(data->timeout_source, (GSourceFunc) gst_notify_time_cb, data, NULL);
-		g_source_attach(data->timeout_source, data->context);
-		g_source_unref(data->timeout_source);
 	}
+	g_list_free(snapshot);
+
+	if (pending)
+		return TRUE;
+
+	g_mutex_lock(&players_lock);
+	if (shared_worker == g_main_current_source())
+	{
+		g_source_unref(shared_worker);
+		shared_worker = NULL;
+	}
+	g_mutex_unlock(&players_lock);
+	return FALSE;
 }
 
-/* Instruct the native code to create its internal data structure, pipeline and thread */
-void gst_native_init(JNIEnv* env, jobject thiz)
+/* Keep the worker timer running for this player, only called on the shared main loop thread */
+static void schedule_worker(CustomData *data)
 {
-	CustomData *data = g_new0(CustomData, 1);
-	data->last_seek_time = GST_CLOCK_TIME_NONE;
-	SET_CUSTOM_DATA(env, thiz, custom_data_field_id, data);
-	GPlayerDEBUG("Created CustomData at %p", data);
-	data->app = (*env)->NewGlobalRef(env, thiz);
-	GPlayerDEBUG("Created GlobalRef for app object at %p", data->app);
-	pthread_create(&gst_app_thread, NULL, &app_function, data);
+	data->worker_pending = TRUE;
+	g_mutex_lock(&players_lock);
+	if (!shared_worker && shared_context)
+	{
+		shared_worker = g_timeout_source_new(WORKER_TIMEOUT);
+		g_source_set_callback(shared_worker, (GSourceFunc) shared_worker_cb, NULL, NULL);
+		g_source_attach(shared_worker, shared_context);
+	}
+	g_mutex_unlock(&players_lock);
 }
 
-/* Quit the main loop, remove the native thread and free resources */
-void gst_native_finalize(JNIEnv* env, jobject thiz)
+/* Something the buffering decisions depend on has changed, take them right away */
+static void request_decision(CustomData *data)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data)
-		return;
-	data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_NULL) == GST_STATE_CHANGE_NO_PREROLL);
-	GPlayerDEBUG("Quitting main loop...");
-	g_main_loop_quit(data->main_loop);
-	GPlayerDEBUG("Waiting for thread to finish...");
-	pthread_join(gst_app_thread, NULL);
-	GPlayerDEBUG("Deleting GlobalRef for app object at %p", data->app);
-	(*env)->DeleteGlobalRef(env, data->app);
-	GPlayerDEBUG("Freeing CustomData at %p", data);
-	g_free(data);
-	SET_CUSTOM_DATA(env, thiz, custom_data_field_id, NULL);
-	GPlayerDEBUG("Done finalizing");
+	if (gst_worker_cb(data))
+		schedule_worker(data);
+}
+
+static gboolean request_decision_cb(CustomData *data)
+{
+	request_decision(data);
+	return FALSE;
+}
+
+/* Attach a signal watch for the pipeline bus to our main context and connect the message handlers */
+static void connect_bus(CustomData *data)
+{
+	GstBus *bus = gst_element_get_bus(data->pipeline);
+
+	data->bus_source = gst_bus_create_watch(bus);
+	g_source_set_callback(data->bus_source, (GSourceFunc) gst_bus_async_signal_func, NULL, NULL);
+	g_source_attach(data->bus_source, data->context);
+
+	g_signal_connect(G_OBJECT(bus), "message::error", (GCallback ) error_cb, data);
+	g_signal_connect(G_OBJECT(bus), "message::eos", (GCallback ) eos_cb, data);
+	g_signal_connect(G_OBJECT(bus), "message::tag", (GCallback ) tag_cb, data);
+	g_signal_connect(G_OBJECT(bus), "message::state-changed", (GCallback ) state_changed_cb, data);
+	g_signal_connect(G_OBJECT(bus), "message::clock-lost", (GCallback ) clock_lost_cb, data);
+	g_signal_connect(G_OBJECT(bus), "message::buffering", (GCallback ) buffering_cb, data);
+	g_signal_connect(G_OBJECT(bus), "message::duration-changed", (GCallback ) duration_cb, data);
+	gst_object_unref(bus);
+}
+
+static void disconnect_bus(CustomData *data)
+{
+	if (data->bus_source)
+	{
+		g_source_destroy(data->bus_source);
+		g_source_unref(data->bus_source);
+		data->bus_source = NULL;
+	}
+}
+
+static void disconnect_next_bus(CustomData *data)
+{
+	if (data->next_bus_source)
+	{
+		g_source_destroy(data->next_bus_source);
+		g_source_unref(data->next_bus_source);
+		data->next_bus_source = NULL;
+	}
+}
+
+static void reset_buffering(CustomData *data)
+{
+	data->buffer_is_slow = 0;
+	data->starve_start = GST_CLOCK_TIME_NONE;
+	g_atomic_int_set(&data->input_eos, FALSE);
+	/* Waiting for another track is no stall */
+	end_rebuffer(data, FALSE);
+	cancel_retry(data);
+	/* The next stream starts without tags */
+	cancel_metadata(data);
+	metadata_clear(&data->metadata);
+
+	data->bitrate = 0;
+	data->last_speed_check = GST_CLOCK_TIME_NONE;
+	data->buffering_start = gst_util_get_timestamp();
+}
+
+/* Create a uridecodebin ! queue2 ! typefind ! audioconvert ! audioresample ! gplayergain ! autoaudiosink pipeline */
+static GstElement *create_pipeline(CustomData *data)
+{
+	GstElement *pipeline, *source, *resample, *typefinder, *buffer, *convert, *volume, *sink;
+	StreamCounters *counters;
+	GstBus *bus;
+
+	pipeline = gst_pipeline_new("test-pipeline");
+	source = gst_element_factory_make("uridecodebin", "source");
+	resample = gst_element_factory_make("audioresample", "resample");
+	typefinder = gst_element_factory_make("typefind", "typefind");
+	buffer = gst_element_factory_make("queue2", "buffer");
+	convert = gst_element_factory_make("audioconvert", "convert");
+	volume = gst_element_factory_make("gplayergain", "volume");
+	sink = gst_element_factory_make("autoaudiosink", "sink");
+
+	if (!pipeline || !resample || !source || !convert || !buffer || !typefinder || !volume || !sink)
+	{
+		GPlayerDEBUG("Not all elements could be created.\n");
+		return NULL;
+	}
+
+	gst_bin_add_many(GST_BIN(pipeline), source, buffer, typefinder, convert, resample, volume, sink, NULL);
+	if (!gst_element_link(buffer, typefinder) || !gst_element_link(typefinder, convert) || !gst_element_link(convert, resample)
+			|| !gst_element_link(resample, volume) || !gst_element_link(volume, sink))
+	{
+		GPlayerDEBUG("Elements could not be linked.\n");
+		gst_object_unref(pipeline);
+		return NULL;
+	}
+	g_object_set(volume, "left", (gdouble) data->volume_left, "right", (gdouble) data->volume_right, NULL);
+
+	/* The current pipeline keeps its counters until the next one has replaced it */
+	counters = data->counters == &data->stream_counters[0] ? &data->stream_counters[1] : &data->stream_counters[0];
+	tag_timeline_clear(&counters->tags);
+	memset(counters, 0, sizeof(StreamCounters));
+	tag_timeline_init(&counters->tags);
+	counters->sink_running_end = GST_CLOCK_TIME_NONE;
+	counters->audio_end = GST_CLOCK_TIME_NONE;
+	counters->decode_cpu_total = &data->snapshot[GPLAYER_SNAPSHOT_DECODE_CPU_TIME];
+	counters->sink_position = -1;
+	counters->source_failure = GST_CLOCK_TIME_NONE;
+	counters->owner = data;
+	g_object_set_data(G_OBJECT(pipeline), "counters", counters);
+
+	bus = gst_element_get_bus(pipeline);
+	gst_bus_enable_sync_message_emission(bus);
+	g_signal_connect(G_OBJECT(bus), "sync-message::error", (GCallback ) source_error_sync_cb, counters);
+	gst_object_unref(bus);
+
+	g_signal_connect(source, "pad-added", (GCallback ) pad_added_handler, data);
+	g_signal_connect(source, "source-setup", (GCallback ) source_setup_handler, data);
+	g_signal_connect(typefinder, "have-type", (GCallback ) cb_typefound, data);
+
+	GstPad *pad = gst_element_get_static_pad(sink, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) sink_buffer_probe, data, NULL);
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+			(GstPadProbeCallback) sink_timing_probe, counters, NULL);
+	gst_object_unref(pad);
+
+	pad = gst_element_get_static_pad(volume, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback) pcm_tap_probe, data, NULL);
+	gst_object_unref(pad);
+
+	pad = gst_element_get_static_pad(typefinder, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, conversion_probe, NULL, NULL);
+	gst_object_unref(pad);
+
+	pad = gst_element_get_static_pad(volume, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback) conversions_probe, counters, NULL);
+	gst_object_unref(pad);
+
+	pad = gst_element_get_static_pad(buffer, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) queue_out_probe, counters, NULL);
+	gst_object_unref(pad);
+
+	pad = gst_element_get_static_pad(buffer, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) buffer_event_probe, data, NULL);
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) queue_in_probe, counters, NULL);
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+			(GstPadProbeCallback) indexed_seek_probe, &data->indexed_seek, NULL);
+	gst_object_unref(pad);
+
+	return pipeline;
+}
+
+/* Make the given pipeline the current one, or none */
+static void bind_pipeline(CustomData *data, GstElement *pipeline)
+{
+	g_mutex_lock(&data->pipeline_lock);
+	data->pipeline = pipeline;
+	data->source = pipeline ? get_element(pipeline, "source") : NULL;
+	data->resample = pipeline ? get_element(pipeline, "resample") : NULL;
+	data->typefinder = pipeline ? get_element(pipeline, "typefind") : NULL;
+	data->buffer = pipeline ? get_element(pipeline, "buffer") : NULL;
+	data->convert = pipeline ? get_element(pipeline, "convert") : NULL;
+	data->volume = pipeline ? get_element(pipeline, "volume") : NULL;
+	data->sink = pipeline ? get_element(pipeline, "sink") : NULL;
+	g_mutex_unlock(&data->pipeline_lock);
+	if (pipeline)
+		__atomic_store_n(&data->counters, g_object_get_data(G_OBJECT(pipeline), "counters"), __ATOMIC_RELEASE);
+}
+
+/* Stop and drop the current pipeline */
+static void release_pipeline(CustomData *data)
+{
+	GstElement *pipeline = data->pipeline;
+
+	if (!pipeline)
+		return;
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	bind_pipeline(data, NULL);
+	gst_object_unref(pipeline);
+}
+
+void build_pipeline(CustomData *data)
+{
+	reset_buffering(data);
+	discard_next_pipeline(data);
+	disconnect_bus(data);
+	release_pipeline(data);
+
+	gplayer_error(BUFFER_SLOW, data);
+	data->allow_seek = FALSE;
+
+	GstElement *pipeline = create_pipeline(data);
+	if (!pipeline)
+	{
+		gplayer_error(-1, data);
+		return;
+	}
+	bind_pipeline(data, pipeline);
+
+	data->target_state = GST_STATE_READY;
+	gst_element_set_state(data->pipeline, GST_STATE_READY);
+
+	connect_bus(data);
+}
+
+/* Prepare the pipeline for a new uri. Going back to READY makes uridecodebin drop the source and decoders
+ * of the previous uri and flushes queue2, while the audio sink stays open and the bus handlers stay
+ * connected. The pipeline is only built from scratch when there is none or its graph has to change. */
+void prepare_pipeline(CustomData *data)
+{
+	GstBus *bus;
+
+	if (!data->pipeline || data->rebuild_pipeline)
+	{
+		GPlayerDEBUG("Rebuilding pipeline");
+		data->rebuild_pipeline = FALSE;
+		build_pipeline(data);
+		return;
+	}
+
+	reset_buffering(data);
+	discard_next_pipeline(data);
+	cancel_seek(data);
+
+	gplayer_error(BUFFER_SLOW, data);
+	data->allow_seek = FALSE;
+
+	data->target_state = GST_STATE_READY;
+	if (gst_element_set_state(data->pipeline, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+	{
+		GPlayerDEBUG("Pipeline can not be reused");
+		build_pipeline(data);
+		return;
+	}
+
+	/* Going to READY dropped the queued audio without a flush, and the source of the previous uri */
+	__atomic_store_n(&data->counters->queue_bytes, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&data->counters->queue_time, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&data->counters->source_offset, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&data->counters->source_failure, GST_CLOCK_TIME_NONE, __ATOMIC_RELAXED);
+	g_atomic_int_set(&data->counters->source_failed, FALSE);
+	g_atomic_int_set(&data->counters->source_retries, 0);
+	tag_timeline_flush(&data->counters->tags);
+	data->counters->sink_running_end = GST_CLOCK_TIME_NONE;
+
+	/* Messages of the previous uri, an EOS in particular, must not reach the handlers */
+	bus = gst_element_get_bus(data->pipeline);
+	gst_bus_set_flushing(bus, TRUE);
+	gst_bus_set_flushing(bus, FALSE);
+	gst_object_unref(bus);
+
+	GPlayerDEBUG("Reusing pipeline");
+}
+
+/* The uri to play a cached copy of uri from, or NULL. A copy with a frame index is read in push mode, where
+ * the indexed seeks work. */
+static gchar *lookup_cache(const gchar *uri, FrameIndex **index)
+{
+	gchar *cached = cache_lookup(uri);
+	gchar *push_uri;
+
+	set_frame_index(index, cached ? cache_get_index(uri) : NULL);
+	if (*index)
+	{
+		push_uri = g_strconcat(CACHE_SCHEME_PREFIX, cached, NULL);
+		g_free(cached);
+		cached = push_uri;
+	}
+	return cached;
+}
+
+/* Drop the pre-rolled next pipeline, if there is one */
+void discard_next_pipeline(CustomData *data)
+{
+	if (!data->next_pipeline)
+		return;
+
+	GPlayerDEBUG("Discarding next pipeline");
+	disconnect_next_bus(data);
+	gst_element_set_state(data->next_pipeline, GST_STATE_NULL);
+	gst_object_unref(data->next_pipeline);
+	data->next_pipeline = NULL;
+	set_frame_index(&data->next_frame_index, NULL);
+}
+
+/* Messages of the pre-rolling next pipeline. Only what the switch needs is kept, the rest would otherwise pile up
+ * on its bus and reach the handlers of the current track in one burst. */
+static gboolean next_bus_cb(GstBus *bus, GstMessage *msg, CustomData *data)
+{
+	GError *err = NULL;
+	GstTagList *tags = NULL;
+	guint bitrate;
+
+	switch (GST_MESSAGE_TYPE(msg))
+	{
+	case GST_MESSAGE_ERROR:
+		gst_message_parse_error(msg, &err, NULL);
+		GPlayerDEBUG("Next pipeline failed: %s", err->message);
+		g_error_free(err);
+		/* The current track completes as if there was no next one, the application starts it again */
+		discard_next_pipeline(data);
+		break;
+	case GST_MESSAGE_TAG:
+		gst_message_parse_tag(msg, &tags);
+		if (gst_tag_list_get_uint(tags, GST_TAG_BITRATE, &bitrate)
+				|| (data->next_bitrate == 0 && gst_tag_list_get_uint(tags, GST_TAG_NOMINAL_BITRATE, &bitrate)))
+			data->next_bitrate = bitrate;
+		gst_tag_list_unref(tags);
+		break;
+	default:
+		break;
+	}
+	return TRUE;
+}
+
+/* Build a second pipeline for the next track and pre-roll it while the current one plays,
+ * so eos_cb only has to set it to PLAYING. Runs on the shared thread. */
+void set_next_source(CustomData *data, const gchar *uri, gboolean seek)
+{
+	gchar *cached;
+	GstBus *bus;
+
+	discard_next_pipeline(data);
+
+	data->next_pipeline = create_pipeline(data);
+	if (!data->next_pipeline)
+		return;
+
+	bus = gst_element_get_bus(data->next_pipeline);
+	data->next_bus_source = gst_bus_create_watch(bus);
+	g_source_set_callback(data->next_bus_source, (GSourceFunc) next_bus_cb, data, NULL);
+	g_source_attach(data->next_bus_source, data->context);
+	gst_object_unref(bus);
+	data->next_bitrate = 0;
+
+	cached = lookup_cache(uri, &data->next_frame_index);
+	data->next_from_cache = cached != NULL;
+	if (!cached)
+		cached = prefetch_claim(uri);
+	configure_source(data, get_element(data->next_pipeline, "source"));
+	g_object_set(get_element(data->next_pipeline, "source"), "uri", cached ? cached : uri, NULL);
+	g_free(cached);
+	data->next_allow_seek = seek;
+	gst_element_set_state(data->next_pipeline, GST_STATE_PAUSED);
+}
+
+/* Replace the finished pipeline with the pre-rolled next one. Returns FALSE if there is nothing to switch to. */
+static gboolean switch_to_next_pipeline(CustomData *data)
+{
+	GstElement *finished = data->pipeline;
+	GstStateChangeReturn ret;
+
+	if (!data->next_pipeline)
+		return FALSE;
+
+	if (gst_element_get_state(data->next_pipeline, NULL, NULL, 0) == GST_STATE_CHANGE_FAILURE)
+	{
+		GPlayerDEBUG("Next pipeline failed to pre-roll");
+		discard_next_pipeline(data);
+		return FALSE;
+	}
+
+	disconnect_next_bus(data);
+	disconnect_bus(data);
+	reset_buffering(data);
+	cancel_seek(data);
+	data->bitrate = data->next_bitrate;
+	data->track_gap_start = __atomic_load_n(&data->counters->audio_end, __ATOMIC_ACQUIRE);
+
+	/* Time the switch like a setDataSource, only the phases after pre-rolling are reached. The next
+	 * pipeline marks phases once it is bound. */
+	start_startup(data, gst_util_get_timestamp());
+	bind_pipeline(data, data->next_pipeline);
+	data->next_pipeline = NULL;
+	g_object_set(data->volume, "left", (gdouble) data->volume_left, "right", (gdouble) data->volume_right, NULL);
+	data->audio_info = data->next_audio_info;
+	data->allow_seek = data->next_allow_seek;
+	data->from_cache = data->next_from_cache;
+	set_frame_index(&data->frame_index, data->next_frame_index);
+	data->next_frame_index = NULL;
+	data->duration = GST_CLOCK_TIME_NONE;
+	data->position = 0;
+	data->desired_position = GST_CLOCK_TIME_NONE;
+
+	/* Start the new track first, the old sink can be closed afterwards. Its sink plays the pre-rolled audio as
+	 * soon as it is PLAYING, else the gap ends with the state change. */
+	ret = gst_element_set_state(data->pipeline, GST_STATE_PLAYING);
+	data->is_live = (ret == GST_STATE_CHANGE_NO_PREROLL);
+	if (ret != GST_STATE_CHANGE_ASYNC)
+		end_track_gap(data);
+	connect_bus(data);
+
+	gst_element_set_state(finished, GST_STATE_NULL);
+	gst_object_unref(finished);
+
+	GPlayerDEBUG("Switched to next pipeline");
+	gplayer_track_changed(data);
+	return TRUE;
+}
+
+/* Main method of the shared native thread. All players attach their sources to its main loop. The thread owns
+ * references to the loop and its context, the last player may be released from one of its callbacks. */
+static void *
+app_function(void *userdata)
+{
+	GMainLoop *main_loop = (GMainLoop *) userdata;
+	GMainContext *context = g_main_context_ref(g_main_loop_get_context(main_loop));
+
+	/* Make the shared GLib Main Context the default one of this thread */
+	g_main_context_push_thread_default(context);
+
+	GPlayerDEBUG("Entering main loop... (context:%p)", context);
+	g_main_loop_run(main_loop);
+	GPlayerDEBUG("Exited main loop");
+
+	g_main_context_pop_thread_default(context);
+	g_main_loop_unref(main_loop);
+	g_main_context_unref(context);
+
+	return NULL;
+}
+
+static gboolean main_loop_call_cb(MainLoopCall *call)
+{
+	call->func(call->data);
+
+	g_mutex_lock(&call_lock);
+	call->done = TRUE;
+	g_cond_broadcast(&call_cond);
+	g_mutex_unlock(&call_lock);
+
+	return FALSE;
+}
+
+/* Run func on the shared main loop thread and wait for it to finish */
+static void run_on_main_loop(GSourceFunc func, gpointer data)
+{
+	MainLoopCall call = { func, data, FALSE };
+
+	if (g_main_context_is_owner(shared_context))
+	{
+		func(data);
+		return;
+	}
+
+	g_main_context_invoke(shared_context, (GSourceFunc) main_loop_call_cb, &call);
+	g_mutex_lock(&call_lock);
+	while (!call.done)
+		g_cond_wait(&call_cond, &call_lock);
+	g_mutex_unlock(&call_lock);
+}
+
+static void init_elements(void)
+{
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized))
+	{
+		cache_init();
+		gain_init();
+		prefetch_init();
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+/* Register a player, starting the shared thread for the first one */
+static void add_player(CustomData *data)
+{
+	g_mutex_lock(&players_lock);
+	if (!shared_context)
+	{
+		shared_context = g_main_context_new();
+		shared_loop = g_main_loop_new(shared_context, FALSE);
+
+		pthread_create(&main_loop_thread, NULL, &app_function, g_main_loop_ref(shared_loop));
+		GPlayerDEBUG("Started shared main loop thread");
+	}
+	data->context = g_main_context_ref(shared_context);
+	data->main_loop = g_main_loop_ref(shared_loop);
+	players = g_list_append(players, data);
+	g_mutex_unlock(&players_lock);
+}
+
+/* Unregister a player, stopping the shared thread with the last one */
+static void remove_player(CustomData *data)
+{
+	GMainContext *context = NULL;
+	GMainLoop *main_loop = NULL;
+	GSource *worker = NULL;
+	pthread_t thread;
+
+	g_mutex_lock(&players_lock);
+	players = g_list_remove(players, data);
+	if (!players)
+	{
+		thread = main_loop_thread;
+		context = shared_context;
+		main_loop = shared_loop;
+		worker = shared_worker;
+		shared_context = NULL;
+		shared_loop = NULL;
+		shared_worker = NULL;
+	}
+	g_mutex_unlock(&players_lock);
+
+	g_main_loop_unref(data->main_loop);
+	g_main_context_unref(data->context);
+	data->main_loop = NULL;
+	data->context = NULL;
+
+	if (main_loop)
+	{
+		if (worker)
+		{
+			g_source_destroy(worker);
+			g_source_unref(worker);
+		}
+		GPlayerDEBUG("Quitting shared main loop...");
+		g_main_loop_quit(main_loop);
+		if (g_main_context_is_owner(context))
+		{
+			/* Released from one of our own callbacks, the thread ends on its own */
+			pthread_detach(thread);
+		}
+		else
+		{
+			GPlayerDEBUG("Waiting for thread to finish...");
+			pthread_join(thread, NULL);
+		}
+		g_main_loop_unref(main_loop);
+		g_main_context_unref(context);
+	}
+}
+
+static gboolean init_player(CustomData *data)
+{
+	GPlayerDEBUG("Creating pipeline in CustomData at %p", data);
+	build_pipeline(data);
+	check_initialization_complete(data);
+	return FALSE;
+}
+
+static gboolean release_player(CustomData *data)
+{
+	discard_next_pipeline(data);
+	disconnect_bus(data);
+	cancel_seek(data);
+	cancel_retry(data);
+	cancel_metadata(data);
+	metadata_clear(&data->metadata);
+	set_frame_index(&data->frame_index, NULL);
+	if (data->timeout_source)
+	{
+		g_source_destroy(data->timeout_source);
+		data->timeout_source = NULL;
+	}
+	data->target_state = GST_STATE_NULL;
+	update_filling(data);
+	release_pipeline(data);
+	return FALSE;
+}
+
+/*
+ * Core API
+ */
+
+void set_notifyfunction(CustomData *data)
+{
+	if (data->notify_time > 0)
+	{
+		if (data->timeout_source)
+		{
+			g_source_destroy(data->timeout_source);
+		}
+		/* Register a function that GLib will call 4 times per second */
+		data->timeout_source = g_timeout_source_new(data->notify_time);
+		g_source_set_callback(data->timeout_source, (GSourceFunc) gst_notify_time_cb, data, NULL);
+		g_source_attach(data->timeout_source, data->context);
+		g_source_unref(data->timeout_source);
+	}
+}
+
+/* Create the internal data structure of a player, its pipeline is built on the shared thread */
+GPlayerCore *gplayer_core_new(const GPlayerCallbacks *callbacks, gpointer user_data)
+{
+	CustomData *data = g_new0(CustomData, 1);
+	int i;
+
+	data->last_seek_time = GST_CLOCK_TIME_NONE;
+	data->seek_issued = GST_CLOCK_TIME_NONE;
+	data->track_gap_start = GST_CLOCK_TIME_NONE;
+	data->rebuffer_start = GST_CLOCK_TIME_NONE;
+	data->last_source_bytes = GST_CLOCK_TIME_NONE;
+	snapshot_set(data, GPLAYER_SNAPSHOT_SEEK_LATENCY, -1);
+	snapshot_set(data, GPLAYER_SNAPSHOT_TRACK_GAP, -1);
+	snapshot_set(data, GPLAYER_SNAPSHOT_LAST_STALL_POSITION, -1);
+	snapshot_set(data, GPLAYER_SNAPSHOT_LAST_STALL_DURATION, -1);
+	snapshot_set(data, GPLAYER_SNAPSHOT_LAST_STALL_CAUSE, -1);
+	data->compressed_buffer_size = COMPRESSED_BUFFER_SIZE;
+	data->volume_left = data->volume_right = 1.0f;
+	g_mutex_init(&data->pipeline_lock);
+	bandwidth_init(&data->bandwidth);
+	for (i = 0; i < GPLAYER_STARTUP_PHASES; i++)
+	{
+		data->startup[i] = GST_CLOCK_TIME_NONE;
+		snapshot_set(data, GPLAYER_SNAPSHOT_STARTUP_TIMES + i, -1);
+	}
+	if (callbacks)
+		data->callbacks = *callbacks;
+	data->user_data = user_data;
+	GPlayerDEBUG("Created CustomData at %p", data);
+	init_elements();
+	add_player(data);
+	/* Requests made right away queue behind it on the shared context */
+	g_main_context_invoke(data->context, (GSourceFunc) init_player, data);
+	return data;
+}
+
+/* Release the pipeline of this player, the shared thread goes away with the last player */
+void gplayer_core_free(GPlayerCore *data)
+{
+	if (!data)
+		return;
+	GPlayerDEBUG("Releasing pipeline...");
+	run_on_main_loop((GSourceFunc) release_player, data);
+	remove_player(data);
+	GPlayerDEBUG("Freeing CustomData at %p", data);
+	g_mutex_clear(&data->pipeline_lock);
+	bandwidth_clear(&data->bandwidth);
+	tag_timeline_clear(&data->stream_counters[0].tags);
+	tag_timeline_clear(&data->stream_counters[1].tags);
+	if (data->pcm_tap)
+		pcm_tap_free(data->pcm_tap);
+	g_free(data);
+}
+
+gpointer gplayer_core_get_user_data(GPlayerCore *data)
+{
+	return data ? data->user_data : NULL;
+}
+
+typedef struct _UriRequest
+{
+	CustomData *data;
+	gchar *uri;
+	gboolean seek;
+	/* When the application asked, the start of the startup times */
+	GstClockTime time;
+} UriRequest;
+
+static UriRequest *uri_request_new(CustomData *data, const gchar *uri, gboolean seek)
+{
+	UriRequest *request = g_new(UriRequest, 1);
+
+	request->data = data;
+	request->uri = g_strdup(uri);
+	request->seek = seek;
+	request->time = gst_util_get_timestamp();
+	return request;
+}
+
+static void uri_request_free(UriRequest *request)
+{
+	g_free(request->uri);
+	g_free(request);
+}
+
+static gboolean set_uri_cb(UriRequest *request)
+{
+	CustomData *data = request->data;
+	const gchar *uri = request->uri;
+	gchar *cached;
+
+	prepare_pipeline(data);
+	start_startup(data, request->time);
+	if (!data->pipeline)
+		return FALSE;
+	GPlayerDEBUG("Setting URI to %s", uri);
+	if (data->target_state >= GST_STATE_READY)
+		gst_element_set_state(data->pipeline, GST_STATE_READY);
+	cached = lookup_cache(uri, &data->frame_index);
+	data->from_cache = cached != NULL;
+	if (!cached)
+		cached = prefetch_claim(uri);
+	configure_source(data, data->source);
+	g_object_set(data->source, "uri", cached ? cached : uri, NULL);
+	g_free(cached);
+	mark_startup(data, GPLAYER_STARTUP_PIPELINE_READY);
+	data->duration = GST_CLOCK_TIME_NONE;
+	data->allow_seek = request->seek;
+	data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
+	gplayer_prepare_complete(data);
+	set_notifyfunction(data);
+	return FALSE;
+}
+
+/* Set the track to play. Handed to the shared thread, so the pipeline is built by then. */
+void gplayer_core_set_uri(GPlayerCore *data, const gchar *uri, gboolean seek)
+{
+	if (!data)
+		return;
+	g_main_context_invoke_full(data->context, G_PRIORITY_DEFAULT, (GSourceFunc) set_uri_cb,
+			uri_request_new(data, uri, seek), (GDestroyNotify) uri_request_free);
+}
+
+static gboolean set_next_uri_cb(UriRequest *request)
+{
+	if (request->data->pipeline)
+		set_next_source(request->data, request->uri, request->seek);
+	return FALSE;
+}
+
+/* Pre-roll the next track, it replaces the current one at EOS. Handed to the shared thread, which owns the
+ * next pipeline. */
+void gplayer_core_set_next_uri(GPlayerCore *data, const gchar *uri, gboolean seek)
+{
+	if (!data)
+		return;
+	GPlayerDEBUG("Setting next URI to %s", uri);
+	g_main_context_invoke_full(data->context, G_PRIORITY_DEFAULT, (GSourceFunc) set_next_uri_cb,
+			uri_request_new(data, uri, seek), (GDestroyNotify) uri_request_free);
+}
+
+static gboolean play_cb(CustomData *data)
+{
+	if (!data->pipeline)
+		return FALSE;
+	data->target_state = GST_STATE_PLAYING;
+	data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
+	/* Already PAUSED posts no state change, decide on the current level */
+	request_decision(data);
+	return FALSE;
+}
+
+/* Set pipeline to PLAYING state, the worker starts playback once enough data is buffered */
+void gplayer_core_play(GPlayerCore *data)
+{
+	if (!data)
+		return;
+	GPlayerDEBUG("Requesting state to PLAYING");
+	g_main_context_invoke(data->context, (GSourceFunc) play_cb, data);
+}
+
+static gboolean pause_cb(CustomData *data)
+{
+	if (!data->pipeline)
+		return FALSE;
+	data->target_state = GST_STATE_PAUSED;
+	data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
+	update_filling(data);
+	return FALSE;
+}
+
+/* Set pipeline to PAUSED state, in order with the other requests */
+void gplayer_core_pause(GPlayerCore *data)
+{
+	if (!data)
+		return;
+	GPlayerDEBUG("Setting state to PAUSED");
+	g_main_context_invoke(data->context, (GSourceFunc) pause_cb, data);
+}
+
+typedef struct _SeekRequest
+{
+	CustomData *data;
+	gint64 position;
+} SeekRequest;
+
+static gboolean seek_request_cb(SeekRequest *request)
+{
+	CustomData *data = request->data;
+
+	/* Checked here, a preceding set_uri may still be queued */
+	if (!data->allow_seek)
+		return FALSE;
+	data->seek_requests++;
+	data->desired_position = request->position;
+	if (data->state >= GST_STATE_PAUSED)
+	{
+		schedule_seek(data);
+	}
+	else
+	{
+		GPlayerDEBUG("Scheduling seek to %" GST_TIME_FORMAT " for later", GST_TIME_ARGS(request->position));
+	}
+	return FALSE;
+}
+
+/* Instruct the pipeline to seek to a different position. Requests are handed to the shared thread,
+ * which coalesces the bursts of a scrub gesture into few seeks. */
+void gplayer_core_seek(GPlayerCore *data, gint milliseconds)
+{
+	SeekRequest *request;
+
+	if (!data || milliseconds == 0)
+		return;
+	request = g_new(SeekRequest, 1);
+	request->data = data;
+	request->position = (gint64) (milliseconds * GST_MSECOND);
+	g_main_context_invoke_full(data->context, G_PRIORITY_DEFAULT, (GSourceFunc) seek_request_cb, request, g_free);
+}
+
+gint gplayer_core_get_position(GPlayerCore *data)
+{
+	GstElement *pipeline;
+	gint64 position;
+
+	/* We do not want to update anything unless we have a working pipeline in the PAUSED or PLAYING state */
+	if (!data || data->state < GST_STATE_PAUSED || !(pipeline = ref_element(data, &data->pipeline)))
+		return 0;
+
+	if (!gst_element_query_position(pipeline, GST_FORMAT_TIME, &position))
+	{
+		position = 0;
+	}
+	gst_object_unref(pipeline);
+
+	return (gint) (position / GST_MSECOND);
+}
+
+gint gplayer_core_get_duration(GPlayerCore *data)
+{
+	GstElement *pipeline;
+	gint64 duration;
+
+	/* We do not want to update anything unless we have a working pipeline in the PAUSED or PLAYING state */
+	if (!data || data->state < GST_STATE_PAUSED || !(pipeline = ref_element(data, &data->pipeline)))
+		return 0;
+
+	if (!gst_element_query_duration(pipeline, GST_FORMAT_TIME, &duration))
+	{
+		duration = 0;
+	}
+	gst_object_unref(pipeline);
+
+	return (gint) (duration / GST_MSECOND);
+}
+
+gboolean gplayer_core_is_playing(GPlayerCore *data)
+{
+	return data && data->state == GST_STATE_PLAYING;
+}
+
+/* The setters below are handed to the shared thread like the other requests, it owns the pipeline */
+typedef struct _ValueRequest
+{
+	CustomData *data;
+	gint value;
+	gfloat left;
+	gfloat right;
+} ValueRequest;
+
+static void invoke_request(CustomData *data, GSourceFunc func, gint value, gfloat left, gfloat right)
+{
+	ValueRequest *request = g_new(ValueRequest, 1);
+
+	request->data = data;
+	request->value = value;
+	request->left = left;
+	request->right = right;
+	g_main_context_invoke_full(data->context, G_PRIORITY_DEFAULT, func, request, g_free);
+}
+
+static gboolean set_volume_cb(ValueRequest *request)
+{
+	CustomData *data = request->data;
+
+	data->volume_left = request->left;
+	data->volume_right = request->right;
+	if (data->pipeline)
+		g_object_set(data->volume, "left", (gdouble) data->volume_left, "right", (gdouble) data->volume_right, NULL);
+	return FALSE;
+}
+
+void gplayer_core_set_volume(GPlayerCore *data, gfloat left, gfloat right)
+{
+	if (!data)
+		return;
+	GPlayerDEBUG("Set volume to %f, %f", left, right);
+	invoke_request(data, (GSourceFunc) set_volume_cb, 0, CLAMP(left, 0.0f, GAIN_MAX), CLAMP(right, 0.0f, GAIN_MAX));
+}
+
+static gboolean set_buffer_size_cb(ValueRequest *request)
+{
+	if (request->data->pipeline)
+		buffer_size(request->data, request->value);
+	return FALSE;
+}
+
+void gplayer_core_set_buffer_size(GPlayerCore *data, gint size)
+{
+	if (!data)
+		return;
+	invoke_request(data, (GSourceFunc) set_buffer_size_cb, size, 0, 0);
+}
+
+static gboolean set_compressed_buffering_cb(ValueRequest *request)
+{
+	request->data->compressed_buffering = request->value;
+	return FALSE;
+}
+
+/* Buffer compressed data before decoding from the next uri on, the buffer size is then in bytes of the stream */
+void gplayer_core_set_compressed_buffering(GPlayerCore *data, gboolean enable)
+{
+	if (!data)
+		return;
+	invoke_request(data, (GSourceFunc) set_compressed_buffering_cb, enable, 0, 0);
+}
+
+gpointer gplayer_core_enable_pcm_tap(GPlayerCore *data, gsize capacity, gsize *size)
+{
+	if (!data)
+		return NULL;
+	if (!data->pcm_tap)
+		data->pcm_tap = pcm_tap_new(capacity > 0 ? capacity : PCM_TAP_DEFAULT_CAPACITY);
+	g_atomic_int_set(&data->pcm_tap_enabled, TRUE);
+	return pcm_tap_get_memory(data->pcm_tap, size);
+}
+
+void gplayer_core_disable_pcm_tap(GPlayerCore *data)
+{
+	if (data)
+		g_atomic_int_set(&data->pcm_tap_enabled, FALSE);
+}
+
+static gboolean set_network_cb(ValueRequest *request)
+{
+	CustomData *data = request->data;
+
+	data->fast_network = request->value;
+	if (data->pipeline)
+		request_decision(data);
+	return FALSE;
+}
+
+void gplayer_core_set_network(GPlayerCore *data, gboolean fast)
+{
+	if (!data)
+		return;
+	invoke_request(data, (GSourceFunc) set_network_cb, fast, 0, 0);
+}
+
+static gboolean set_notify_time_cb(ValueRequest *request)
+{
+	request->data->notify_time = request->value;
+	set_notifyfunction(request->data);
+	return FALSE;
+}
+
+void gplayer_core_set_notify_time(GPlayerCore *data, gint time)
+{
+	if (!data)
+		return;
+	invoke_request(data, (GSourceFunc) set_notify_time_cb, time, 0, 0);
+}
+
+/* As noted by the probes of the current pipeline, the gain element only works on other than unity gains */
+static guint get_conversions(CustomData *data, StreamCounters *counters)
+{
+	guint conversions = counters ? g_atomic_int_get(&counters->conversions) : 0;
+
+	if (data->volume_left != 1.0f || data->volume_right != 1.0f)
+		conversions |= GPLAYER_CONVERSION_GAIN;
+	return conversions;
+}
+
+void gplayer_core_get_stats(GPlayerCore *data, GPlayerStats *stats)
+{
+	GstElement *source, *queue;
+	int i;
+
+	memset(stats, 0, sizeof(GPlayerStats));
+	for (i = 0; i < GPLAYER_STARTUP_PHASES; i++)
+		stats->startup_times[i] = -1;
+	if (!data)
+		return;
+	for (i = 0; i < GPLAYER_STARTUP_PHASES; i++)
+		stats->startup_times[i] = snapshot_get(data, GPLAYER_SNAPSHOT_STARTUP_TIMES + i);
+	stats->state = data->state;
+	stats->target_state = data->target_state;
+	stats->position = data->position;
+	stats->duration = data->duration;
+	stats->buffering_level = data->buffering_level;
+	stats->fast_network = data->fast_network;
+	stats->worker_wakeups = data->worker_wakeups;
+	stats->from_cache = data->from_cache;
+	stats->seek_requests = data->seek_requests;
+	stats->seeks = snapshot_get(data, GPLAYER_SNAPSHOT_SEEKS);
+	stats->indexed_seeks = data->indexed_seeks;
+	stats->seek_latency = snapshot_get(data, GPLAYER_SNAPSHOT_SEEK_LATENCY);
+	stats->network_bitrate = bandwidth_get(&data->bandwidth, &stats->network_confidence) * 8;
+	/* The queue of the compressed data is inside uridecodebin */
+	queue = ref_element(data, data->compressed_buffering ? &data->source : &data->buffer);
+	if (queue && data->compressed_buffering)
+	{
+		source = queue;
+		queue = get_compressed_queue(source);
+		gst_object_unref(source);
+	}
+	if (queue)
+	{
+		g_object_get(queue, "current-level-bytes", &stats->queue_level_bytes, "max-size-bytes", &stats->queue_max_bytes, NULL);
+		gst_object_unref(queue);
+	}
+	stats->conversions = get_conversions(data, __atomic_load_n(&data->counters, __ATOMIC_ACQUIRE));
+}
+
+void gplayer_core_get_snapshot(GPlayerCore *data, gint64 *values, gint size)
+{
+	StreamCounters *counters;
+	int i;
+
+	if (!data)
+	{
+		memset(values, 0, sizeof(gint64) * size);
+		return;
+	}
+	for (i = 0; i < MIN(size, GPLAYER_SNAPSHOT_SIZE); i++)
+		values[i] = snapshot_get(data, i);
+
+	/* The counters of a pipeline live as long as the player */
+	counters = __atomic_load_n(&data->counters, __ATOMIC_ACQUIRE);
+	if (counters && size > GPLAYER_SNAPSHOT_QUEUE_TIME)
+	{
+		values[GPLAYER_SNAPSHOT_QUEUE_BYTES] = MAX(__atomic_load_n(&counters->queue_bytes, __ATOMIC_RELAXED), 0);
+		values[GPLAYER_SNAPSHOT_QUEUE_TIME] = MAX(__atomic_load_n(&counters->queue_time, __ATOMIC_RELAXED), 0);
+	}
+	if (size > GPLAYER_SNAPSHOT_CONVERSIONS)
+		values[GPLAYER_SNAPSHOT_CONVERSIONS] = get_conversions(data, counters);
+	if (size > GPLAYER_SNAPSHOT_REBUFFER_RATIO && values[GPLAYER_SNAPSHOT_PLAYED_TIME] + values[GPLAYER_SNAPSHOT_STALL_TIME] > 0)
+		values[GPLAYER_SNAPSHOT_REBUFFER_RATIO] = values[GPLAYER_SNAPSHOT_STALL_TIME] * 1000000
+				/ (values[GPLAYER_SNAPSHOT_PLAYED_TIME] + values[GPLAYER_SNAPSHOT_STALL_TIME]);
+}
+
+void gplayer_core_get_startup_histogram(GPlayerCore *data, guint *counts)
+{
+	int i, j;
+
+	memset(counts, 0, sizeof(guint) * GPLAYER_STARTUP_PHASES * GPLAYER_STARTUP_BUCKETS);
+	if (!data)
+		return;
+	for (i = 0; i < GPLAYER_STARTUP_PHASES; i++)
+		for (j = 0; j < GPLAYER_STARTUP_BUCKETS; j++)
+			counts[i * GPLAYER_STARTUP_BUCKETS + j] = g_atomic_int_get((gint *) &data->startup_histogram[i][j]);
+}
+
+void gplayer_core_get_stall_histogram(GPlayerCore *data, guint *counts)
+{
+	int i, j;
+
+	for (i = 0; i < GPLAYER_STALL_CAUSES; i++)
+	{
+		for (j = 0; j < GPLAYER_STALL_BUCKETS; j++)
+			counts[i * GPLAYER_STALL_BUCKETS + j] = data ? g_atomic_int_get((gint *) &data->stall_histogram[i][j]) : 0;
+	}
+}
+
+/* Download the start of a uri likely to be played next, in the background */
+void gplayer_core_prefetch(const gchar *uri, gint amount, gboolean seconds)
+{
+	if (!uri || amount <= 0)
+		return;
+	init_elements();
+	prefetch_add(uri, seconds ? (gsize) amount * DEFAULT_BITRATE / 8 : (gsize) amount);
+}
+
+void gplayer_core_get_prefetch_stats(guint64 *requests, guint64 *hits, guint64 *wasted_bytes)
+{
+	init_elements();
+	prefetch_get_stats(requests, hits, wasted_bytes);
+}
+
+void gplayer_core_get_http_stats(GPlayerHttpStats *stats)
+{
+	http_get_stats(stats);
+}
+
+void gplayer_core_set_cache_size(guint64 max_size)
+{
+	cache_configure(max_size);
+}
+
+void gplayer_core_enable_logging(gboolean enable)
+{
+	enable_logs = enable;
+}
+
+gboolean gplayer_core_dump_trace(const gchar *path)
+{
+	return trace_dump(path);
 }
@@ -0,0 +1,121 @@
+/*
+ * http.c
+ *
+ *  The shared HTTP session of the engine and the statistics of its requests.
+ */
+
+#include <gst/gst.h>
+#include "include/customdata.h"
+#include "include/http.h"
+
+typedef struct _RequestTiming
+{
+	gint64 resolving;
+	gint64 connecting;
+	gint64 handshaking;
+	gint64 resolve_time;
+	gint64 connect_time;
+	gint64 handshake_time;
+	gboolean connected;
+	gboolean handshaked;
+} RequestTiming;
+
+static GMutex http_lock;
+static SoupSession *session;
+static GPlayerHttpStats http_stats;
+
+static void network_event_cb(SoupMessage *msg, GSocketClientEvent event, GIOStream *connection, RequestTiming *timing)
+{
+	gint64 now = g_get_monotonic_time();
+
+	switch (event)
+	{
+	case G_SOCKET_CLIENT_RESOLVING:
+		timing->resolving = now;
+		break;
+	case G_SOCKET_CLIENT_RESOLVED:
+		timing->resolve_time = now - timing->resolving;
+		break;
+	case G_SOCKET_CLIENT_CONNECTING:
+		timing->connecting = now;
+		break;
+	case G_SOCKET_CLIENT_CONNECTED:
+		timing->connect_time = now - timing->connecting;
+		timing->connected = TRUE;
+		break;
+	case G_SOCKET_CLIENT_TLS_HANDSHAKING:
+		timing->handshaking = now;
+		break;
+	case G_SOCKET_CLIENT_TLS_HANDSHAKED:
+		timing->handshake_time = now - timing->handshaking;
+		timing->handshaked = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void request_queued_cb(SoupSession *session, SoupMessage *msg, gpointer userdata)
+{
+	RequestTiming *timing = g_new0(RequestTiming, 1);
+
+	g_object_set_data_full(G_OBJECT(msg), "gplayer-timing", timing, g_free);
+	g_signal_connect(msg, "network-event", G_CALLBACK(network_event_cb), timing);
+}
+
+/* A request without network events went over a connection kept alive */
+static void request_unqueued_cb(SoupSession *session, SoupMessage *msg, gpointer userdata)
+{
+	RequestTiming *timing = g_object_get_data(G_OBJECT(msg), "gplayer-timing");
+	gboolean playback = g_object_get_data(G_OBJECT(msg), "gplayer-playback") != NULL;
+
+	if (!timing)
+		return;
+
+	GPlayerDEBUG("http %s %s: %s, resolve %lld us, connect %lld us, tls handshake %lld us", msg->method, soup_message_get_uri(msg)->host,
+			timing->connected ? "new connection" : "reused connection", (long long) timing->resolve_time, (long long) timing->connect_time,
+			(long long) timing->handshake_time);
+
+	g_mutex_lock(&http_lock);
+	http_stats.requests++;
+	if (playback)
+		http_stats.playback_requests++;
+	if (timing->connected)
+	{
+		http_stats.connections++;
+		http_stats.resolve_time += timing->resolve_time;
+		http_stats.connect_time += timing->connect_time;
+	}
+	if (timing->handshaked)
+	{
+		http_stats.tls_handshakes++;
+		http_stats.handshake_time += timing->handshake_time;
+	}
+	g_mutex_unlock(&http_lock);
+}
+
+SoupSession *http_get_session(void)
+{
+	g_mutex_lock(&http_lock);
+	if (!session)
+	{
+		session = soup_session_new_with_options(SOUP_SESSION_MAX_CONNS_PER_HOST, HTTP_MAX_CONNS_PER_HOST, SOUP_SESSION_IDLE_TIMEOUT,
+				HTTP_IDLE_TIMEOUT, SOUP_SESSION_TIMEOUT, HTTP_TIMEOUT, SOUP_SESSION_SSL_USE_SYSTEM_CA_FILE, TRUE, NULL);
+		g_signal_connect(session, "request-queued", G_CALLBACK(request_queued_cb), NULL);
+		g_signal_connect(session, "request-unqueued", G_CALLBACK(request_unqueued_cb), NULL);
+	}
+	g_mutex_unlock(&http_lock);
+	return session;
+}
+
+void http_mark_playback(SoupMessage *msg)
+{
+	g_object_set_data(G_OBJECT(msg), "gplayer-playback", GINT_TO_POINTER(TRUE));
+}
+
+void http_get_stats(GPlayerHttpStats *stats)
+{
+	g_mutex_lock(&http_lock);
+	*stats = http_stats;
+	g_mutex_unlock(&http_lock);
+}
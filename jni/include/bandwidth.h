@@ -0,0 +1,32 @@
+/*
+ * bandwidth.h
+ *
+ *  Network throughput estimate used for the buffering decisions of the player.
+ */
+
+/* Network throughput measured on the src pad of the element reading the uri. Only the time between
+ * buffers arriving back to back is counted. The time after a buffer pushed into a queue above its high
+ * watermark is the source waiting for space, it is left out too so a blocked source does not look slow. */
+typedef struct _BandwidthEstimator
+{
+	GMutex lock;
+	GstClockTime last_arrival;
+	gboolean last_blocked;
+	guint64 window_bytes;
+	GstClockTime window_time;
+	/* Bytes per second, with its exponentially weighted variance */
+	gdouble estimate;
+	gdouble variance;
+	/* Active download time folded into the estimate */
+	GstClockTime observed;
+	guint64 total_bytes;
+} BandwidthEstimator;
+
+void bandwidth_init(BandwidthEstimator *bw);
+void bandwidth_clear(BandwidthEstimator *bw);
+/* The next buffer starts a new transfer, do not count the time before it */
+void bandwidth_restart(BandwidthEstimator *bw);
+/* Bytes that arrived at now, blocking when their push may wait for space downstream */
+void bandwidth_add(BandwidthEstimator *bw, gsize bytes, GstClockTime now, gboolean blocking);
+/* Bytes per second, 0 while unknown. The confidence goes from 0 to 1000 with the observed time and stability */
+gint64 bandwidth_get(BandwidthEstimator *bw, gint *confidence);
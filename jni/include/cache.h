@@ -0,0 +1,31 @@
+/*
+ * cache.h
+ *
+ *  Disk cache of progressive downloads and the gplayercachesrc element that plays its copies.
+ */
+
+/* Progressive downloads are kept under $XDG_CACHE_HOME/gplayer, keyed by the uri and validated with
+ * the ETag or Last-Modified of the response. The least recently played entries go first. */
+#define CACHE_DEFAULT_SIZE (100 * 1024 * 1024)
+/* Prefixed to the file:// uri of a cached copy it is played in push mode, see cache_src_query */
+#define CACHE_SCHEME_PREFIX "gplayer+"
+
+typedef struct _CacheWriter CacheWriter;
+
+/* Registers the source element */
+void cache_init(void);
+/* A max_size of 0 disables the cache */
+void cache_configure(guint64 max_size);
+/* A file:// uri of a cached copy, or NULL. Never waits for the network: a copy due for validation is served
+ * and validated in the background, one the server changed is dropped at the next lookup. */
+gchar *cache_lookup(const gchar *uri);
+/* The frame index kept with the cached copy of uri, NULL for streams without one and while it is being
+ * built in the background */
+FrameIndex *cache_get_index(const gchar *uri);
+/* Records what the source reading uri delivers, NULL if it is not cacheable */
+CacheWriter *cache_writer_new(const gchar *uri);
+void cache_writer_free(CacheWriter *writer);
+/* Index of the bytes recorded so far, owned by the writer */
+FrameIndex *cache_writer_get_index(CacheWriter *writer);
+/* Probe for buffers, buffer lists and downstream events on the src pad of the source */
+GstPadProbeReturn cache_writer_probe(GstPad *pad, GstPadProbeInfo *info, CacheWriter *writer);
@@ -5,23 +5,66 @@
  *      Author: Krzysztof Gawrys
  */
 
+#ifdef __ANDROID__
 #include <android/log.h>
+#else
+#include <stdio.h>
+#endif
 #include <gst/audio/audio.h>
 
+#include "gplayer_core.h"
+#include "bandwidth.h"
+#include "frameindex.h"
+#include "pcmtap.h"
+#include "metadata.h"
+#include "trace.h"
+
 GST_DEBUG_CATEGORY_STATIC( debug_category);
 #define GST_CAT_DEFAULT debug_category
 
-#if GLIB_SIZEOF_VOID_P == 8
-# define GET_CUSTOM_DATA(env, thiz, fieldID) (CustomData *)(*env)->GetLongField (env, thiz, fieldID)
-# define SET_CUSTOM_DATA(env, thiz, fieldID, data) (*env)->SetLongField (env, thiz, fieldID, (jlong)data)
-#else
-# define GET_CUSTOM_DATA(env, thiz, fieldID) (CustomData *)(jint)(*env)->GetLongField (env, thiz, fieldID)
-# define SET_CUSTOM_DATA(env, thiz, fieldID, data) (*env)->SetLongField (env, thiz, fieldID, (jlong)(jint)data)
-#endif
+/* Kept by the streaming threads of one pipeline, read atomically by any thread */
+typedef struct _StreamCounters
+{
+	/* Audio in the queue named buffer, in bytes and microseconds */
+	gint64 queue_bytes;
+	gint64 queue_time;
+	/* GPlayerConversion flags of the caps reaching the gain element */
+	gint conversions;
+	/* The thread feeding the queue and its CPU time at its last buffer, in microseconds */
+	gpointer decode_thread;
+	gint64 decode_cpu;
+	/* Where the CPU time of the feeding threads is added up, a snapshot slot of the player */
+	gint64 *decode_cpu_total;
+	/* Segment of the audio reaching the sink and where in the track it is, in microseconds */
+	GstSegment sink_segment;
+	gint64 sink_position;
+	/* An underrun in progress: how late the latest audio came, where and why it started */
+	GstClockTimeDiff underrun_lateness;
+	gint64 underrun_position;
+	GPlayerStallCause underrun_cause;
+	/* The network source: the byte after the last one it delivered, whether it failed and waits for a reconnect,
+	 * reconnects since it last delivered and when it failed */
+	guint64 source_offset;
+	gint source_failed;
+	gint source_retries;
+	GstClockTime source_failure;
+	/* Tag changes waiting for their audio to play, the running time at the end of the last audio that reached
+	 * the sink, the running time up to which the main loop should take them and whether it was asked to */
+	TagTimeline tags;
+	GstClockTime sink_running_end;
+	GstClockTime tags_due;
+	gint tags_pending;
+	/* When the audio before the EOS finishes playing, on the monotonic clock */
+	GstClockTime audio_end;
+	struct _CustomData *owner;
+} StreamCounters;
 
 typedef struct _CustomData
 {
-	jobject app;
+	GPlayerCallbacks callbacks;
+	gpointer user_data;
+	/* The shared thread replaces pipeline and its elements under it, other threads take references under it */
+	GMutex pipeline_lock;
 	GstElement *pipeline;
 	GstElement *resample;
 	GstPad *pad;
@@ -33,30 +76,83 @@ typedef struct _CustomData
 	gint64 position;
 	gint64 desired_position;
 	GstClockTime last_seek_time;
+	/* The end of the previous track during a switch to the next one, until the new sink plays */
+	GstClockTime track_gap_start;
+	GSource *seek_source;
+	/* The first request the scheduled seek is waiting on */
+	GstClockTime seek_burst_start;
+	GSource *retry_source;
+	GstClockTime seek_issued;
+	gboolean seek_flushed;
+	guint64 seek_requests;
+	FrameIndex *frame_index;
+	FrameIndex *next_frame_index;
+	IndexedSeek indexed_seek;
+	guint64 indexed_seeks;
+	PcmTap *pcm_tap;
+	gint pcm_tap_enabled;
 	gboolean is_live;
 	GstState target_state;
 	GSource *timeout_source;
+	/* Of the current stream, delivered from metadata_source */
+	Metadata metadata;
+	GSource *metadata_source;
 	gint buffering_level;
 	GstElement *source;
 	GstElement *convert;
 	GstElement *typefinder;
 	GstElement *buffer;
 	GstElement *volume;
+	/* Applied to every pipeline by the gain element named volume */
+	gfloat volume_left;
+	gfloat volume_right;
 	GstElement *sink;
 	gboolean allow_seek;
 	int notify_time;
-	GSource *timeout_worker;
-	gint deltas[5];
-	guint delta_index;
-	gint last_buffer_load;
 	guint bitrate;
-	guint64 buffering_time;
-	jboolean fast_network;
+	GstClockTime buffering_start;
+	gboolean fast_network;
 	GstAudioInfo audio_info;
+	GSource *bus_source;
+	GstElement *next_pipeline;
+	GSource *next_bus_source;
+	gboolean next_allow_seek;
+	GstAudioInfo next_audio_info;
+	gboolean rebuild_pipeline;
+	gint buffer_is_slow;
+	gboolean network_slow;
+	gboolean compressed_buffering;
+	gint compressed_buffer_size;
+	gboolean from_cache;
+	gboolean next_from_cache;
+	guint next_bitrate;
+	BandwidthEstimator bandwidth;
+	GstClockTime last_speed_check;
+	GstClockTime starve_start;
+	/* Set by the streaming thread of the queue input */
+	gboolean input_eos;
+	/* Counted in the players the prefetch waits for */
+	gboolean filling;
+	gboolean worker_pending;
+	guint64 worker_wakeups;
+	GstClockTime startup[GPLAYER_STARTUP_PHASES];
+	guint startup_histogram[GPLAYER_STARTUP_PHASES][GPLAYER_STARTUP_BUCKETS];
+	/* A pause to refill the buffer while we should be playing, see state_changed_cb */
+	GstClockTime rebuffer_start;
+	gint64 rebuffer_position;
+	GPlayerStallCause rebuffer_cause;
+	GstClockTime last_source_bytes;
+	guint stall_histogram[GPLAYER_STALL_CAUSES][GPLAYER_STALL_BUCKETS];
+	/* One for the current pipeline, one for the next, see create_pipeline */
+	StreamCounters stream_counters[2];
+	StreamCounters *counters;
+	/* Written with atomic stores by the thread owning a slot, see gplayer_core_get_snapshot */
+	gint64 snapshot[GPLAYER_SNAPSHOT_SIZE];
 } CustomData;
 
-extern jboolean enable_logs;
+extern gboolean enable_logs;
 
+/* Formatted text for rare events while logging is enabled, what happens on every tick goes to the trace */
 static inline void GPlayerDEBUG(const char *format, ...)
 {
 	if (!enable_logs)
@@ -64,6 +160,12 @@ static inline void GPlayerDEBUG(const char *format, ...)
 	va_list varargs;
 
 	va_start(varargs, format);
+#ifdef __ANDROID__
 	__android_log_vprint(ANDROID_LOG_INFO, "gplayer", format, varargs);
+#else
+	fputs("gplayer: ", stderr);
+	vfprintf(stderr, format, varargs);
+	fputc('\n', stderr);
+#endif
 	va_end(varargs);
 }
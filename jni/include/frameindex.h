@@ -0,0 +1,52 @@
+/*
+ * frameindex.h
+ *
+ *  Frame index of cached MP3 and ADTS downloads, for exact seeks with one range request.
+ */
+
+/* Byte offsets of MP3 and ADTS frames with their exact sample position, one entry per FRAME_INDEX_INTERVAL.
+ * The index is built from the bytes of a download as they arrive, kept next to the cached copy and lets a
+ * seek go to the right frame with a single byte range request, whatever the bitrate of the stream. */
+#define FRAME_INDEX_INTERVAL GST_SECOND
+/* Seeks start this far before their target at least, the first frames after a jump may decode badly */
+#define FRAME_INDEX_PREROLL (100 * GST_MSECOND)
+
+typedef struct _FrameIndex FrameIndex;
+
+FrameIndex *frame_index_new(void);
+FrameIndex *frame_index_ref(FrameIndex *index);
+void frame_index_unref(FrameIndex *index);
+/* Bytes of the stream from its start, anything not continuing the bytes seen so far is ignored */
+void frame_index_add(FrameIndex *index, guint64 offset, const guint8 *data, gsize size);
+/* The last stream offset of the data is known */
+void frame_index_finish(FrameIndex *index);
+/* A frame to start decoding from for position, with its exact time. Offsets count from the end of an
+ * ID3v2 tag, the way demuxers stripping the tag pass byte seeks. FALSE if the index does not reach position. */
+gboolean frame_index_lookup(FrameIndex *index, GstClockTime position, guint64 *offset, GstClockTime *time);
+gboolean frame_index_save(FrameIndex *index, const gchar *path);
+FrameIndex *frame_index_load(const gchar *path);
+/* Index a whole file, NULL if it is no MP3 or ADTS stream */
+FrameIndex *frame_index_scan_file(const gchar *path);
+
+/* A seek through the index. It sends a byte seek to the frame before the target, and gives the decoded
+ * audio the times of the index with a segment starting at the target, so the sink plays from the exact
+ * sample. The probe goes on a pad carrying the decoded audio. */
+typedef enum
+{
+	INDEXED_SEEK_NONE,
+	INDEXED_SEEK_ARMED,
+	INDEXED_SEEK_FLUSHED,
+	INDEXED_SEEK_ACTIVE
+} IndexedSeekState;
+
+typedef struct _IndexedSeek
+{
+	IndexedSeekState state;
+	GstPad *pad;
+	GstClockTime target;
+	GstClockTime frame_time;
+	GstClockTimeDiff pts_offset;
+} IndexedSeek;
+
+gboolean indexed_seek_start(IndexedSeek *seek, GstElement *pipeline, FrameIndex *index, GstClockTime position);
+GstPadProbeReturn indexed_seek_probe(GstPad *pad, GstPadProbeInfo *info, IndexedSeek *seek);
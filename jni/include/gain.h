@@ -0,0 +1,24 @@
+/*
+ * gain.h
+ *
+ *  Per-channel gain stage of the pipeline.
+ */
+
+/* Gains above 1 amplify up to this limit, S16 is scaled in Q13 fixed point */
+#define GAIN_MAX 3.99
+#define GAIN_FRAC_BITS 13
+/* Gain changes are spread over this long, so they do not click */
+#define GAIN_RAMP_TIME (20 * GST_MSECOND)
+
+/* Registers the gplayergain element. It applies a "left" and a "right" gain, mono streams get their
+ * average, in place on S16 and F32 audio and not at all while both are 1. */
+void gain_init(void);
+
+/* The NEON kernels in gain_neon.c. They do the leading whole vectors of count interleaved samples and
+ * return how many that was. armeabi-v7a builds only that file with NEON (GPLAYER_GAIN_NEON), gain_init
+ * checks that the CPU has it. */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(GPLAYER_GAIN_NEON)
+#define GAIN_NEON 1
+gsize gain_s16_neon(gint16 *samples, gsize count, gint left, gint right);
+gsize gain_f32_neon(gfloat *samples, gsize count, gfloat left, gfloat right);
+#endif
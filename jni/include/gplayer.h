@@ -11,43 +11,74 @@
 #include <gst/audio/audio.h>
 
 #include "customdata.h"
+#include "http.h"
+#include "cache.h"
+#include "gain.h"
+#include "prefetch.h"
 
-#include "java_callbacks.h"
 #include "gst_callbacks.h"
 
 #define MAX_BUFFER_SIZE 10000000
 
 #define WORKER_TIMEOUT 250
 #define BUFFER_TIME 15
-#define ERROR_BUFFERING 2
-#define BUFFER_SLOW 3
-#define BUFFER_FAST 4
-#define UNKNOWN_ERROR -1
-#define NOT_FOUND -2
-#define NOT_SUPPORTED -3
+
+/* Compressed buffering holds up to COMPRESSED_BUFFER_SIZE bytes, the memory of BUFFER_TIME seconds of
+ * 44.1 kHz stereo PCM, or COMPRESSED_BUFFER_TIME seconds. DEFAULT_BITRATE is assumed until the stream has one. */
+#define COMPRESSED_BUFFER_SIZE 2646000
+#define COMPRESSED_BUFFER_TIME 600
+#define DEFAULT_BITRATE 128000
 
 #define HUNDRED_PERCENT 100
 #define SECOND_IN_NANOS 1000000000
 #define BUFFERING_TIMEOUT WORKER_TIMEOUT * 10
+/* An empty queue for this long while we should be playing is reported as ERROR_BUFFERING */
+#define STARVING_TIMEOUT WORKER_TIMEOUT * 16
 
-static pthread_t gst_app_thread;
+/* The network is slow below NETWORK_SLOW_RATIO times the stream bitrate, and fast again above NETWORK_FAST_RATIO.
+ * Estimates below NETWORK_MIN_CONFIDENCE (of 1000) are not acted upon. */
+#define NETWORK_SLOW_RATIO 1.1
+#define NETWORK_FAST_RATIO 1.5
+#define NETWORK_MIN_CONFIDENCE 500
 
 /* Do not allow seeks to be performed closer than this distance. It is visually useless, and will probably
  * confuse some demuxers. */
 #define SEEK_MIN_DELAY (500 * GST_MSECOND)
+/* A seek is sent this long after the last request of a burst, to its position */
+#define SEEK_COALESCE_DELAY (50 * GST_MSECOND)
+
+/* Audio reaching the sink this much later than its running time left a gap, an underrun */
+#define UNDERRUN_THRESHOLD (50 * GST_MSECOND)
+/* A stall is blamed on the network when the source delivered nothing for this long */
+#define NETWORK_IDLE_TIME (500 * GST_MSECOND)
+
+/* A network source failing with a transient error is reconnected after RETRY_MIN_DELAY ms, doubling up to
+ * RETRY_MAX_DELAY, at most RETRY_MAX_ATTEMPTS times before it delivers again */
+#define RETRY_MIN_DELAY 250
+#define RETRY_MAX_DELAY 8000
+#define RETRY_MAX_ATTEMPTS 8
 
-/* These global variables cache values which are not changing during execution */
-extern jfieldID custom_data_field_id;
+/* Tags arriving within this time of a change are delivered with it, in milliseconds */
+#define METADATA_DELAY 100
+
+// callbacks into the application
+void gplayer_error(const gint message, CustomData *data);
+void gplayer_notify_time(CustomData *data, int time);
+void gplayer_playback_complete(CustomData *data);
+void gplayer_playback_running(CustomData *data);
+void gplayer_prepare_complete(CustomData *data);
+void gplayer_notify_init_complete(CustomData *data);
+void gplayer_metadata_update(CustomData *data);
+void gplayer_track_changed(CustomData *data);
 
 // internals
 void buffer_size(CustomData *data, int size);
 void build_pipeline(CustomData *data);
+void prepare_pipeline(CustomData *data);
 void check_initialization_complete(CustomData *data);
+void discard_next_pipeline(CustomData *data);
 void execute_seek(gint64 desired_position, CustomData *data);
+void mark_startup(CustomData *data, GPlayerStartupPhase phase);
 void print_one_tag(const GstTagList * list, const gchar * tag, CustomData *data);
-
-gint no_buffer_fill;
-gint buffer_is_slow;
-gint count_buffer_fill;
-gint64 last_position;
-gint64 counter;
+void set_notifyfunction(CustomData *data);
+void set_next_source(CustomData *data, const gchar *uri, gboolean seek);
@@ -0,0 +1,225 @@
+/*
+ * gplayer_core.h
+ *
+ *  Plain C API of the player engine. It does not depend on JNI, nativecalls.c and
+ *  java_callbacks.c adapt it to GPlayer.java, linux/ builds it against system GStreamer.
+ */
+
+#ifndef GPLAYER_CORE_H_
+#define GPLAYER_CORE_H_
+
+#include <gst/gst.h>
+
+typedef struct _CustomData GPlayerCore;
+
+/* Codes passed to the error callback, the positive ones only report the buffering state */
+#define ERROR_BUFFERING 2
+#define BUFFER_SLOW 3
+#define BUFFER_FAST 4
+#define UNKNOWN_ERROR -1
+#define NOT_FOUND -2
+#define NOT_SUPPORTED -3
+
+/* Events reported by the engine. They are called from the shared main loop thread,
+ * every member may be NULL. */
+/* The tags of the current stream, merged from everything it sent. Strings are NULL while unknown. The cover is
+ * the image in the stream, its front cover if it tells which one that is, and cover_type its MIME type. Valid
+ * during the metadata_update call, a reference on the cover keeps it. */
+typedef struct _GPlayerMetadata
+{
+	const gchar *title;
+	const gchar *artist;
+	const gchar *album;
+	guint bitrate;
+	GstBuffer *cover;
+	const gchar *cover_type;
+} GPlayerMetadata;
+
+typedef struct _GPlayerCallbacks
+{
+	void (*error)(gint code, gpointer user_data);
+	void (*notify_time)(gint time, gpointer user_data);
+	void (*playback_complete)(gpointer user_data);
+	void (*playback_running)(gpointer user_data);
+	void (*prepare_complete)(gpointer user_data);
+	void (*init_complete)(gpointer user_data);
+	/* Only when the metadata changed, once for a burst of tags, and when the audio it belongs to is heard */
+	void (*metadata_update)(const GPlayerMetadata *metadata, gpointer user_data);
+	void (*track_changed)(gpointer user_data);
+} GPlayerCallbacks;
+
+/* Startup phases of a track, timed from the set_uri call */
+typedef enum
+{
+	GPLAYER_STARTUP_SET_URI,
+	GPLAYER_STARTUP_PIPELINE_READY,
+	GPLAYER_STARTUP_FIRST_BYTE,
+	GPLAYER_STARTUP_TYPE_FOUND,
+	GPLAYER_STARTUP_FIRST_AUDIO,
+	GPLAYER_STARTUP_PLAYING,
+	GPLAYER_STARTUP_PHASES
+} GPlayerStartupPhase;
+
+/* Bucket i of the startup histogram counts phases reached within 50 * 2^i ms, the last one the rest */
+#define GPLAYER_STARTUP_BUCKETS 10
+
+/* Work done on the decoded audio of the current track */
+typedef enum
+{
+	GPLAYER_CONVERSION_FORMAT = 1 << 0,
+	GPLAYER_CONVERSION_RESAMPLE = 1 << 1,
+	GPLAYER_CONVERSION_GAIN = 1 << 2,
+	/* audioconvert and audioresample are left out of the chain, the sink takes the decoded format */
+	GPLAYER_CONVERSION_BYPASSED = 1 << 3
+} GPlayerConversion;
+
+/* Why audio stopped, see gplayer_core_get_stall_histogram */
+typedef enum
+{
+	/* The download fell behind the stream */
+	GPLAYER_STALL_NETWORK,
+	/* The data was there, decoding it fell behind */
+	GPLAYER_STALL_DECODE,
+	/* Waiting for the audio of a seek */
+	GPLAYER_STALL_SEEK,
+	GPLAYER_STALL_CAUSES
+} GPlayerStallCause;
+
+/* Bucket i of the stall histogram counts stalls shorter than 20 * 2^i ms, the last one the rest */
+#define GPLAYER_STALL_BUCKETS 10
+
+/* Slots of gplayer_core_get_snapshot. Times are in microseconds, rates in bits per second. */
+typedef enum
+{
+	GPLAYER_SNAPSHOT_STATE,
+	/* Decoded audio waiting in the queue before the sink */
+	GPLAYER_SNAPSHOT_QUEUE_BYTES,
+	GPLAYER_SNAPSHOT_QUEUE_TIME,
+	/* Network throughput and its confidence from 0 to 1000, and the bitrate of the stream */
+	GPLAYER_SNAPSHOT_BANDWIDTH,
+	GPLAYER_SNAPSHOT_BANDWIDTH_CONFIDENCE,
+	GPLAYER_SNAPSHOT_STREAM_BITRATE,
+	/* Audio played at the sink, times it ran dry while playing and times playback paused to refill. Stall time
+	 * adds up both kinds of stall, the rebuffer ratio is its share of the played and stalled time in parts per
+	 * million. Seeks are left out, they are in SEEK_LATENCY and the stall histogram. */
+	GPLAYER_SNAPSHOT_PLAYED_TIME,
+	GPLAYER_SNAPSHOT_UNDERRUNS,
+	GPLAYER_SNAPSHOT_REBUFFERS,
+	GPLAYER_SNAPSHOT_STALL_TIME,
+	GPLAYER_SNAPSHOT_REBUFFER_RATIO,
+	/* Position in the track, duration and GPlayerStallCause of the last stall, -1 before the first */
+	GPLAYER_SNAPSHOT_LAST_STALL_POSITION,
+	GPLAYER_SNAPSHOT_LAST_STALL_DURATION,
+	GPLAYER_SNAPSHOT_LAST_STALL_CAUSE,
+	/* Since the player was created */
+	GPLAYER_SNAPSHOT_BYTES_DOWNLOADED,
+	GPLAYER_SNAPSHOT_SEEKS,
+	/* From the last seek to its first audio at the sink, -1 while not reached */
+	GPLAYER_SNAPSHOT_SEEK_LATENCY,
+	/* CPU time of the threads reading, demuxing and decoding, since the player was created */
+	GPLAYER_SNAPSHOT_DECODE_CPU_TIME,
+	/* Reconnects of a network source after transient errors, the failures it recovered from and the time from
+	 * those failures to the first bytes after reconnecting */
+	GPLAYER_SNAPSHOT_RETRIES,
+	GPLAYER_SNAPSHOT_RECOVERIES,
+	GPLAYER_SNAPSHOT_RECOVERY_TIME,
+	/* GPlayerConversion flags */
+	GPLAYER_SNAPSHOT_CONVERSIONS,
+	/* Silence between the last audio of a track and the first of the next one at the last gapless switch, -1 before
+	 * any. The switch happens at the EOS of the pipeline, once its sink played everything. */
+	GPLAYER_SNAPSHOT_TRACK_GAP,
+	/* GPLAYER_STARTUP_PHASES slots, as startup_times of GPlayerStats */
+	GPLAYER_SNAPSHOT_STARTUP_TIMES,
+	GPLAYER_SNAPSHOT_SIZE = GPLAYER_SNAPSHOT_STARTUP_TIMES + GPLAYER_STARTUP_PHASES
+} GPlayerSnapshotSlot;
+
+typedef struct _GPlayerStats
+{
+	GstState state;
+	GstState target_state;
+	gint64 position;
+	gint64 duration;
+	gint buffering_level;
+	guint queue_level_bytes;
+	guint queue_max_bytes;
+	gboolean fast_network;
+	/* Times the worker timer had to run for this player, buffering decisions are otherwise event driven */
+	guint64 worker_wakeups;
+	/* The current track is played from the download cache */
+	gboolean from_cache;
+	/* Seeks asked for and sent to the pipeline, a burst of requests is sent as one seek */
+	guint64 seek_requests;
+	guint64 seeks;
+	/* Seeks served at the exact sample through the frame index of an MP3 or ADTS stream */
+	guint64 indexed_seeks;
+	/* Microseconds from the last seek sent to its first audio at the sink, -1 while not reached */
+	gint64 seek_latency;
+	/* Throughput measured at the network source in bits per second, with its confidence from 0 to 1000 */
+	gint64 network_bitrate;
+	gint network_confidence;
+	/* Microseconds from set_uri to each phase of the current track, -1 while not reached */
+	gint64 startup_times[GPLAYER_STARTUP_PHASES];
+	/* GPlayerConversion flags */
+	guint conversions;
+} GPlayerStats;
+
+/* Requests through the shared HTTP session of playback, the prefetch and the cache, times in microseconds
+ * summed over the new connections */
+typedef struct _GPlayerHttpStats
+{
+	guint64 requests;
+	/* The other requests reused a connection */
+	guint64 connections;
+	guint64 tls_handshakes;
+	guint64 resolve_time;
+	guint64 connect_time;
+	guint64 handshake_time;
+	/* Of the requests, those made playing tracks */
+	guint64 playback_requests;
+} GPlayerHttpStats;
+
+/* gst_init() has to be done by the caller */
+GPlayerCore *gplayer_core_new(const GPlayerCallbacks *callbacks, gpointer user_data);
+void gplayer_core_free(GPlayerCore *core);
+gpointer gplayer_core_get_user_data(GPlayerCore *core);
+
+void gplayer_core_set_uri(GPlayerCore *core, const gchar *uri, gboolean seek);
+void gplayer_core_set_next_uri(GPlayerCore *core, const gchar *uri, gboolean seek);
+void gplayer_core_play(GPlayerCore *core);
+void gplayer_core_pause(GPlayerCore *core);
+void gplayer_core_seek(GPlayerCore *core, gint milliseconds);
+gint gplayer_core_get_position(GPlayerCore *core);
+gint gplayer_core_get_duration(GPlayerCore *core);
+gboolean gplayer_core_is_playing(GPlayerCore *core);
+void gplayer_core_set_volume(GPlayerCore *core, gfloat left, gfloat right);
+void gplayer_core_set_buffer_size(GPlayerCore *core, gint size);
+void gplayer_core_set_compressed_buffering(GPlayerCore *core, gboolean enable);
+/* Copy the decoded audio into a ring readers poll without locks, laid out as described in pcmtap.h. Returns
+ * the memory of the ring, valid until gplayer_core_free; its capacity is fixed by the first call, 0 picks
+ * the default. */
+gpointer gplayer_core_enable_pcm_tap(GPlayerCore *core, gsize capacity, gsize *size);
+void gplayer_core_disable_pcm_tap(GPlayerCore *core);
+void gplayer_core_set_network(GPlayerCore *core, gboolean fast);
+void gplayer_core_set_notify_time(GPlayerCore *core, gint time);
+void gplayer_core_get_stats(GPlayerCore *core, GPlayerStats *stats);
+/* Copy the first size slots of the snapshot without taking the player's locks or allocating, for frequent
+ * polling. Every slot is read atomically, but not all at the same instant. armeabi has no 64 bit atomic
+ * instructions, there libatomic serializes the slots with locks of its own. */
+void gplayer_core_get_snapshot(GPlayerCore *core, gint64 *values, gint size);
+/* Fills GPLAYER_STARTUP_PHASES * GPLAYER_STARTUP_BUCKETS counters, phase by phase, over all tracks of this player */
+void gplayer_core_get_startup_histogram(GPlayerCore *core, guint *counts);
+/* Fills GPLAYER_STALL_CAUSES * GPLAYER_STALL_BUCKETS counters, cause by cause, over all tracks of this player */
+void gplayer_core_get_stall_histogram(GPlayerCore *core, guint *counts);
+/* Download the first amount of bytes, or seconds, of a uri likely to be played soon. Shared by all players,
+ * the download yields to any player filling its buffer. */
+void gplayer_core_prefetch(const gchar *uri, gint amount, gboolean seconds);
+/* Prefetches requested, played, and the bytes dropped unplayed */
+void gplayer_core_get_prefetch_stats(guint64 *requests, guint64 *hits, guint64 *wasted_bytes);
+void gplayer_core_get_http_stats(GPlayerHttpStats *stats);
+/* Bytes kept of progressive downloads for all players, 0 disables the cache */
+void gplayer_core_set_cache_size(guint64 max_size);
+void gplayer_core_enable_logging(gboolean enable);
+/* The trace of recent events of all threads, to a file or to the log when path is NULL */
+gboolean gplayer_core_dump_trace(const gchar *path);
+
+#endif /* GPLAYER_CORE_H_ */
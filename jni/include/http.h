@@ -0,0 +1,21 @@
+/*
+ * http.h
+ *
+ *  Shared HTTP session and request statistics.
+ */
+
+#include <libsoup/soup.h>
+
+/* One HTTP session for playback, the prefetch downloads and cache validation keeps connections to the servers
+ * alive between tracks and between them, and through it the TLS sessions for resumption. Every request through
+ * it is timed. Tracks are played over it by the gplayer+http(s) source of prefetch.c, souphttpsrc of GStreamer
+ * 1.6 can not be given a session. */
+#define HTTP_MAX_CONNS_PER_HOST 4
+/* Seconds an idle connection is kept open */
+#define HTTP_IDLE_TIMEOUT 60
+#define HTTP_TIMEOUT 10
+
+SoupSession *http_get_session(void);
+/* Count msg as a request made playing a track */
+void http_mark_playback(SoupMessage *msg);
+void http_get_stats(GPlayerHttpStats *stats);
@@ -12,4 +12,9 @@ extern jmethodID gplayer_initialized_method_id;
 extern jmethodID gplayer_prepared_method_id;
 extern jmethodID gplayer_playback_running_id;
 extern jmethodID gplayer_metadata_method_id;
+extern jmethodID gplayer_track_changed_id;
 JNIEnv *get_jni_env(void);
+
+/* Delivers the events of a GPlayerCore to the GPlayer object passed as its user_data */
+extern const GPlayerCallbacks java_callbacks;
+void java_callbacks_release(jobject app);
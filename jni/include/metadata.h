@@ -0,0 +1,54 @@
+/*
+ * metadata.h
+ *
+ *  Stream metadata as the application sees it.
+ */
+
+/* The tags of one stream, merged from all its TAG messages. Demuxers, parsers and decoders each post their
+ * own, and ICY radio repeats the title every few seconds, the application only hears about changes. */
+typedef struct _Metadata
+{
+	gchar *title;
+	gchar *artist;
+	gchar *album;
+	guint bitrate;
+	GstBuffer *cover;
+	gchar *cover_type;
+	/* Titles are split into artist and title unless the stream has an artist tag */
+	gboolean has_artist;
+	/* The bitrate is the nominal one, or else the first one seen, VBR updates would change it all the time */
+	gboolean nominal_bitrate;
+} Metadata;
+
+void metadata_clear(Metadata *meta);
+/* TRUE when anything the application sees changed */
+gboolean metadata_merge(Metadata *meta, const GstTagList *tags);
+/* Points into meta, valid until it changes */
+void metadata_get(const Metadata *meta, GPlayerMetadata *view);
+
+/* Tag changes on their way to the listener, stamped with the running time of the audio following them at the
+ * sink, so they are delivered when that audio is heard instead of when a demuxer parsed them, up to a full
+ * buffer earlier. The streaming thread of the sink pushes and the main loop pops. When full, a change is
+ * merged into the newest entry. */
+#define TAG_TIMELINE_SIZE 8
+
+typedef struct _TagTimeline
+{
+	GMutex lock;
+	GstTagList *tags[TAG_TIMELINE_SIZE];
+	GstClockTime times[TAG_TIMELINE_SIZE];
+	guint head;
+	guint length;
+	/* Stamp of the oldest entry, GST_CLOCK_TIME_NONE while empty, read without the lock */
+	GstClockTime next_due;
+} TagTimeline;
+
+void tag_timeline_init(TagTimeline *timeline);
+void tag_timeline_clear(TagTimeline *timeline);
+/* Tags seen before any audio are stamped 0 */
+void tag_timeline_push(TagTimeline *timeline, GstClockTime running_time, const GstTagList *tags);
+/* The oldest tags stamped up to until, NULL if there are none */
+GstTagList *tag_timeline_pop(TagTimeline *timeline, GstClockTime until);
+GstClockTime tag_timeline_next_due(TagTimeline *timeline);
+/* The audio they belong to was flushed */
+void tag_timeline_flush(TagTimeline *timeline);
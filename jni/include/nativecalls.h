@@ -5,29 +5,46 @@
  *      Author: Krzysztof Gawrys
  */
 
+#if GLIB_SIZEOF_VOID_P == 8
+# define GET_CUSTOM_DATA(env, thiz, fieldID) (GPlayerCore *)(*env)->GetLongField (env, thiz, fieldID)
+# define SET_CUSTOM_DATA(env, thiz, fieldID, data) (*env)->SetLongField (env, thiz, fieldID, (jlong)data)
+#else
+# define GET_CUSTOM_DATA(env, thiz, fieldID) (GPlayerCore *)(jint)(*env)->GetLongField (env, thiz, fieldID)
+# define SET_CUSTOM_DATA(env, thiz, fieldID, data) (*env)->SetLongField (env, thiz, fieldID, (jlong)(jint)data)
+#endif
+
 // java calls
 static void gst_native_class_init(JNIEnv* env, jclass klass);
-extern void gst_native_finalize(JNIEnv* env, jobject thiz);
-extern void gst_native_init(JNIEnv* env, jobject thiz);
+static void gst_native_finalize(JNIEnv* env, jobject thiz);
+static void gst_native_init(JNIEnv* env, jobject thiz);
 static void gst_native_pause(JNIEnv* env, jobject thiz);
 static void gst_native_play(JNIEnv* env, jobject thiz);
-static void gst_native_pause(JNIEnv* env, jobject thiz);
 static void gst_native_reset(JNIEnv* env, jobject thiz);
 static void gst_native_set_notifytime(JNIEnv* env, jobject thiz, int time);
 static void gst_native_set_position(JNIEnv* env, jobject thiz, int milliseconds);
 static void gst_native_set_uri(JNIEnv* env, jobject thiz, jstring uri, jboolean seek);
 static void gst_native_set_url(JNIEnv* env, jobject thiz, jstring uri, jboolean seek);
+static void gst_native_set_next_uri(JNIEnv* env, jobject thiz, jstring uri, jboolean seek);
+static void gst_native_set_next_url(JNIEnv* env, jobject thiz, jstring uri, jboolean seek);
 static void gst_native_volume(JNIEnv* env, jobject thiz, float left, float right);
 static gboolean gst_native_isplaying(JNIEnv* env, jobject thiz);
 static void gst_native_buffer_size(JNIEnv* env, jobject thiz, int size);
 static int gst_native_get_duration(JNIEnv* env, jobject thiz);
 static int gst_native_get_position(JNIEnv* env, jobject thiz);
 static void gst_native_network_change(JNIEnv* env, jobject thiz, jboolean fast);
+static void gst_native_compressed_buffering(JNIEnv* env, jobject thiz, jboolean enable);
+static jobject gst_native_enable_pcm_tap(JNIEnv* env, jobject thiz, jint capacity);
+static void gst_native_disable_pcm_tap(JNIEnv* env, jobject thiz);
+static jlong gst_native_pcm_tap_write_index(JNIEnv* env, jclass klass, jobject memory);
+static void gst_native_pcm_tap_set_read_index(JNIEnv* env, jclass klass, jobject memory, jlong read);
+static jlong gst_native_pcm_tap_dropped_bytes(JNIEnv* env, jclass klass, jobject memory);
 static void gst_native_enable_log(JNIEnv* env, jobject thiz, jboolean enable);
-
-void set_notifyfunction(CustomData *data);
-void buffer_size(CustomData *data, int size);
-void build_pipeline(CustomData *data);
-void check_initialization_complete(CustomData *data);
-void execute_seek(gint64 desired_position, CustomData *data);
-void print_one_tag(const GstTagList * list, const gchar * tag, CustomData *data);
+static jboolean gst_native_dump_trace(JNIEnv* env, jclass klass, jstring path);
+static void gst_native_set_cache_size(JNIEnv* env, jclass klass, jlong size);
+static void gst_native_prefetch(JNIEnv* env, jclass klass, jstring url, jint amount, jboolean seconds);
+static void gst_native_get_prefetch_stats(JNIEnv* env, jclass klass, jlongArray stats);
+static void gst_native_get_http_stats(JNIEnv* env, jclass klass, jlongArray stats);
+static void gst_native_get_startup_times(JNIEnv* env, jobject thiz, jlongArray times);
+static void gst_native_get_startup_histogram(JNIEnv* env, jobject thiz, jintArray counts);
+static void gst_native_get_stall_histogram(JNIEnv* env, jobject thiz, jintArray counts);
+static void gst_native_get_stats(JNIEnv* env, jobject thiz, jlongArray stats);
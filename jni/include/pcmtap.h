@@ -0,0 +1,53 @@
+/*
+ * pcmtap.h
+ *
+ *  Shared memory tap of the decoded audio.
+ */
+
+/* The decoded audio leaving the volume element, copied into a ring in native memory which Java reads
+ * through one direct ByteBuffer, without a JNI call or an allocation per buffer. The streaming thread
+ * is the only writer and the application the only reader. Each side stores its own index with release
+ * semantics and loads the other one with acquire semantics. A buffer not fitting into the free space
+ * is dropped whole. GPlayer.PcmTap mirrors the layout below and copies the audio itself, but goes
+ * through the index functions at the end for the 64 bit fields: Java can neither load them without
+ * tearing on 32 bit ARM nor order its accesses against the atomics of this side. */
+#define PCM_TAP_HEADER_SIZE 64
+#define PCM_TAP_DEFAULT_CAPACITY (64 * 1024)
+
+typedef struct _PcmTapHeader
+{
+	/* Bytes written and read since the tap was created, the ring position is the index modulo capacity */
+	gint64 write_index;
+	gint64 read_index;
+	gint64 dropped_bytes;
+	/* Incremented after the fields below changed, the data written afterwards is in the new format */
+	gint32 format_sequence;
+	gint32 rate;
+	gint32 channels;
+	gint32 sample_bits;
+	gint32 is_float;
+	/* A power of two */
+	gint32 capacity;
+} PcmTapHeader;
+
+typedef struct _PcmTap
+{
+	PcmTapHeader *header;
+	guint8 *ring;
+	gsize capacity;
+	/* The pad whose caps the format fields describe */
+	gpointer format_pad;
+} PcmTap;
+
+PcmTap *pcm_tap_new(gsize capacity);
+void pcm_tap_free(PcmTap *tap);
+/* The header followed by the ring, as handed to Java */
+gpointer pcm_tap_get_memory(PcmTap *tap, gsize *size);
+void pcm_tap_set_format(PcmTap *tap, GstPad *pad, GstCaps *caps);
+void pcm_tap_write(PcmTap *tap, const guint8 *data, gsize size);
+/* Reader side for native consumers */
+gsize pcm_tap_read(PcmTap *tap, guint8 *data, gsize size);
+/* Reader side for a consumer holding only the memory of pcm_tap_get_memory and copying the ring itself */
+gint64 pcm_tap_load_write_index(gpointer memory);
+void pcm_tap_store_read_index(gpointer memory, gint64 read);
+gint64 pcm_tap_load_dropped_bytes(gpointer memory);
@@ -0,0 +1,29 @@
+/*
+ * prefetch.h
+ *
+ *  Prefetch of upcoming tracks.
+ */
+
+/* Every http(s) uri is played through a gplayer+http(s) source over the shared session of http.c, so tracks
+ * reuse the connections and TLS sessions of each other. Like souphttpsrc it reports itself as a stream, passes
+ * on the response headers and asks for ICY metadata, so uridecodebin buffers it the same way, the cache can
+ * keep it and radios get their titles. The leading bytes of upcoming tracks are downloaded in the background,
+ * one at a time and only while no player is filling its buffer. A download paused for longer than a few
+ * seconds closes its response and continues with a range request. Only files of known size are prefetched.
+ * The source serves those bytes from memory and continues with a range request. */
+#define PREFETCH_MAX_ENTRIES 8
+#define PREFETCH_MAX_BYTES (2 * 1024 * 1024)
+
+/* Set on buffers served from memory, they are no measure of the network */
+#define PREFETCH_BUFFER_FLAG GST_BUFFER_FLAG_LAST
+
+/* Registers the source element */
+void prefetch_init(void);
+void prefetch_add(const gchar *uri, gsize bytes);
+/* Whether a player is filling its buffer and needs the bandwidth, the download waits until it is not */
+void prefetch_set_foreground_busy(gboolean busy);
+/* The uri to play an http(s) uri through, ending its prefetch. NULL for any other uri. */
+gchar *prefetch_claim(const gchar *uri);
+/* The http(s) uri a claimed one stands for, uri itself for any other */
+const gchar *prefetch_get_original_uri(const gchar *uri);
+void prefetch_get_stats(guint64 *requests, guint64 *hits, guint64 *wasted_bytes);
@@ -0,0 +1,57 @@
+/*
+ * trace.h
+ *
+ *  Always-on binary trace of the engine.
+ */
+
+/* Always-on trace of the engine. Every thread writes fixed size binary records, an event and three integers, to
+ * a ring of its own without locks or formatting; text is only made when the rings are dumped. Events above
+ * GPLAYER_TRACE_LEVEL are compiled out together with their arguments. */
+#define TRACE_LEVEL_NONE 0
+#define TRACE_LEVEL_INFO 1
+#define TRACE_LEVEL_DEBUG 2
+
+#ifndef GPLAYER_TRACE_LEVEL
+#define GPLAYER_TRACE_LEVEL TRACE_LEVEL_DEBUG
+#endif
+
+/* Records kept per thread, the oldest are overwritten */
+#define TRACE_RING_SIZE 512
+
+/* The arguments of each event follow it */
+typedef enum
+{
+	TRACE_ERROR_CODE,		/* code */
+	TRACE_NOTIFY_TIME,		/* position in ms */
+	TRACE_PLAYBACK_COMPLETE,
+	TRACE_PLAYBACK_RUNNING,
+	TRACE_PREPARE_COMPLETE,
+	TRACE_INIT_COMPLETE,
+	TRACE_METADATA,
+	TRACE_TRACK_CHANGED,
+	TRACE_WORKER,			/* buffering level, waiting, starving */
+	TRACE_NETWORK,			/* throughput and stream bitrate in bit/s, confidence */
+	TRACE_REQUEST_PLAYING,	/* buffering level, buffering time in ms */
+	TRACE_NO_DATA,			/* buffering level */
+	TRACE_SEEK,				/* position in ms, through the frame index */
+	TRACE_SEEK_LATENCY,		/* us */
+	TRACE_STALL,			/* duration and position in ms, GPlayerStallCause */
+	TRACE_STARTUP,			/* GPlayerStartupPhase, ms since the uri was set */
+	TRACE_RETRY,			/* delay in ms, attempt */
+	TRACE_RECONNECT,		/* attempt, byte offset */
+	TRACE_RECOVERED,		/* ms since the source failed */
+	TRACE_EOS_HELD,
+	TRACE_EVENTS
+} TraceEvent;
+
+void trace_record(TraceEvent event, gint64 a, gint64 b, gint64 c);
+/* Write the records of all threads in time order to the file at path, or to the log when path is NULL */
+gboolean trace_dump(const gchar *path);
+
+#define TRACE(level, event, a, b, c) \
+	do { \
+		if ((level) <= GPLAYER_TRACE_LEVEL) \
+			trace_record((event), (gint64) (a), (gint64) (b), (gint64) (c)); \
+	} while (0)
+#define TRACE_INFO(event, a, b, c) TRACE(TRACE_LEVEL_INFO, event, a, b, c)
+#define TRACE_DEBUG(event, a, b, c) TRACE(TRACE_LEVEL_DEBUG, event, a, b, c)
@@ -7,62 +7,164 @@
 
 #include <jni.h>
 #include <gst/gst.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
 #include "include/customdata.h"
 #include "include/java_callbacks.h"
 
-void gplayer_error(const gint message, CustomData *data)
+/* Events are not delivered on the thread raising them. They are pushed to a lock-free list and a
+ * dispatcher thread hands them to Java in batches, so a slow listener never stalls the main loop. */
+typedef enum
 {
-	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending error code: %i", message);
-	(*env)->CallVoidMethod(env, data->app, gplayer_error_id, message);
-	if ((*env)->ExceptionCheck(env))
+	EVENT_ERROR,
+	EVENT_NOTIFY_TIME,
+	EVENT_PLAYBACK_COMPLETE,
+	EVENT_PLAYBACK_RUNNING,
+	EVENT_PREPARE_COMPLETE,
+	EVENT_INIT_COMPLETE,
+	EVENT_METADATA,
+	EVENT_TRACK_CHANGED,
+	EVENT_RELEASE
+} JavaEventType;
+
+typedef struct _JavaEvent
+{
+	struct _JavaEvent *next;
+	JavaEventType type;
+	jobject app;
+	gint value;
+	gchar *text;
+	/* The rest of a metadata event, whose text is the title and value the bitrate */
+	gchar *artist;
+	gchar *album;
+	gchar *cover_type;
+	GstBuffer *cover;
+	gboolean superseded;
+} JavaEvent;
+
+/* Newest first, producers only push and the dispatcher only takes the whole list */
+static JavaEvent *pending_events;
+static sem_t pending_count;
+static pthread_once_t dispatcher_once = PTHREAD_ONCE_INIT;
+static pthread_t dispatcher_thread;
+
+static JavaEvent *take_events(void)
+{
+	JavaEvent *head, *fifo = NULL, *next;
+
+	do
 	{
-		GST_ERROR("Failed to call Java method");
-		(*env)->ExceptionClear(env);
+		head = g_atomic_pointer_get(&pending_events);
+	} while (head && !g_atomic_pointer_compare_and_exchange(&pending_events, head, NULL));
+
+	while (head)
+	{
+		next = head->next;
+		head->next = fifo;
+		fifo = head;
+		head = next;
 	}
+	return fifo;
 }
 
-void gplayer_playback_complete(CustomData *data)
+/* Events of one class only report the latest state, an earlier one in the same batch can be dropped */
+static gint merge_class(JavaEvent *event)
 {
-	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending Playback Complete Event");
-	(*env)->CallVoidMethod(env, data->app, gplayer_playback_complete_id, NULL);
-	if ((*env)->ExceptionCheck(env))
-	{
-		GST_ERROR("Failed to call Java method");
-		(*env)->ExceptionClear(env);
-	}
+	if (event->type == EVENT_NOTIFY_TIME)
+		return 1;
+	if (event->type == EVENT_ERROR && (event->value == BUFFER_SLOW || event->value == BUFFER_FAST))
+		return 2;
+	if (event->type == EVENT_METADATA)
+		return 3;
+	return 0;
 }
 
-void gplayer_playback_running(CustomData *data)
+static void merge_superseded(JavaEvent *batch)
 {
-	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending Playback Running Event");
-	(*env)->CallVoidMethod(env, data->app, gplayer_playback_running_id, NULL);
-	if ((*env)->ExceptionCheck(env))
+	JavaEvent *event, *later;
+
+	for (event = batch; event; event = event->next)
 	{
-		GST_ERROR("Failed to call Java method");
-		(*env)->ExceptionClear(env);
+		gint class = merge_class(event);
+		if (!class)
+			continue;
+		for (later = event->next; later; later = later->next)
+		{
+			if (later->app == event->app && merge_class(later) == class)
+			{
+				event->superseded = TRUE;
+				break;
+			}
+		}
 	}
 }
 
-void gplayer_prepare_complete(CustomData *data)
+static jstring new_string(JNIEnv *env, const gchar *text)
 {
-	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending Prepare Complete Event");
-	(*env)->CallVoidMethod(env, data->app, gplayer_prepared_method_id, NULL);
-	if ((*env)->ExceptionCheck(env))
+	return text ? (*env)->NewStringUTF(env, text) : NULL;
+}
+
+/* The cover is handed over in place, as a direct buffer valid during the call */
+static void deliver_metadata(JNIEnv *env, JavaEvent *event)
+{
+	jstring title = new_string(env, event->text);
+	jstring artist = new_string(env, event->artist);
+	jstring album = new_string(env, event->album);
+	jstring cover_type = new_string(env, event->cover_type);
+	jobject cover = NULL;
+	GstMapInfo map;
+
+	if (event->cover && gst_buffer_map(event->cover, &map, GST_MAP_READ))
+		cover = (*env)->NewDirectByteBuffer(env, map.data, map.size);
+	(*env)->CallVoidMethod(env, event->app, gplayer_metadata_method_id, title, artist, album, (jint) event->value, cover, cover_type);
+	if (event->cover && cover)
 	{
-		GST_ERROR("Failed to call Java method");
-		(*env)->ExceptionClear(env);
+		(*env)->DeleteLocalRef(env, cover);
+		gst_buffer_unmap(event->cover, &map);
 	}
+	if (title)
+		(*env)->DeleteLocalRef(env, title);
+	if (artist)
+		(*env)->DeleteLocalRef(env, artist);
+	if (album)
+		(*env)->DeleteLocalRef(env, album);
+	if (cover_type)
+		(*env)->DeleteLocalRef(env, cover_type);
 }
 
-void gplayer_metadata_update(CustomData *data, const gchar *metadata)
+static void deliver(JNIEnv *env, JavaEvent *event)
 {
-	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending Metadata Event");
-	(*env)->CallVoidMethod(env, data->app, gplayer_metadata_method_id, ((*env)->NewStringUTF(env, metadata)));
+	switch (event->type)
+	{
+	case EVENT_ERROR:
+		(*env)->CallVoidMethod(env, event->app, gplayer_error_id, event->value);
+		break;
+	case EVENT_NOTIFY_TIME:
+		(*env)->CallVoidMethod(env, event->app, gplayer_notify_time_id, event->value);
+		break;
+	case EVENT_PLAYBACK_COMPLETE:
+		(*env)->CallVoidMethod(env, event->app, gplayer_playback_complete_id, NULL);
+		break;
+	case EVENT_PLAYBACK_RUNNING:
+		(*env)->CallVoidMethod(env, event->app, gplayer_playback_running_id, NULL);
+		break;
+	case EVENT_PREPARE_COMPLETE:
+		(*env)->CallVoidMethod(env, event->app, gplayer_prepared_method_id, NULL);
+		break;
+	case EVENT_INIT_COMPLETE:
+		(*env)->CallVoidMethod(env, event->app, gplayer_initialized_method_id, NULL);
+		break;
+	case EVENT_METADATA:
+		deliver_metadata(env, event);
+		break;
+	case EVENT_TRACK_CHANGED:
+		(*env)->CallVoidMethod(env, event->app, gplayer_track_changed_id, NULL);
+		break;
+	case EVENT_RELEASE:
+		(*env)->DeleteGlobalRef(env, event->app);
+		break;
+	}
 	if ((*env)->ExceptionCheck(env))
 	{
 		GST_ERROR("Failed to call Java method");
@@ -70,26 +172,140 @@ void gplayer_metadata_update(CustomData *data, const gchar *metadata)
 	}
 }
 
-void gplayer_notify_time(CustomData *data, int time)
+static void free_event(JavaEvent *event)
+{
+	g_free(event->text);
+	g_free(event->artist);
+	g_free(event->album);
+	g_free(event->cover_type);
+	if (event->cover)
+		gst_buffer_unref(event->cover);
+	g_slice_free(JavaEvent, event);
+}
+
+static void *dispatcher_function(void *userdata)
 {
 	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending Time Event");
-	(*env)->CallVoidMethod(env, data->app, gplayer_notify_time_id, time);
-	if ((*env)->ExceptionCheck(env))
+	JavaEvent *batch, *event;
+
+	for (;;)
 	{
-		GST_ERROR("Failed to call Java method");
-		(*env)->ExceptionClear(env);
+		while (sem_wait(&pending_count) != 0 && errno == EINTR)
+			;
+		/* Everything posted so far is taken in one go */
+		while (sem_trywait(&pending_count) == 0)
+			;
+
+		batch = take_events();
+		merge_superseded(batch);
+		while (batch)
+		{
+			event = batch;
+			batch = event->next;
+			if (!event->superseded)
+				deliver(env, event);
+			free_event(event);
+		}
 	}
+	return NULL;
 }
 
-void gplayer_notify_init_complete(CustomData *data)
+static void start_dispatcher(void)
 {
-	JNIEnv *env = get_jni_env();
-	GPlayerDEBUG("Sending Init Complete Event");
-	(*env)->CallVoidMethod(env, data->app, gplayer_initialized_method_id, time);
-	if ((*env)->ExceptionCheck(env))
+	sem_init(&pending_count, 0, 0);
+	pthread_create(&dispatcher_thread, NULL, &dispatcher_function, NULL);
+}
+
+static JavaEvent *new_event(JavaEventType type, gpointer app, gint value, const gchar *text)
+{
+	JavaEvent *event = g_slice_new0(JavaEvent);
+
+	event->type = type;
+	event->app = (jobject) app;
+	event->value = value;
+	event->text = g_strdup(text);
+	return event;
+}
+
+static void post_event(JavaEvent *event)
+{
+	JavaEvent *head;
+
+	pthread_once(&dispatcher_once, start_dispatcher);
+
+	do
 	{
-		GST_ERROR("Failed to call Java method");
-		(*env)->ExceptionClear(env);
-	}
+		head = g_atomic_pointer_get(&pending_events);
+		event->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange(&pending_events, head, event));
+
+	sem_post(&pending_count);
+}
+
+static void push_event(JavaEventType type, gpointer app, gint value, const gchar *text)
+{
+	post_event(new_event(type, app, value, text));
+}
+
+static void java_error(gint message, gpointer app)
+{
+	push_event(EVENT_ERROR, app, message, NULL);
+}
+
+static void java_playback_complete(gpointer app)
+{
+	push_event(EVENT_PLAYBACK_COMPLETE, app, 0, NULL);
+}
+
+static void java_playback_running(gpointer app)
+{
+	push_event(EVENT_PLAYBACK_RUNNING, app, 0, NULL);
+}
+
+static void java_prepare_complete(gpointer app)
+{
+	push_event(EVENT_PREPARE_COMPLETE, app, 0, NULL);
+}
+
+static void java_track_changed(gpointer app)
+{
+	push_event(EVENT_TRACK_CHANGED, app, 0, NULL);
+}
+
+static void java_metadata_update(const GPlayerMetadata *metadata, gpointer app)
+{
+	JavaEvent *event = new_event(EVENT_METADATA, app, metadata->bitrate, metadata->title);
+
+	event->artist = g_strdup(metadata->artist);
+	event->album = g_strdup(metadata->album);
+	event->cover_type = g_strdup(metadata->cover_type);
+	event->cover = metadata->cover ? gst_buffer_ref(metadata->cover) : NULL;
+	post_event(event);
+}
+
+static void java_notify_time(gint time, gpointer app)
+{
+	push_event(EVENT_NOTIFY_TIME, app, time, NULL);
 }
+
+static void java_init_complete(gpointer app)
+{
+	push_event(EVENT_INIT_COMPLETE, app, 0, NULL);
+}
+
+/* The GlobalRef is deleted by the dispatcher, after the events still queued for it */
+void java_callbacks_release(jobject app)
+{
+	push_event(EVENT_RELEASE, app, 0, NULL);
+}
+
+const GPlayerCallbacks java_callbacks = {
+	java_error,
+	java_notify_time,
+	java_playback_complete,
+	java_playback_running,
+	java_prepare_complete,
+	java_init_complete,
+	java_metadata_update,
+	java_track_changed
+};
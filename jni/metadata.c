@@ -0,0 +1,235 @@
+/*
+ * metadata.c
+ *
+ *  Merges the TAG messages of a stream into the metadata the application is told about.
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/tag/tag.h>
+#include "include/gplayer_core.h"
+#include "include/metadata.h"
+
+void metadata_clear(Metadata *meta)
+{
+	g_free(meta->title);
+	g_free(meta->artist);
+	g_free(meta->album);
+	g_free(meta->cover_type);
+	if (meta->cover)
+		gst_buffer_unref(meta->cover);
+	memset(meta, 0, sizeof(Metadata));
+}
+
+/* Takes value, TRUE if it differs from the field */
+static gboolean set_string(gchar **field, gchar *value)
+{
+	if (g_strcmp0(*field, value) == 0)
+	{
+		g_free(value);
+		return FALSE;
+	}
+	g_free(*field);
+	*field = value;
+	return TRUE;
+}
+
+/* The same image is sent again in new buffers, by every tag list of an ID3 stream */
+static gboolean same_content(GstBuffer *a, GstBuffer *b)
+{
+	GstMapInfo map;
+	gboolean same;
+
+	if (a == b)
+		return TRUE;
+	if (!a || !b || gst_buffer_get_size(a) != gst_buffer_get_size(b) || !gst_buffer_map(a, &map, GST_MAP_READ))
+		return FALSE;
+	same = gst_buffer_memcmp(b, 0, map.data, map.size) == 0;
+	gst_buffer_unmap(a, &map);
+	return same;
+}
+
+/* The front cover when the stream tells which image is which, else its first image, else a preview */
+static GstSample *find_cover(const GstTagList *tags)
+{
+	GstSample *sample, *first = NULL;
+	const GstStructure *info;
+	const GValue *type;
+	guint i;
+
+	for (i = 0; gst_tag_list_get_sample_index(tags, GST_TAG_IMAGE, i, &sample); i++)
+	{
+		info = gst_sample_get_info(sample);
+		type = info ? gst_structure_get_value(info, "image-type") : NULL;
+		if (type && G_VALUE_HOLDS_ENUM(type) && g_value_get_enum(type) == GST_TAG_IMAGE_TYPE_FRONT_COVER)
+		{
+			if (first)
+				gst_sample_unref(first);
+			return sample;
+		}
+		if (first)
+			gst_sample_unref(sample);
+		else
+			first = sample;
+	}
+	if (!first)
+		gst_tag_list_get_sample(tags, GST_TAG_PREVIEW_IMAGE, &first);
+	return first;
+}
+
+gboolean metadata_merge(Metadata *meta, const GstTagList *tags)
+{
+	gboolean changed = FALSE;
+	const gchar *separator;
+	GstSample *sample;
+	GstBuffer *cover;
+	GstCaps *caps;
+	gchar *value;
+	guint bitrate;
+
+	if (gst_tag_list_get_string(tags, GST_TAG_ARTIST, &value))
+	{
+		meta->has_artist = TRUE;
+		changed |= set_string(&meta->artist, value);
+	}
+	if (gst_tag_list_get_string(tags, GST_TAG_TITLE, &value))
+	{
+		/* Stream titles of ICY radio read "Artist - Title" */
+		separator = meta->has_artist ? NULL : strstr(value, " - ");
+		if (separator)
+		{
+			changed |= set_string(&meta->artist, g_strndup(value, separator - value));
+			changed |= set_string(&meta->title, g_strdup(separator + 3));
+			g_free(value);
+		}
+		else
+			changed |= set_string(&meta->title, value);
+	}
+	if (gst_tag_list_get_string(tags, GST_TAG_ALBUM, &value))
+		changed |= set_string(&meta->album, value);
+
+	if (gst_tag_list_get_uint(tags, GST_TAG_NOMINAL_BITRATE, &bitrate) && bitrate != meta->bitrate)
+	{
+		meta->bitrate = bitrate;
+		meta->nominal_bitrate = TRUE;
+		changed = TRUE;
+	}
+	else if (!meta->nominal_bitrate && meta->bitrate == 0 && gst_tag_list_get_uint(tags, GST_TAG_BITRATE, &bitrate))
+	{
+		meta->bitrate = bitrate;
+		changed = TRUE;
+	}
+
+	sample = find_cover(tags);
+	if (sample)
+	{
+		cover = gst_sample_get_buffer(sample);
+		caps = gst_sample_get_caps(sample);
+		if (cover && !same_content(meta->cover, cover))
+		{
+			if (meta->cover)
+				gst_buffer_unref(meta->cover);
+			meta->cover = gst_buffer_ref(cover);
+			changed = TRUE;
+		}
+		if (cover && caps && !gst_caps_is_empty(caps))
+			changed |= set_string(&meta->cover_type, g_strdup(gst_structure_get_name(gst_caps_get_structure(caps, 0))));
+		gst_sample_unref(sample);
+	}
+	return changed;
+}
+
+void tag_timeline_init(TagTimeline *timeline)
+{
+	memset(timeline, 0, sizeof(TagTimeline));
+	g_mutex_init(&timeline->lock);
+	timeline->next_due = GST_CLOCK_TIME_NONE;
+}
+
+void tag_timeline_clear(TagTimeline *timeline)
+{
+	tag_timeline_flush(timeline);
+	g_mutex_clear(&timeline->lock);
+}
+
+/* Called with the lock */
+static void update_next_due(TagTimeline *timeline)
+{
+	__atomic_store_n(&timeline->next_due, timeline->length ? timeline->times[timeline->head] : GST_CLOCK_TIME_NONE,
+			__ATOMIC_RELEASE);
+}
+
+void tag_timeline_push(TagTimeline *timeline, GstClockTime running_time, const GstTagList *tags)
+{
+	guint last;
+
+	if (!GST_CLOCK_TIME_IS_VALID(running_time))
+		running_time = 0;
+
+	g_mutex_lock(&timeline->lock);
+	last = (timeline->head + timeline->length - 1) % TAG_TIMELINE_SIZE;
+	if (timeline->length == TAG_TIMELINE_SIZE)
+	{
+		gst_tag_list_insert(timeline->tags[last], tags, GST_TAG_MERGE_REPLACE);
+	}
+	else if (timeline->length > 0 && timeline->times[last] == running_time)
+	{
+		/* Several elements tell about the same audio */
+		gst_tag_list_insert(timeline->tags[last], tags, GST_TAG_MERGE_REPLACE);
+	}
+	else
+	{
+		last = (timeline->head + timeline->length) % TAG_TIMELINE_SIZE;
+		timeline->tags[last] = gst_tag_list_copy(tags);
+		timeline->times[last] = running_time;
+		timeline->length++;
+	}
+	update_next_due(timeline);
+	g_mutex_unlock(&timeline->lock);
+}
+
+GstTagList *tag_timeline_pop(TagTimeline *timeline, GstClockTime until)
+{
+	GstTagList *tags = NULL;
+
+	g_mutex_lock(&timeline->lock);
+	if (timeline->length > 0 && timeline->times[timeline->head] <= until)
+	{
+		tags = timeline->tags[timeline->head];
+		timeline->tags[timeline->head] = NULL;
+		timeline->head = (timeline->head + 1) % TAG_TIMELINE_SIZE;
+		timeline->length--;
+		update_next_due(timeline);
+	}
+	g_mutex_unlock(&timeline->lock);
+	return tags;
+}
+
+GstClockTime tag_timeline_next_due(TagTimeline *timeline)
+{
+	return __atomic_load_n(&timeline->next_due, __ATOMIC_ACQUIRE);
+}
+
+void tag_timeline_flush(TagTimeline *timeline)
+{
+	g_mutex_lock(&timeline->lock);
+	while (timeline->length > 0)
+	{
+		gst_tag_list_unref(timeline->tags[timeline->head]);
+		timeline->tags[timeline->head] = NULL;
+		timeline->head = (timeline->head + 1) % TAG_TIMELINE_SIZE;
+		timeline->length--;
+	}
+	update_next_due(timeline);
+	g_mutex_unlock(&timeline->lock);
+}
+
+void metadata_get(const Metadata *meta, GPlayerMetadata *view)
+{
+	view->title = meta->title;
+	view->artist = meta->artist;
+	view->album = meta->album;
+	view->bitrate = meta->bitrate;
+	view->cover = meta->cover;
+	view->cover_type = meta->cover_type;
+}
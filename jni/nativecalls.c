@@ -9,10 +9,10 @@
 #include <gst/gst.h>
 #include <pthread.h>
 #include "include/customdata.h"
+#include "include/java_callbacks.h"
 #include "include/nativecalls.h"
 
 static pthread_key_t current_jni_env;
-jboolean enable_logs;
 static JavaVM *java_vm;
 
 jmethodID gplayer_error_id;
@@ -22,6 +22,7 @@ jmethodID gplayer_initialized_method_id;
 jmethodID gplayer_prepared_method_id;
 jmethodID gplayer_playback_running_id;
 jmethodID gplayer_metadata_method_id;
+jmethodID gplayer_track_changed_id;
 jfieldID custom_data_field_id;
 
 /* List of implemented native methods */
@@ -30,6 +31,8 @@ JNINativeMethod native_methods[] = {
 { "nativeFinalize", "()V", (void *) gst_native_finalize },
 { "nativeSetUri", "(Ljava/lang/String;Z)V", (void *) gst_native_set_uri },
 { "nativeSetUrl", "(Ljava/lang/String;Z)V", (void *) gst_native_set_url },
+{ "nativeSetNextUri", "(Ljava/lang/String;Z)V", (void *) gst_native_set_next_uri },
+{ "nativeSetNextUrl", "(Ljava/lang/String;Z)V", (void *) gst_native_set_next_url },
 { "nativeSetPosition", "(I)V", (void*) gst_native_set_position },
 { "nativeSetNotifyTime", "(I)V", (void*) gst_native_set_notifytime },
 { "nativeGetPosition", "()I", (int*) gst_native_get_position },
@@ -43,12 +46,27 @@ JNINativeMethod native_methods[] = {
 { "nativeSetVolume", "(FF)V", (gboolean *) gst_native_volume },
 { "nativeSetBufferSize", "(I)V", (void *) gst_native_buffer_size },
 { "nativeNetworkChange", "(Z)V", (void *) gst_native_network_change },
-{ "nativeEnableLogging", "(Z)V", (void *) gst_native_enable_log }
+{ "nativeSetCompressedBuffering", "(Z)V", (void *) gst_native_compressed_buffering },
+{ "nativeEnablePcmTap", "(I)Ljava/nio/ByteBuffer;", (void *) gst_native_enable_pcm_tap },
+{ "nativeDisablePcmTap", "()V", (void *) gst_native_disable_pcm_tap },
+{ "nativePcmTapWriteIndex", "(Ljava/nio/ByteBuffer;)J", (void *) gst_native_pcm_tap_write_index },
+{ "nativePcmTapSetReadIndex", "(Ljava/nio/ByteBuffer;J)V", (void *) gst_native_pcm_tap_set_read_index },
+{ "nativePcmTapDroppedBytes", "(Ljava/nio/ByteBuffer;)J", (void *) gst_native_pcm_tap_dropped_bytes },
+{ "nativeEnableLogging", "(Z)V", (void *) gst_native_enable_log },
+{ "nativeDumpTrace", "(Ljava/lang/String;)Z", (void *) gst_native_dump_trace },
+{ "nativeSetCacheSize", "(J)V", (void *) gst_native_set_cache_size },
+{ "nativePrefetch", "(Ljava/lang/String;IZ)V", (void *) gst_native_prefetch },
+{ "nativeGetPrefetchStats", "([J)V", (void *) gst_native_get_prefetch_stats },
+{ "nativeGetHttpStats", "([J)V", (void *) gst_native_get_http_stats },
+{ "nativeGetStartupTimes", "([J)V", (void *) gst_native_get_startup_times },
+{ "nativeGetStats", "([J)V", (void *) gst_native_get_stats },
+{ "nativeGetStartupHistogram", "([I)V", (void *) gst_native_get_startup_histogram },
+{ "nativeGetStallHistogram", "([I)V", (void *) gst_native_get_stall_histogram }
 };
 
 /* Static class initializer: retrieve method and field IDs */
 void gst_native_class_init(JNIEnv* env, jclass klass) {
-	enable_logs = FALSE;
+	gplayer_core_enable_logging(FALSE);
 	custom_data_field_id = (*env)->GetFieldID(env, klass, "native_custom_data", "J");
 	gplayer_error_id = (*env)->GetMethodID(env, klass, "onError", "(I)V");
 	gplayer_notify_time_id = (*env)->GetMethodID(env, klass, "onTime", "(I)V");
@@ -56,170 +74,253 @@ void gst_native_class_init(JNIEnv* env, jclass klass) {
 	gplayer_playback_running_id = (*env)->GetMethodID(env, klass, "onPlayStarted", "()V");
 	gplayer_initialized_method_id = (*env)->GetMethodID(env, klass, "onGPlayerReady", "()V");
 	gplayer_prepared_method_id = (*env)->GetMethodID(env, klass, "onPrepared", "()V");
-	gplayer_metadata_method_id = (*env)->GetMethodID(env, klass, "onMetadata", "(Ljava/lang/String;)V");
+	gplayer_metadata_method_id = (*env)->GetMethodID(env, klass, "onMetadata",
+			"(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;ILjava/nio/ByteBuffer;Ljava/lang/String;)V");
+	gplayer_track_changed_id = (*env)->GetMethodID(env, klass, "onTrackChanged", "()V");
+}
+
+/* Instruct the native code to create its internal data structure and pipeline */
+static void gst_native_init(JNIEnv* env, jobject thiz)
+{
+	jobject app = (*env)->NewGlobalRef(env, thiz);
+	GPlayerCore *core = gplayer_core_new(&java_callbacks, app);
+	SET_CUSTOM_DATA(env, thiz, custom_data_field_id, core);
+}
+
+/* Release the native player and the GlobalRef its callbacks use */
+static void gst_native_finalize(JNIEnv* env, jobject thiz)
+{
+	GPlayerCore *core = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	if (!core)
+		return;
+	jobject app = (jobject) gplayer_core_get_user_data(core);
+	gplayer_core_free(core);
+	java_callbacks_release(app);
+	SET_CUSTOM_DATA(env, thiz, custom_data_field_id, NULL);
 }
 
 static gboolean gst_native_isplaying(JNIEnv* env, jobject thiz)
 {
-//	GstState state;
-//	GstState pending;
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-//	gst_element_get_state(data->pipeline, &state, &pending, GST_CLOCK_TIME_NONE);
-	return data->state == GST_STATE_PLAYING;
+	return gplayer_core_is_playing(GET_CUSTOM_DATA(env, thiz, custom_data_field_id));
 }
 
 static void gst_native_volume(JNIEnv* env, jobject thiz, float left, float right)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data || !data->pipeline)
-		return;
-	GPlayerDEBUG("Set volume to %f", (float) ((left + right) / 2));
-	g_object_set(data->volume, "volume", (float) ((left + right) / 2), NULL);
+	gplayer_core_set_volume(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), left, right);
 }
 
 static void gst_native_buffer_size(JNIEnv* env, jobject thiz, int size)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data || !data->pipeline)
-		return;
-	buffer_size(data, size);
+	gplayer_core_set_buffer_size(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), size);
 }
 
 static void gst_native_network_change(JNIEnv* env, jobject thiz, jboolean fast)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data || !data->pipeline)
-		return;
-	data->fast_network = fast;
+	gplayer_core_set_network(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), fast);
 }
 
-static void gst_native_set_notifytime(JNIEnv* env, jobject thiz, int time)
+static void gst_native_compressed_buffering(JNIEnv* env, jobject thiz, jboolean enable)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	data->notify_time = time;
-	set_notifyfunction(data);
+	gplayer_core_set_compressed_buffering(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), enable);
 }
 
-static void gst_native_reset(JNIEnv* env, jobject thiz)
+/* The ring is wrapped once, Java polls it through the buffer */
+static jobject gst_native_enable_pcm_tap(JNIEnv* env, jobject thiz, jint capacity)
 {
-	gst_native_init(env, thiz);
+	gsize size;
+	gpointer memory = gplayer_core_enable_pcm_tap(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), MAX(capacity, 0), &size);
+
+	if (!memory)
+		return NULL;
+	return (*env)->NewDirectByteBuffer(env, memory, size);
 }
 
-static int gst_native_get_position(JNIEnv* env, jobject thiz)
+static void gst_native_disable_pcm_tap(JNIEnv* env, jobject thiz)
 {
-	gint64 position;
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	gplayer_core_disable_pcm_tap(GET_CUSTOM_DATA(env, thiz, custom_data_field_id));
+}
 
-	/* We do not want to update anything unless we have a working pipeline in the PAUSED or PLAYING state */
-	if (!data || !data->pipeline || data->state < GST_STATE_PAUSED)
-		return 0;
+/* The indices of the ring, with the atomics Java has no equivalent for */
+static jlong gst_native_pcm_tap_write_index(JNIEnv* env, jclass klass, jobject memory)
+{
+	return pcm_tap_load_write_index((*env)->GetDirectBufferAddress(env, memory));
+}
 
-	if (!gst_element_query_position(data->pipeline, GST_FORMAT_TIME, &position))
-	{
-		position = 0;
-	}
+static void gst_native_pcm_tap_set_read_index(JNIEnv* env, jclass klass, jobject memory, jlong read)
+{
+	pcm_tap_store_read_index((*env)->GetDirectBufferAddress(env, memory), read);
+}
 
-	return (int) (position / GST_MSECOND);
+static jlong gst_native_pcm_tap_dropped_bytes(JNIEnv* env, jclass klass, jobject memory)
+{
+	return pcm_tap_load_dropped_bytes((*env)->GetDirectBufferAddress(env, memory));
 }
 
-static int gst_native_get_duration(JNIEnv* env, jobject thiz)
+static void gst_native_set_notifytime(JNIEnv* env, jobject thiz, int time)
 {
-	gint64 duration;
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	gplayer_core_set_notify_time(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), time);
+}
 
-	/* We do not want to update anything unless we have a working pipeline in the PAUSED or PLAYING state */
-	if (!data || !data->pipeline || data->state < GST_STATE_PAUSED)
-		return 0;
+static void gst_native_reset(JNIEnv* env, jobject thiz)
+{
+	gst_native_finalize(env, thiz);
+	gst_native_init(env, thiz);
+}
 
-	if (!gst_element_query_duration(data->pipeline, GST_FORMAT_TIME, &duration))
-	{
-		duration = 0;
-	}
+static int gst_native_get_position(JNIEnv* env, jobject thiz)
+{
+	return gplayer_core_get_position(GET_CUSTOM_DATA(env, thiz, custom_data_field_id));
+}
 
-	return (int) (duration / GST_MSECOND);
+static int gst_native_get_duration(JNIEnv* env, jobject thiz)
+{
+	return gplayer_core_get_duration(GET_CUSTOM_DATA(env, thiz, custom_data_field_id));
 }
 
 static void gst_native_set_uri(JNIEnv* env, jobject thiz, jstring uri, jboolean seek)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	build_pipeline(data);
-	if (!data || !data->pipeline)
-		return;
-	const jbyte *char_uri = (*env)->GetStringUTFChars(env, uri, NULL);
+	GPlayerCore *core = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	const char *char_uri = (*env)->GetStringUTFChars(env, uri, NULL);
 	gchar *url = gst_filename_to_uri(char_uri, NULL);
-	GPlayerDEBUG("Setting URI to %s", url);
-	if (data->target_state >= GST_STATE_READY)
-		gst_element_set_state(data->pipeline, GST_STATE_READY);
-	g_object_set(data->source, "uri", url, NULL);
 	(*env)->ReleaseStringUTFChars(env, uri, char_uri);
-	data->duration = GST_CLOCK_TIME_NONE;
-	data->allow_seek = seek;
-	data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
-	gplayer_prepare_complete(data);
-	set_notifyfunction(data);
+	gplayer_core_set_uri(core, url, seek);
+	g_free(url);
 }
 
 static void gst_native_set_url(JNIEnv* env, jobject thiz, jstring uri, jboolean seek)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	build_pipeline(data);
-	if (!data || !data->pipeline)
-		return;
-	const jbyte *char_uri = (*env)->GetStringUTFChars(env, uri, NULL);
-	GPlayerDEBUG("Setting URL to %s", char_uri);
-	if (data->target_state >= GST_STATE_READY)
-		gst_element_set_state(data->pipeline, GST_STATE_READY);
-	g_object_set(data->source, "uri", char_uri, NULL);
+	GPlayerCore *core = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	const char *char_uri = (*env)->GetStringUTFChars(env, uri, NULL);
+	gplayer_core_set_uri(core, char_uri, seek);
+	(*env)->ReleaseStringUTFChars(env, uri, char_uri);
+}
+
+/* Pre-roll the next track, it replaces the current one at EOS */
+static void gst_native_set_next_uri(JNIEnv* env, jobject thiz, jstring uri, jboolean seek)
+{
+	GPlayerCore *core = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	const char *char_uri = (*env)->GetStringUTFChars(env, uri, NULL);
+	gchar *url = gst_filename_to_uri(char_uri, NULL);
+	(*env)->ReleaseStringUTFChars(env, uri, char_uri);
+	gplayer_core_set_next_uri(core, url, seek);
+	g_free(url);
+}
+
+static void gst_native_set_next_url(JNIEnv* env, jobject thiz, jstring uri, jboolean seek)
+{
+	GPlayerCore *core = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
+	const char *char_uri = (*env)->GetStringUTFChars(env, uri, NULL);
+	gplayer_core_set_next_uri(core, char_uri, seek);
 	(*env)->ReleaseStringUTFChars(env, uri, char_uri);
-	data->duration = GST_CLOCK_TIME_NONE;
-	data->allow_seek = seek;
-	data->is_live = (gst_element_set_state(data->pipeline, data->target_state) == GST_STATE_CHANGE_NO_PREROLL);
-	gplayer_prepare_complete(data);
-	set_notifyfunction(data);
 }
 
 /* Set pipeline to PLAYING state */
 static void gst_native_play(JNIEnv* env, jobject thiz)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data)
-		return;
-	GPlayerDEBUG("Requesting state to PLAYING");
-	data->target_state = GST_STATE_PLAYING;
-	data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
+	gplayer_core_play(GET_CUSTOM_DATA(env, thiz, custom_data_field_id));
 }
 
 /* Set pipeline to PAUSED state */
 static void gst_native_pause(JNIEnv* env, jobject thiz)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data)
-		return;
-	GPlayerDEBUG("Setting state to PAUSED");
-	data->target_state = GST_STATE_PAUSED;
-	data->is_live = (gst_element_set_state(data->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_NO_PREROLL);
+	gplayer_core_pause(GET_CUSTOM_DATA(env, thiz, custom_data_field_id));
 }
 
 /* Instruct the pipeline to seek to a different position */
 static void gst_native_set_position(JNIEnv* env, jobject thiz, int milliseconds)
 {
-	CustomData *data = GET_CUSTOM_DATA(env, thiz, custom_data_field_id);
-	if (!data || !data->allow_seek || milliseconds == 0)
-		return;
-	gint64 desired_position = (gint64) (milliseconds * GST_MSECOND);
-	if (data->state >= GST_STATE_PAUSED)
-	{
-		execute_seek(desired_position, data);
-	}
-	else
-	{
-		GPlayerDEBUG("Scheduling seek to %" GST_TIME_FORMAT " for later", GST_TIME_ARGS(desired_position));
-		data->desired_position = desired_position;
-	}
+	gplayer_core_seek(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), milliseconds);
 }
 
 static void gst_native_enable_log(JNIEnv* env, jobject thiz, jboolean enable) {
-	enable_logs = enable;
+	gplayer_core_enable_logging(enable);
+}
+
+static jboolean gst_native_dump_trace(JNIEnv* env, jclass klass, jstring path)
+{
+	const gchar *char_path = path ? (*env)->GetStringUTFChars(env, path, NULL) : NULL;
+	gboolean written = gplayer_core_dump_trace(char_path);
+
+	if (char_path)
+		(*env)->ReleaseStringUTFChars(env, path, char_path);
+	return written;
+}
+
+static void gst_native_set_cache_size(JNIEnv* env, jclass klass, jlong size) {
+	gplayer_core_set_cache_size(size > 0 ? (guint64) size : 0);
+}
+
+static void gst_native_prefetch(JNIEnv* env, jclass klass, jstring url, jint amount, jboolean seconds)
+{
+	const gchar *char_uri = (*env)->GetStringUTFChars(env, url, NULL);
+	gplayer_core_prefetch(char_uri, amount, seconds);
+	(*env)->ReleaseStringUTFChars(env, url, char_uri);
+}
+
+static void gst_native_get_prefetch_stats(JNIEnv* env, jclass klass, jlongArray stats)
+{
+	guint64 requests, hits, wasted_bytes;
+	jlong values[3];
+
+	gplayer_core_get_prefetch_stats(&requests, &hits, &wasted_bytes);
+	values[0] = requests;
+	values[1] = hits;
+	values[2] = wasted_bytes;
+	(*env)->SetLongArrayRegion(env, stats, 0, 3, values);
+}
+
+static void gst_native_get_http_stats(JNIEnv* env, jclass klass, jlongArray stats)
+{
+	GPlayerHttpStats http_stats;
+	jlong values[7];
+
+	gplayer_core_get_http_stats(&http_stats);
+	values[0] = http_stats.requests;
+	values[1] = http_stats.connections;
+	values[2] = http_stats.tls_handshakes;
+	values[3] = http_stats.resolve_time;
+	values[4] = http_stats.connect_time;
+	values[5] = http_stats.handshake_time;
+	values[6] = http_stats.playback_requests;
+	(*env)->SetLongArrayRegion(env, stats, 0, 7, values);
+}
+
+static void gst_native_get_startup_times(JNIEnv* env, jobject thiz, jlongArray times)
+{
+	GPlayerStats stats;
+	jlong values[GPLAYER_STARTUP_PHASES];
+	int i;
+
+	gplayer_core_get_stats(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), &stats);
+	for (i = 0; i < GPLAYER_STARTUP_PHASES; i++)
+		values[i] = stats.startup_times[i];
+	(*env)->SetLongArrayRegion(env, times, 0, MIN((*env)->GetArrayLength(env, times), GPLAYER_STARTUP_PHASES), values);
+}
+
+/* Polled often, so the snapshot goes straight into the array of the caller */
+static void gst_native_get_stats(JNIEnv* env, jobject thiz, jlongArray stats)
+{
+	jlong values[GPLAYER_SNAPSHOT_SIZE];
+	jsize size = MIN((*env)->GetArrayLength(env, stats), GPLAYER_SNAPSHOT_SIZE);
+
+	gplayer_core_get_snapshot(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), (gint64 *) values, size);
+	(*env)->SetLongArrayRegion(env, stats, 0, size, values);
+}
+
+static void gst_native_get_startup_histogram(JNIEnv* env, jobject thiz, jintArray counts)
+{
+	guint values[GPLAYER_STARTUP_PHASES * GPLAYER_STARTUP_BUCKETS];
+
+	gplayer_core_get_startup_histogram(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), values);
+	(*env)->SetIntArrayRegion(env, counts, 0, MIN((*env)->GetArrayLength(env, counts), G_N_ELEMENTS(values)), (const jint *) values);
+}
+
+static void gst_native_get_stall_histogram(JNIEnv* env, jobject thiz, jintArray counts)
+{
+	guint values[GPLAYER_STALL_CAUSES * GPLAYER_STALL_BUCKETS];
+
+	gplayer_core_get_stall_histogram(GET_CUSTOM_DATA(env, thiz, custom_data_field_id), values);
+	(*env)->SetIntArrayRegion(env, counts, 0, MIN((*env)->GetArrayLength(env, counts), G_N_ELEMENTS(values)), (const jint *) values);
 }
 
 /* Register this thread with the VM */
@@ -0,0 +1,104 @@
+/*
+ * pcmtap.c
+ *
+ *  Copies the decoded audio into the ring Java reads through a direct ByteBuffer.
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+#include "include/pcmtap.h"
+
+PcmTap *pcm_tap_new(gsize capacity)
+{
+	PcmTap *tap = g_new0(PcmTap, 1);
+	gsize size = 1;
+
+	while (size < capacity)
+		size <<= 1;
+
+	/* One block, so Java sees the header and the ring in the same buffer */
+	tap->header = g_malloc0(PCM_TAP_HEADER_SIZE + size);
+	tap->ring = (guint8 *) tap->header + PCM_TAP_HEADER_SIZE;
+	tap->capacity = size;
+	tap->header->capacity = size;
+	return tap;
+}
+
+void pcm_tap_free(PcmTap *tap)
+{
+	g_free(tap->header);
+	g_free(tap);
+}
+
+gpointer pcm_tap_get_memory(PcmTap *tap, gsize *size)
+{
+	*size = PCM_TAP_HEADER_SIZE + tap->capacity;
+	return tap->header;
+}
+
+void pcm_tap_set_format(PcmTap *tap, GstPad *pad, GstCaps *caps)
+{
+	PcmTapHeader *header = tap->header;
+	GstAudioInfo info;
+
+	tap->format_pad = pad;
+	if (!caps || !gst_audio_info_from_caps(&info, caps))
+		return;
+	header->rate = GST_AUDIO_INFO_RATE(&info);
+	header->channels = GST_AUDIO_INFO_CHANNELS(&info);
+	header->sample_bits = GST_AUDIO_INFO_WIDTH(&info);
+	header->is_float = GST_AUDIO_INFO_IS_FLOAT(&info);
+	__atomic_add_fetch(&header->format_sequence, 1, __ATOMIC_RELEASE);
+}
+
+void pcm_tap_write(PcmTap *tap, const guint8 *data, gsize size)
+{
+	PcmTapHeader *header = tap->header;
+	gint64 write = header->write_index;
+	gint64 read = __atomic_load_n(&header->read_index, __ATOMIC_ACQUIRE);
+	gsize position, first;
+
+	if (size > tap->capacity - (gsize) (write - read))
+	{
+		__atomic_store_n(&header->dropped_bytes, header->dropped_bytes + size, __ATOMIC_RELAXED);
+		return;
+	}
+
+	position = write & (tap->capacity - 1);
+	first = MIN(size, tap->capacity - position);
+	memcpy(tap->ring + position, data, first);
+	memcpy(tap->ring, data + first, size - first);
+	__atomic_store_n(&header->write_index, write + size, __ATOMIC_RELEASE);
+}
+
+gsize pcm_tap_read(PcmTap *tap, guint8 *data, gsize size)
+{
+	PcmTapHeader *header = tap->header;
+	gint64 read = header->read_index;
+	gint64 write = __atomic_load_n(&header->write_index, __ATOMIC_ACQUIRE);
+	gsize position, first;
+
+	size = MIN(size, (gsize) (write - read));
+	position = read & (tap->capacity - 1);
+	first = MIN(size, tap->capacity - position);
+	memcpy(data, tap->ring + position, first);
+	memcpy(data + first, tap->ring, size - first);
+	__atomic_store_n(&header->read_index, read + size, __ATOMIC_RELEASE);
+	return size;
+}
+
+gint64 pcm_tap_load_write_index(gpointer memory)
+{
+	return __atomic_load_n(&((PcmTapHeader *) memory)->write_index, __ATOMIC_ACQUIRE);
+}
+
+void pcm_tap_store_read_index(gpointer memory, gint64 read)
+{
+	__atomic_store_n(&((PcmTapHeader *) memory)->read_index, read, __ATOMIC_RELEASE);
+}
+
+gint64 pcm_tap_load_dropped_bytes(gpointer memory)
+{
+	return __atomic_load_n(&((PcmTapHeader *) memory)->dropped_bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,709 @@
+/*
+ * prefetch.c
+ *
+ *  Background download of the leading bytes of upcoming tracks, and the gplayer+http(s) source
+ *  that plays them.
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+#include "include/customdata.h"
+#include "include/http.h"
+#include "include/prefetch.h"
+
+#define SCHEME_PREFIX "gplayer+"
+#define CHUNK_SIZE 16384
+/* How long the download holds its response open while a player fills its buffer, then it closes it and
+ * continues with a range request once the players are done */
+#define HOLD_TIME (10 * G_TIME_SPAN_SECOND)
+/* Tags souphttpsrc makes of the ICY response headers */
+static const gchar * const icy_tags[][2] = {
+	{ "icy-name", GST_TAG_ORGANIZATION }, { "icy-genre", GST_TAG_GENRE }, { "icy-url", GST_TAG_LOCATION }
+};
+
+typedef struct _PrefetchEntry
+{
+	gint refcount;
+	gchar *uri;
+	/* Guarded by prefetch_lock, the download only appends */
+	GByteArray *data;
+	gsize wanted;
+	gint64 total;
+	/* Of the response to the prefetch, they carry the validators */
+	GstStructure *response_headers;
+	gboolean used;
+	gboolean evicted;
+} PrefetchEntry;
+
+static GMutex prefetch_lock;
+static GCond prefetch_cond;
+/* uri -> PrefetchEntry, all holds them oldest first */
+static GHashTable *entries;
+static GQueue all = G_QUEUE_INIT;
+static GQueue pending = G_QUEUE_INIT;
+/* A player is filling its buffer, guarded by prefetch_lock */
+static gboolean foreground_busy;
+static guint64 requests, hits, wasted_bytes;
+
+static PrefetchEntry *entry_ref(PrefetchEntry *entry)
+{
+	g_atomic_int_inc(&entry->refcount);
+	return entry;
+}
+
+static void entry_unref(PrefetchEntry *entry)
+{
+	if (!g_atomic_int_dec_and_test(&entry->refcount))
+		return;
+	g_free(entry->uri);
+	g_byte_array_unref(entry->data);
+	if (entry->response_headers)
+		gst_structure_free(entry->response_headers);
+	g_free(entry);
+}
+
+static gboolean is_http(const gchar *uri)
+{
+	return uri && (gst_uri_has_protocol(uri, "http") || gst_uri_has_protocol(uri, "https"));
+}
+
+static void add_header(const char *name, const char *value, GstStructure *structure)
+{
+	gst_structure_set(structure, name, G_TYPE_STRING, value, NULL);
+}
+
+/* As souphttpsrc puts them into its http-headers */
+static GstStructure *headers_to_structure(SoupMessageHeaders *headers)
+{
+	GstStructure *structure = gst_structure_new_empty("response-headers");
+
+	soup_message_headers_foreach(headers, (SoupMessageHeadersForeachFunc) add_header, structure);
+	return structure;
+}
+
+/*
+ * Background download
+ */
+
+/* Called with prefetch_lock held */
+static gboolean entry_done(PrefetchEntry *entry)
+{
+	return entry->used || entry->evicted || entry->data->len >= entry->wanted;
+}
+
+static gboolean should_stop(PrefetchEntry *entry)
+{
+	gboolean stop;
+
+	g_mutex_lock(&prefetch_lock);
+	stop = entry_done(entry);
+	g_mutex_unlock(&prefetch_lock);
+	return stop;
+}
+
+/* Wait for the players to fill their buffers, until end_time unless it is -1. FALSE when the time ran out or
+ * the entry needs no more bytes. */
+static gboolean wait_for_players(PrefetchEntry *entry, gint64 end_time)
+{
+	gboolean ready;
+
+	g_mutex_lock(&prefetch_lock);
+	while (foreground_busy && !entry_done(entry))
+	{
+		if (end_time == -1)
+			g_cond_wait(&prefetch_cond, &prefetch_lock);
+		else if (!g_cond_wait_until(&prefetch_cond, &prefetch_lock, end_time))
+			break;
+	}
+	ready = !foreground_busy && !entry_done(entry);
+	g_mutex_unlock(&prefetch_lock);
+	return ready;
+}
+
+/* Download from where the entry ends. Returns TRUE when it gave its response up to the players and is to be
+ * continued. */
+static gboolean download_range(PrefetchEntry *entry)
+{
+	SoupMessage *msg = soup_message_new("GET", entry->uri);
+	GInputStream *stream;
+	GError *error = NULL;
+	guint8 chunk[CHUNK_SIZE];
+	goffset offset = entry->data->len;
+	goffset start, end, total;
+	gboolean usable = FALSE, resume = FALSE;
+	gssize n;
+
+	if (!msg)
+		return FALSE;
+	soup_message_headers_set_range(msg->request_headers, offset, entry->wanted - 1);
+	stream = soup_session_send(http_get_session(), msg, NULL, &error);
+	if (!stream)
+	{
+		GPlayerDEBUG("prefetch of %s failed: %s", entry->uri, error->message);
+		g_error_free(error);
+		g_object_unref(msg);
+		return FALSE;
+	}
+
+	/* A continued download only goes on from the byte it asked for */
+	g_mutex_lock(&prefetch_lock);
+	if (msg->status_code == SOUP_STATUS_PARTIAL_CONTENT && soup_message_headers_get_content_range(msg->response_headers, &start, &end, &total))
+	{
+		usable = start == offset;
+		if (offset == 0)
+			entry->total = total;
+	}
+	else if (msg->status_code == SOUP_STATUS_OK && offset == 0)
+	{
+		usable = TRUE;
+		entry->total = soup_message_headers_get_content_length(msg->response_headers);
+	}
+	if (!entry->response_headers)
+		entry->response_headers = headers_to_structure(msg->response_headers);
+	g_mutex_unlock(&prefetch_lock);
+
+	/* A live stream can not be continued where the prefetch ends, and its source asks for ICY metadata */
+	if (entry->total <= 0)
+		GPlayerDEBUG("not prefetching %s, it has no known size", entry->uri);
+
+	while (usable && entry->total > 0)
+	{
+		/* Yield the bandwidth to the players */
+		if (!wait_for_players(entry, g_get_monotonic_time() + HOLD_TIME))
+		{
+			resume = !should_stop(entry);
+			break;
+		}
+		n = g_input_stream_read(stream, chunk, MIN(CHUNK_SIZE, entry->wanted - entry->data->len), NULL, NULL);
+		if (n <= 0)
+			break;
+		g_mutex_lock(&prefetch_lock);
+		g_byte_array_append(entry->data, chunk, n);
+		g_mutex_unlock(&prefetch_lock);
+	}
+
+	g_input_stream_close(stream, NULL, NULL);
+	g_object_unref(stream);
+	g_object_unref(msg);
+	return resume;
+}
+
+/* Runs only while no player fills its buffer. Without a response open it may wait for them as long as it takes. */
+static void download(PrefetchEntry *entry)
+{
+	while (wait_for_players(entry, -1) && download_range(entry))
+	{
+		GPlayerDEBUG("prefetch of %s paused at %u bytes", entry->uri, entry->data->len);
+	}
+	GPlayerDEBUG("prefetched %u bytes of %s", entry->data->len, entry->uri);
+}
+
+static gpointer prefetch_thread(gpointer unused)
+{
+	PrefetchEntry *entry;
+
+	g_mutex_lock(&prefetch_lock);
+	for (;;)
+	{
+		while (!(entry = g_queue_pop_head(&pending)))
+			g_cond_wait(&prefetch_cond, &prefetch_lock);
+		entry_ref(entry);
+		g_mutex_unlock(&prefetch_lock);
+
+		download(entry);
+
+		g_mutex_lock(&prefetch_lock);
+		entry_unref(entry);
+	}
+	return NULL;
+}
+
+void prefetch_add(const gchar *uri, gsize bytes)
+{
+	PrefetchEntry *entry;
+
+	bytes = MIN(bytes, PREFETCH_MAX_BYTES);
+	if (!is_http(uri) || bytes == 0)
+		return;
+
+	g_mutex_lock(&prefetch_lock);
+	if (!g_hash_table_contains(entries, uri))
+	{
+		entry = g_new0(PrefetchEntry, 1);
+		entry->refcount = 1;
+		entry->uri = g_strdup(uri);
+		entry->data = g_byte_array_new();
+		entry->wanted = bytes;
+		entry->total = -1;
+		g_hash_table_insert(entries, entry->uri, entry);
+		g_queue_push_tail(&all, entry);
+		g_queue_push_tail(&pending, entry);
+		requests++;
+
+		while (g_queue_get_length(&all) > PREFETCH_MAX_ENTRIES)
+		{
+			PrefetchEntry *oldest = g_queue_pop_head(&all);
+			if (!oldest->used)
+				wasted_bytes += oldest->data->len;
+			oldest->evicted = TRUE;
+			g_queue_remove(&pending, oldest);
+			g_hash_table_remove(entries, oldest->uri);
+		}
+		g_cond_signal(&prefetch_cond);
+	}
+	g_mutex_unlock(&prefetch_lock);
+}
+
+gchar *prefetch_claim(const gchar *uri)
+{
+	PrefetchEntry *entry;
+
+	if (!is_http(uri))
+		return NULL;
+
+	g_mutex_lock(&prefetch_lock);
+	entry = g_hash_table_lookup(entries, uri);
+	if (entry)
+	{
+		/* Its download ends here, what it got so far is played */
+		g_queue_remove(&pending, entry);
+		if (entry->data->len > 0 && entry->total > 0 && !entry->used)
+			hits++;
+		entry->used = TRUE;
+		g_cond_broadcast(&prefetch_cond);
+	}
+	g_mutex_unlock(&prefetch_lock);
+	return g_strconcat(SCHEME_PREFIX, uri, NULL);
+}
+
+void prefetch_set_foreground_busy(gboolean busy)
+{
+	g_mutex_lock(&prefetch_lock);
+	foreground_busy = busy;
+	if (!busy)
+		g_cond_broadcast(&prefetch_cond);
+	g_mutex_unlock(&prefetch_lock);
+}
+
+const gchar *prefetch_get_original_uri(const gchar *uri)
+{
+	if (uri && g_str_has_prefix(uri, SCHEME_PREFIX) && is_http(uri + strlen(SCHEME_PREFIX)))
+		return uri + strlen(SCHEME_PREFIX);
+	return uri;
+}
+
+void prefetch_get_stats(guint64 *requests_out, guint64 *hits_out, guint64 *wasted_bytes_out)
+{
+	g_mutex_lock(&prefetch_lock);
+	*requests_out = requests;
+	*hits_out = hits;
+	*wasted_bytes_out = wasted_bytes;
+	g_mutex_unlock(&prefetch_lock);
+}
+
+/*
+ * Source element playing an http(s) uri, prefetched or not
+ */
+
+typedef struct _PrefetchSrc
+{
+	GstBaseSrc parent;
+	gchar *uri;
+	PrefetchEntry *entry;
+	SoupMessage *msg;
+	GInputStream *stream;
+	guint64 stream_offset;
+	gint64 size;
+	/* Prefetched bytes are only served for an entry that got some of a file of known size */
+	gboolean use_entry;
+	gboolean headers_sent;
+	GCancellable *cancellable;
+} PrefetchSrc;
+
+typedef struct _PrefetchSrcClass
+{
+	GstBaseSrcClass parent_class;
+} PrefetchSrcClass;
+
+static void prefetch_src_uri_handler_init(gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE(PrefetchSrc, prefetch_src, GST_TYPE_BASE_SRC,
+		G_IMPLEMENT_INTERFACE(GST_TYPE_URI_HANDLER, prefetch_src_uri_handler_init));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+/* The uri without our scheme prefix */
+static const gchar *http_uri(PrefetchSrc *self)
+{
+	return self->uri + strlen(SCHEME_PREFIX);
+}
+
+static void close_stream(PrefetchSrc *self)
+{
+	if (self->stream)
+	{
+		g_input_stream_close(self->stream, NULL, NULL);
+		g_object_unref(self->stream);
+		self->stream = NULL;
+	}
+	if (self->msg)
+	{
+		g_object_unref(self->msg);
+		self->msg = NULL;
+	}
+}
+
+/* A server ignoring the range sends the file from its start, up to offset it is dropped */
+static gboolean skip_to(PrefetchSrc *self, guint64 offset)
+{
+	GError *error = NULL;
+	gssize n;
+
+	GPlayerDEBUG("%s ignored the range, skipping %" G_GUINT64_FORMAT " bytes", http_uri(self), offset);
+	while (offset > 0)
+	{
+		n = g_input_stream_skip(self->stream, MIN(offset, G_MAXSSIZE), self->cancellable, &error);
+		if (n <= 0)
+		{
+			GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not read %s", http_uri(self)), ("%s", error ? error->message : "end of stream"));
+			g_clear_error(&error);
+			return FALSE;
+		}
+		offset -= n;
+	}
+	return TRUE;
+}
+
+/* An ICY radio sends its metadata every metadata-interval bytes, for icydemux. Its name and genre are tags. */
+static void handle_icy(PrefetchSrc *self)
+{
+	SoupMessageHeaders *headers = self->msg->response_headers;
+	const gchar *interval = soup_message_headers_get_one(headers, "icy-metaint");
+	const gchar *value;
+	GstTagList *tags = NULL;
+	GstCaps *caps;
+	guint i;
+
+	if (!interval || g_ascii_strtoll(interval, NULL, 10) <= 0)
+		return;
+	caps = gst_caps_new_simple("application/x-icy", "metadata-interval", G_TYPE_INT, (gint) g_ascii_strtoll(interval, NULL, 10), NULL);
+	gst_base_src_set_caps(GST_BASE_SRC(self), caps);
+	gst_caps_unref(caps);
+
+	for (i = 0; i < G_N_ELEMENTS(icy_tags); i++)
+	{
+		if (!(value = soup_message_headers_get_one(headers, icy_tags[i][0])) || !*value)
+			continue;
+		if (!tags)
+			tags = gst_tag_list_new_empty();
+		gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, icy_tags[i][1], value, NULL);
+	}
+	if (tags)
+		gst_pad_push_event(GST_BASE_SRC_PAD(self), gst_event_new_tag(tags));
+}
+
+/* Continue the download where the prefetched bytes end, or wherever we were seeked to */
+static gboolean open_stream(PrefetchSrc *self, guint64 offset)
+{
+	GError *error = NULL;
+	goffset start, end, total;
+	gboolean icy = offset == 0 && !self->use_entry;
+
+	close_stream(self);
+	self->msg = soup_message_new("GET", http_uri(self));
+	if (!self->msg)
+	{
+		GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, ("Invalid uri %s", http_uri(self)), (NULL));
+		return FALSE;
+	}
+	if (offset > 0)
+		soup_message_headers_set_range(self->msg->request_headers, offset, -1);
+	/* Like souphttpsrc in its default iradio-mode, but not continuing a prefetch made without */
+	if (icy)
+		soup_message_headers_append(self->msg->request_headers, "icy-metadata", "1");
+	http_mark_playback(self->msg);
+
+	self->stream = soup_session_send(http_get_session(), self->msg, self->cancellable, &error);
+	if (!self->stream)
+	{
+		/* No response at all, not refused by the server: the player reconnects after a READ error, and after
+		 * NOT_FOUND for a name lookup once it is reconnecting */
+		if (g_error_matches(error, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND) || g_error_matches(error, SOUP_HTTP_ERROR, SOUP_STATUS_CANT_RESOLVE))
+			GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, ("Could not resolve %s", http_uri(self)), ("%s", error->message));
+		else
+			GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not connect to %s", http_uri(self)), ("%s", error->message));
+		g_error_free(error);
+		return FALSE;
+	}
+	if (self->msg->status_code != SOUP_STATUS_OK && self->msg->status_code != SOUP_STATUS_PARTIAL_CONTENT)
+	{
+		/* Worded like souphttpsrc, the player takes the status from it */
+		GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, ("Could not open %s", http_uri(self)),
+				("%s (%u), URL: %s, offset %" G_GUINT64_FORMAT, self->msg->reason_phrase, self->msg->status_code, http_uri(self), offset));
+		close_stream(self);
+		return FALSE;
+	}
+	if (offset > 0 && self->msg->status_code == SOUP_STATUS_OK && !skip_to(self, offset))
+	{
+		close_stream(self);
+		return FALSE;
+	}
+
+	/* A live stream has no Content-Length */
+	if (self->size < 0)
+	{
+		if (self->msg->status_code == SOUP_STATUS_PARTIAL_CONTENT && soup_message_headers_get_content_range(self->msg->response_headers, &start, &end, &total))
+			self->size = total;
+		else if (self->msg->status_code == SOUP_STATUS_OK && soup_message_headers_get_encoding(self->msg->response_headers) == SOUP_ENCODING_CONTENT_LENGTH)
+			self->size = soup_message_headers_get_content_length(self->msg->response_headers);
+	}
+	self->stream_offset = offset;
+	if (icy && self->msg->status_code == SOUP_STATUS_OK)
+		handle_icy(self);
+	return TRUE;
+}
+
+/* Tell the response headers like souphttpsrc does, in a message and in a sticky event for the cache */
+static void send_headers(PrefetchSrc *self)
+{
+	GstStructure *response = NULL, *headers;
+
+	g_mutex_lock(&prefetch_lock);
+	if (self->use_entry && self->entry->response_headers)
+		response = gst_structure_copy(self->entry->response_headers);
+	g_mutex_unlock(&prefetch_lock);
+	if (!response && self->msg)
+		response = headers_to_structure(self->msg->response_headers);
+	if (!response)
+		return;
+
+	headers = gst_structure_new("http-headers", "uri", G_TYPE_STRING, http_uri(self), "response-headers", GST_TYPE_STRUCTURE, response, NULL);
+	gst_structure_free(response);
+	gst_element_post_message(GST_ELEMENT(self), gst_message_new_element(GST_OBJECT(self), gst_structure_copy(headers)));
+	gst_pad_push_event(GST_BASE_SRC_PAD(self), gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM_STICKY, headers));
+	self->headers_sent = TRUE;
+}
+
+static gboolean prefetch_src_start(GstBaseSrc *src)
+{
+	PrefetchSrc *self = (PrefetchSrc *) src;
+
+	if (!self->uri)
+	{
+		GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND, ("No uri"), (NULL));
+		return FALSE;
+	}
+
+	g_mutex_lock(&prefetch_lock);
+	self->entry = g_hash_table_lookup(entries, http_uri(self));
+	if (self->entry)
+		entry_ref(self->entry);
+	self->use_entry = self->entry && self->entry->data->len > 0 && self->entry->total > 0;
+	self->size = self->use_entry ? self->entry->total : -1;
+	g_mutex_unlock(&prefetch_lock);
+	self->headers_sent = FALSE;
+
+	self->cancellable = g_cancellable_new();
+	return TRUE;
+}
+
+static gboolean prefetch_src_stop(GstBaseSrc *src)
+{
+	PrefetchSrc *self = (PrefetchSrc *) src;
+
+	close_stream(self);
+	if (self->entry)
+	{
+		entry_unref(self->entry);
+		self->entry = NULL;
+	}
+	g_clear_object(&self->cancellable);
+	return TRUE;
+}
+
+static gboolean prefetch_src_get_size(GstBaseSrc *src, guint64 *size)
+{
+	PrefetchSrc *self = (PrefetchSrc *) src;
+
+	if (self->size < 0)
+		return FALSE;
+	*size = self->size;
+	return TRUE;
+}
+
+static gboolean prefetch_src_is_seekable(GstBaseSrc *src)
+{
+	/* The server answered a range request with the total size */
+	return ((PrefetchSrc *) src)->size >= 0;
+}
+
+/* Limited by the network like souphttpsrc, so uridecodebin buffers it in a queue2 as a stream */
+static gboolean prefetch_src_query(GstBaseSrc *src, GstQuery *query)
+{
+	GstSchedulingFlags flags;
+	gint minsize, maxsize, align;
+
+	if (!GST_BASE_SRC_CLASS(prefetch_src_parent_class)->query(src, query))
+		return FALSE;
+	if (GST_QUERY_TYPE(query) == GST_QUERY_SCHEDULING)
+	{
+		gst_query_parse_scheduling(query, &flags, &minsize, &maxsize, &align);
+		gst_query_set_scheduling(query, flags | GST_SCHEDULING_FLAG_BANDWIDTH_LIMITED, minsize, maxsize, align);
+	}
+	return TRUE;
+}
+
+static GstFlowReturn prefetch_src_create(GstBaseSrc *src, guint64 offset, guint length, GstBuffer **buffer)
+{
+	PrefetchSrc *self = (PrefetchSrc *) src;
+	GError *error = NULL;
+	GstMapInfo map;
+	gssize n;
+
+	if (!self->headers_sent && self->use_entry)
+		send_headers(self);
+	if (self->use_entry)
+	{
+		g_mutex_lock(&prefetch_lock);
+		if (offset < self->entry->data->len)
+		{
+			length = MIN(length, self->entry->data->len - offset);
+			*buffer = gst_buffer_new_allocate(NULL, length, NULL);
+			gst_buffer_fill(*buffer, 0, self->entry->data->data + offset, length);
+			g_mutex_unlock(&prefetch_lock);
+			GST_BUFFER_OFFSET(*buffer) = offset;
+			GST_BUFFER_FLAG_SET(*buffer, PREFETCH_BUFFER_FLAG);
+			return GST_FLOW_OK;
+		}
+		g_mutex_unlock(&prefetch_lock);
+	}
+
+	if (self->size >= 0 && offset >= (guint64) self->size)
+		return GST_FLOW_EOS;
+	if ((!self->stream || self->stream_offset != offset) && !open_stream(self, offset))
+		return GST_FLOW_ERROR;
+	if (!self->headers_sent)
+		send_headers(self);
+
+	*buffer = gst_buffer_new_allocate(NULL, length, NULL);
+	gst_buffer_map(*buffer, &map, GST_MAP_WRITE);
+	n = g_input_stream_read(self->stream, map.data, length, self->cancellable, &error);
+	gst_buffer_unmap(*buffer, &map);
+
+	if (n <= 0)
+	{
+		gst_buffer_unref(*buffer);
+		*buffer = NULL;
+		if (n == 0)
+			return GST_FLOW_EOS;
+		if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_error_free(error);
+			return GST_FLOW_FLUSHING;
+		}
+		GST_ELEMENT_ERROR(self, RESOURCE, READ, ("Could not read %s", http_uri(self)), ("%s", error->message));
+		g_error_free(error);
+		return GST_FLOW_ERROR;
+	}
+
+	gst_buffer_set_size(*buffer, n);
+	GST_BUFFER_OFFSET(*buffer) = offset;
+	self->stream_offset += n;
+	return GST_FLOW_OK;
+}
+
+static gboolean prefetch_src_unlock(GstBaseSrc *src)
+{
+	g_cancellable_cancel(((PrefetchSrc *) src)->cancellable);
+	return TRUE;
+}
+
+static gboolean prefetch_src_unlock_stop(GstBaseSrc *src)
+{
+	PrefetchSrc *self = (PrefetchSrc *) src;
+
+	/* A cancelled read leaves the stream in the middle of nowhere */
+	close_stream(self);
+	g_cancellable_reset(self->cancellable);
+	return TRUE;
+}
+
+static void prefetch_src_finalize(GObject *object)
+{
+	g_free(((PrefetchSrc *) object)->uri);
+	G_OBJECT_CLASS(prefetch_src_parent_class)->finalize(object);
+}
+
+static void prefetch_src_class_init(PrefetchSrcClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS(klass);
+
+	gobject_class->finalize = prefetch_src_finalize;
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_template));
+	gst_element_class_set_static_metadata(element_class, "GPlayer http source", "Source/Network",
+			"Plays a http uri over the shared session, starting with its prefetched bytes", "GPlayer");
+	basesrc_class->start = prefetch_src_start;
+	basesrc_class->stop = prefetch_src_stop;
+	basesrc_class->get_size = prefetch_src_get_size;
+	basesrc_class->is_seekable = prefetch_src_is_seekable;
+	basesrc_class->query = prefetch_src_query;
+	basesrc_class->create = prefetch_src_create;
+	basesrc_class->unlock = prefetch_src_unlock;
+	basesrc_class->unlock_stop = prefetch_src_unlock_stop;
+}
+
+static void prefetch_src_init(PrefetchSrc *self)
+{
+	self->size = -1;
+	gst_base_src_set_format(GST_BASE_SRC(self), GST_FORMAT_BYTES);
+}
+
+static GstURIType prefetch_src_uri_get_type(GType type)
+{
+	return GST_URI_SRC;
+}
+
+static const gchar * const *prefetch_src_uri_get_protocols(GType type)
+{
+	static const gchar *protocols[] = { SCHEME_PREFIX "http", SCHEME_PREFIX "https", NULL };
+	return protocols;
+}
+
+static gchar *prefetch_src_uri_get_uri(GstURIHandler *handler)
+{
+	return g_strdup(((PrefetchSrc *) handler)->uri);
+}
+
+static gboolean prefetch_src_uri_set_uri(GstURIHandler *handler, const gchar *uri, GError **error)
+{
+	PrefetchSrc *self = (PrefetchSrc *) handler;
+
+	if (!g_str_has_prefix(uri, SCHEME_PREFIX))
+	{
+		g_set_error(error, GST_URI_ERROR, GST_URI_ERROR_UNSUPPORTED_PROTOCOL, "Not a prefetched uri: %s", uri);
+		return FALSE;
+	}
+	g_free(self->uri);
+	self->uri = g_strdup(uri);
+	return TRUE;
+}
+
+static void prefetch_src_uri_handler_init(gpointer g_iface, gpointer iface_data)
+{
+	GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+	iface->get_type = prefetch_src_uri_get_type;
+	iface->get_protocols = prefetch_src_uri_get_protocols;
+	iface->get_uri = prefetch_src_uri_get_uri;
+	iface->set_uri = prefetch_src_uri_set_uri;
+}
+
+void prefetch_init(void)
+{
+	entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) entry_unref);
+	gst_element_register(NULL, "gplayerprefetchsrc", GST_RANK_PRIMARY, prefetch_src_get_type());
+	g_thread_unref(g_thread_new("gplayer-prefetch", prefetch_thread, NULL));
+}
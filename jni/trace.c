@@ -0,0 +1,192 @@
+/*
+ * trace.c
+ *
+ *  Per-thread trace rings, how records get into them and how they are dumped as text.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <gst/gst.h>
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+#include "include/trace.h"
+
+typedef struct _TraceRecord
+{
+	gint64 time;
+	guint32 event;
+	gint32 thread;
+	gint64 args[3];
+} TraceRecord;
+
+/* Written only by the thread holding it. A ring outlives its thread and is taken over by the next new one. */
+typedef struct _TraceRing
+{
+	struct _TraceRing *next;
+	gint in_use;
+	gint thread;
+	gchar name[16];
+	/* Records written so far, the next one goes to records[written % TRACE_RING_SIZE]. 32 bits, as only those
+	 * are atomic without a lock on every ABI; it wraps at a multiple of the ring size. */
+	guint written;
+	TraceRecord records[TRACE_RING_SIZE];
+} TraceRing;
+
+static const gchar * const event_names[TRACE_EVENTS] = {
+	[TRACE_ERROR_CODE] = "error-code",
+	[TRACE_NOTIFY_TIME] = "notify-time",
+	[TRACE_PLAYBACK_COMPLETE] = "playback-complete",
+	[TRACE_PLAYBACK_RUNNING] = "playback-running",
+	[TRACE_PREPARE_COMPLETE] = "prepare-complete",
+	[TRACE_INIT_COMPLETE] = "init-complete",
+	[TRACE_METADATA] = "metadata",
+	[TRACE_TRACK_CHANGED] = "track-changed",
+	[TRACE_WORKER] = "worker",
+	[TRACE_NETWORK] = "network",
+	[TRACE_REQUEST_PLAYING] = "request-playing",
+	[TRACE_NO_DATA] = "no-data",
+	[TRACE_SEEK] = "seek",
+	[TRACE_SEEK_LATENCY] = "seek-latency",
+	[TRACE_STALL] = "stall",
+	[TRACE_STARTUP] = "startup",
+	[TRACE_RETRY] = "retry",
+	[TRACE_RECONNECT] = "reconnect",
+	[TRACE_RECOVERED] = "recovered",
+	[TRACE_EOS_HELD] = "eos-held"
+};
+
+/* Every ring ever made, never freed */
+static TraceRing *rings;
+
+static void release_ring(gpointer ring)
+{
+	g_atomic_int_set(&((TraceRing *) ring)->in_use, FALSE);
+}
+
+static GPrivate current_ring = G_PRIVATE_INIT(release_ring);
+
+static TraceRing *claim_ring(void)
+{
+	TraceRing *ring;
+
+	for (ring = g_atomic_pointer_get(&rings); ring; ring = ring->next)
+		if (g_atomic_int_compare_and_exchange(&ring->in_use, FALSE, TRUE))
+			break;
+	if (!ring)
+	{
+		ring = g_new0(TraceRing, 1);
+		ring->in_use = TRUE;
+		do
+			ring->next = g_atomic_pointer_get(&rings);
+		while (!g_atomic_pointer_compare_and_exchange(&rings, ring->next, ring));
+	}
+	ring->thread = syscall(__NR_gettid);
+	memset(ring->name, 0, sizeof(ring->name));
+	prctl(PR_GET_NAME, ring->name, 0, 0, 0);
+	g_private_set(&current_ring, ring);
+	return ring;
+}
+
+void trace_record(TraceEvent event, gint64 a, gint64 b, gint64 c)
+{
+	TraceRing *ring = g_private_get(&current_ring);
+	TraceRecord *record;
+	guint written;
+
+	if (!ring)
+		ring = claim_ring();
+	written = ring->written;
+	record = &ring->records[written % TRACE_RING_SIZE];
+	/* A reader seeing this record overwritten also sees the count of the records before it */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	record->time = g_get_monotonic_time();
+	record->event = event;
+	record->thread = ring->thread;
+	record->args[0] = a;
+	record->args[1] = b;
+	record->args[2] = c;
+	g_atomic_int_set((gint *) &ring->written, written + 1);
+}
+
+/* Copy the records of a ring while its thread may be writing, those it overwrote meanwhile are left out */
+static void copy_ring(TraceRing *ring, GArray *records)
+{
+	guint end = (guint) g_atomic_int_get((gint *) &ring->written);
+	guint start = end - TRACE_RING_SIZE, first = records->len, skipped = 0, overwritten, i;
+
+	for (i = start; i != end; i++)
+	{
+		/* Slots not written yet come first and are zero */
+		if (records->len == first && ring->records[i % TRACE_RING_SIZE].time == 0)
+			skipped++;
+		else
+			g_array_append_val(records, ring->records[i % TRACE_RING_SIZE]);
+	}
+	/* Record i is gone once the writer started on i + TRACE_RING_SIZE, which it may be doing right now */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	overwritten = (guint) g_atomic_int_get((gint *) &ring->written) + 1 - end;
+	if (overwritten > skipped)
+		g_array_remove_range(records, first, MIN(overwritten - skipped, records->len - first));
+}
+
+static gint compare_records(gconstpointer a, gconstpointer b)
+{
+	gint64 ta = ((const TraceRecord *) a)->time, tb = ((const TraceRecord *) b)->time;
+
+	return ta < tb ? -1 : ta > tb;
+}
+
+static const gchar *thread_name(gint thread)
+{
+	TraceRing *ring;
+
+	for (ring = g_atomic_pointer_get(&rings); ring; ring = ring->next)
+		if (ring->thread == thread)
+			return ring->name;
+	return "";
+}
+
+gboolean trace_dump(const gchar *path)
+{
+	GArray *records = g_array_new(FALSE, FALSE, sizeof(TraceRecord));
+	TraceRecord *record;
+	TraceRing *ring;
+	FILE *file = NULL;
+	gchar *line;
+	guint i;
+
+	if (path && !(file = fopen(path, "w")))
+	{
+		g_array_free(records, TRUE);
+		return FALSE;
+	}
+	for (ring = g_atomic_pointer_get(&rings); ring; ring = ring->next)
+		copy_ring(ring, records);
+	g_array_sort(records, compare_records);
+
+	for (i = 0; i < records->len; i++)
+	{
+		record = &g_array_index(records, TraceRecord, i);
+		line = g_strdup_printf("%lld.%06lld %5d %-16s %-18s %lld %lld %lld", (long long) record->time / G_USEC_PER_SEC,
+				(long long) record->time % G_USEC_PER_SEC, record->thread, thread_name(record->thread),
+				record->event < TRACE_EVENTS ? event_names[record->event] : "?", (long long) record->args[0],
+				(long long) record->args[1], (long long) record->args[2]);
+		if (file)
+			fprintf(file, "%s\n", line);
+		else
+#ifdef __ANDROID__
+			__android_log_write(ANDROID_LOG_INFO, "gplayer-trace", line);
+#else
+			fprintf(stderr, "gplayer-trace: %s\n", line);
+#endif
+		g_free(line);
+	}
+
+	g_array_free(records, TRUE);
+	return !file || fclose(file) == 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * bench_convert.c
+ *
+ *  Conversion bypass benchmark. 44.1 kHz S16 stereo audio, which the sink takes as it is, is pushed through
+ *  the chain of the player with audioconvert and audioresample in passthrough, and through the chain the
+ *  player links when it bypasses them. The sink is a fakesink restricted to the caps of the OpenSL ES sink.
+ *  Generated noise is used unless a file is given, whose decoder then has to put out the same format. The
+ *  best of a few runs is kept and the CPU time per second of audio is printed as JSON.
+ *
+ *  Usage: bench-convert [-r runs] [-d seconds] [uri|file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+#include "gain.h"
+
+#define SINK_CAPS "audio/x-raw,format=S16LE,rate=44100,channels=2,layout=interleaved"
+#define NOISE "audiotestsrc wave=white-noise samplesperbuffer=1152 num-buffers=%u ! " SINK_CAPS
+#define FULL_CHAIN "! typefind ! audioconvert ! audioresample ! gplayergain ! " SINK_CAPS " ! fakesink sync=false"
+#define BYPASS_CHAIN "! typefind ! gplayergain ! " SINK_CAPS " ! fakesink sync=false"
+
+typedef struct _ConvertResult
+{
+	gboolean ok;
+	gdouble cpu_seconds;
+	gdouble media_seconds;
+} ConvertResult;
+
+static guint runs = 5;
+static guint seconds = 600;
+static gchar *uri;
+
+static gdouble cpu_time(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void run(const gchar *chain, ConvertResult *result)
+{
+	GError *error = NULL;
+	GstElement *pipeline;
+	GstMessage *message;
+	gchar *description;
+	gint64 position = 0;
+	gdouble start;
+
+	if (uri)
+		description = g_strdup_printf("uridecodebin uri=%s ! " SINK_CAPS " %s", uri, chain);
+	else
+		description = g_strdup_printf(NOISE " %s", (guint) (seconds * 44100 / 1152), chain);
+	pipeline = gst_parse_launch(description, &error);
+	g_free(description);
+	if (!pipeline)
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	start = cpu_time();
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	message = gst_bus_timed_pop_filtered(GST_ELEMENT_BUS(pipeline), GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	result->cpu_seconds = cpu_time() - start;
+	result->ok = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+	if (!result->ok)
+		g_printerr("%s: %s\n", uri ? uri : "noise", "not decoded to " SINK_CAPS);
+	gst_message_unref(message);
+
+	gst_element_query_position(pipeline, GST_FORMAT_TIME, &position);
+	result->media_seconds = (gdouble) position / GST_SECOND;
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+}
+
+static void best_of(const gchar *chain, ConvertResult *best)
+{
+	ConvertResult result;
+	guint i;
+
+	for (i = 0; i < runs; i++)
+	{
+		memset(&result, 0, sizeof(result));
+		run(chain, &result);
+		if (result.ok && (!best->ok || result.cpu_seconds < best->cpu_seconds))
+			*best = result;
+	}
+}
+
+static gdouble cpu_ms_per_second(const ConvertResult *r)
+{
+	return r->media_seconds > 0 ? r->cpu_seconds * 1000 / r->media_seconds : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	ConvertResult full = { 0 }, bypass = { 0 };
+	int i;
+
+	gst_init(&argc, &argv);
+	gain_init();
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			runs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			seconds = atoi(argv[++i]);
+		else if (gst_uri_is_valid(argv[i]))
+			uri = g_strdup(argv[i]);
+		else
+			uri = gst_filename_to_uri(argv[i], NULL);
+	}
+	if (runs == 0 || seconds == 0)
+	{
+		g_printerr("Usage: %s [-r runs] [-d seconds] [uri|file]\n", argv[0]);
+		return 1;
+	}
+
+	best_of(FULL_CHAIN, &full);
+	best_of(BYPASS_CHAIN, &bypass);
+	if (!full.ok || !bypass.ok)
+		return 1;
+
+	g_print("{\n  \"source\": \"%s\", \"format\": \"S16LE 44100 Hz stereo\",\n", uri ? uri : "noise");
+	g_print("  \"passthrough\": { \"cpu_ms_per_media_second\": %.3f, \"media_seconds\": %.1f },\n", cpu_ms_per_second(&full), full.media_seconds);
+	g_print("  \"bypassed\": { \"cpu_ms_per_media_second\": %.3f, \"media_seconds\": %.1f },\n", cpu_ms_per_second(&bypass), bypass.media_seconds);
+	g_print("  \"saved_percent\": %.2f\n}\n", cpu_ms_per_second(&full) > 0 ? (1 - cpu_ms_per_second(&bypass) / cpu_ms_per_second(&full)) * 100 : 0);
+
+	g_free(uri);
+	return 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * bench_decode.c
+ *
+ *  Headless decode throughput benchmark. Every file is played through the chain build_pipeline
+ *  creates (uridecodebin ! queue2 ! typefind ! audioconvert ! audioresample ! volume), ending in
+ *  a fakesink with sync disabled, in its own child process so peak RSS is per file.
+ *  Results are printed as JSON, per file and aggregated per codec.
+ *
+ *  Usage: bench-decode file|directory...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+#define CHAIN "queue2 name=buffer use-buffering=true max-size-bytes=10000000 max-size-buffers=1024 max-size-time=15000000000 " \
+	"! typefind ! audioconvert ! audioresample ! volume ! fakesink name=sink sync=false"
+
+typedef struct _BenchResult
+{
+	gboolean ok;
+	gdouble media_seconds;
+	gdouble wall_seconds;
+	gdouble cpu_seconds;
+	glong peak_rss_kb;
+	guint64 allocations;
+} BenchResult;
+
+typedef struct _CodecTotals
+{
+	gchar *codec;
+	guint files;
+	BenchResult sum;
+} CodecTotals;
+
+/* Count every allocation of the process, GLib and GStreamer included */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static guint64 allocations;
+
+void *malloc(size_t size)
+{
+	__atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+static guint64 decoded_frames;
+static gint decoded_rate;
+
+static GstPadProbeReturn count_frames(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	GstCaps *caps = gst_pad_get_current_caps(pad);
+	GstAudioInfo audio_info;
+
+	if (caps && gst_audio_info_from_caps(&audio_info, caps) && GST_AUDIO_INFO_BPF(&audio_info) > 0)
+	{
+		decoded_frames += gst_buffer_get_size(buffer) / GST_AUDIO_INFO_BPF(&audio_info);
+		decoded_rate = GST_AUDIO_INFO_RATE(&audio_info);
+	}
+	if (caps)
+		gst_caps_unref(caps);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static gdouble cpu_seconds(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/* Runs in the child process */
+static void run_file(const gchar *path, BenchResult *result)
+{
+	GError *error = NULL;
+	GstElement *pipeline, *source, *buffer, *sink;
+	GstPad *pad;
+	GstBus *bus;
+	GstMessage *msg;
+	gchar *uri;
+	gint64 start_time;
+	gdouble start_cpu;
+	guint64 start_allocations;
+	struct rusage usage;
+
+	gst_init(NULL, NULL);
+
+	pipeline = gst_parse_launch("uridecodebin name=source ! " CHAIN, &error);
+	if (!pipeline)
+	{
+		g_printerr("%s: %s\n", path, error->message);
+		g_error_free(error);
+		return;
+	}
+	source = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+	buffer = gst_bin_get_by_name(GST_BIN(pipeline), "buffer");
+	sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+
+	uri = gst_filename_to_uri(path, NULL);
+	g_object_set(source, "uri", uri, NULL);
+	g_free(uri);
+
+	pad = gst_element_get_static_pad(sink, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, count_frames, NULL, NULL);
+	gst_object_unref(pad);
+
+	start_time = g_get_monotonic_time();
+	start_cpu = cpu_seconds();
+	start_allocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	bus = gst_element_get_bus(pipeline);
+	msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+
+	result->wall_seconds = (g_get_monotonic_time() - start_time) / 1e6;
+	result->cpu_seconds = cpu_seconds() - start_cpu;
+	result->allocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - start_allocations;
+	result->media_seconds = decoded_rate > 0 ? (gdouble) decoded_frames / decoded_rate : 0;
+	result->ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS && result->media_seconds > 0;
+
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+	{
+		gst_message_parse_error(msg, &error, NULL);
+		g_printerr("%s: %s\n", path, error->message);
+		g_error_free(error);
+	}
+
+	gst_message_unref(msg);
+	gst_object_unref(bus);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(source);
+	gst_object_unref(buffer);
+	gst_object_unref(sink);
+	gst_object_unref(pipeline);
+
+	getrusage(RUSAGE_SELF, &usage);
+	result->peak_rss_kb = usage.ru_maxrss;
+}
+
+static gboolean bench_file(const gchar *path, BenchResult *result)
+{
+	int fds[2];
+	pid_t pid;
+
+	memset(result, 0, sizeof(BenchResult));
+	if (pipe(fds) != 0)
+		return FALSE;
+
+	pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		run_file(path, result);
+		if (write(fds[1], result, sizeof(BenchResult)) != sizeof(BenchResult))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	if (pid < 0 || read(fds[0], result, sizeof(BenchResult)) != sizeof(BenchResult))
+		result->ok = FALSE;
+	close(fds[0]);
+	if (pid > 0)
+		waitpid(pid, NULL, 0);
+
+	return result->ok;
+}
+
+static gchar *codec_of(const gchar *path)
+{
+	const gchar *dot = strrchr(path, '.');
+	gchar *codec = g_ascii_strdown(dot ? dot + 1 : "unknown", -1);
+
+	if (strcmp(codec, "m4a") == 0 || strcmp(codec, "mp4") == 0)
+	{
+		g_free(codec);
+		codec = g_strdup("aac");
+	}
+	else if (strcmp(codec, "oga") == 0)
+	{
+		g_free(codec);
+		codec = g_strdup("ogg");
+	}
+	return codec;
+}
+
+static void print_metrics(const BenchResult *r)
+{
+	g_print("\"media_seconds\": %.3f, \"wall_seconds\": %.3f, \"realtime_factor\": %.2f, \"cpu_ms_per_second\": %.3f, "
+			"\"peak_rss_kb\": %ld, \"allocations_per_second\": %.1f", r->media_seconds, r->wall_seconds,
+			r->wall_seconds > 0 ? r->media_seconds / r->wall_seconds : 0, r->media_seconds > 0 ? r->cpu_seconds * 1000 / r->media_seconds : 0,
+			r->peak_rss_kb, r->media_seconds > 0 ? r->allocations / r->media_seconds : 0);
+}
+
+static void collect(const gchar *path, GPtrArray *files)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+
+	if (!dir)
+	{
+		g_ptr_array_add(files, g_strdup(path));
+		return;
+	}
+	while ((name = g_dir_read_name(dir)))
+	{
+		gchar *child = g_build_filename(path, name, NULL);
+		collect(child, files);
+		g_free(child);
+	}
+	g_dir_close(dir);
+}
+
+int main(int argc, char *argv[])
+{
+	GPtrArray *files = g_ptr_array_new();
+	GList *totals = NULL, *l;
+	guint i;
+
+	/* Make GLib allocations visible to the malloc counter */
+	g_setenv("G_SLICE", "always-malloc", TRUE);
+
+	for (i = 1; i < (guint) argc; i++)
+		collect(argv[i], files);
+	if (files->len == 0)
+	{
+		g_printerr("Usage: %s file|directory...\n", argv[0]);
+		return 1;
+	}
+
+	g_print("{\n  \"files\": [");
+	for (i = 0; i < files->len; i++)
+	{
+		const gchar *path = g_ptr_array_index(files, i);
+		gchar *codec = codec_of(path);
+		CodecTotals *t = NULL;
+		BenchResult r;
+
+		if (!bench_file(path, &r))
+		{
+			g_printerr("%s: skipped\n", path);
+			g_free(codec);
+			continue;
+		}
+
+		g_print("%s\n    { \"file\": \"%s\", \"codec\": \"%s\", ", totals ? "," : "", path, codec);
+		print_metrics(&r);
+		g_print(" }");
+
+		for (l = totals; l; l = l->next)
+			if (strcmp(((CodecTotals *) l->data)->codec, codec) == 0)
+				t = l->data;
+		if (!t)
+		{
+			t = g_new0(CodecTotals, 1);
+			t->codec = codec;
+			totals = g_list_append(totals, t);
+		}
+		else
+			g_free(codec);
+		t->files++;
+		t->sum.media_seconds += r.media_seconds;
+		t->sum.wall_seconds += r.wall_seconds;
+		t->sum.cpu_seconds += r.cpu_seconds;
+		t->sum.allocations += r.allocations;
+		t->sum.peak_rss_kb = MAX(t->sum.peak_rss_kb, r.peak_rss_kb);
+	}
+	g_print("\n  ],\n  \"codecs\": {");
+	for (l = totals; l; l = l->next)
+	{
+		CodecTotals *t = l->data;
+		g_print("%s\n    \"%s\": { \"files\": %u, ", l == totals ? "" : ",", t->codec, t->files);
+		print_metrics(&t->sum);
+		g_print(" }");
+	}
+	g_print("\n  }\n}\n");
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * bench_gain.c
+ *
+ *  Gain stage benchmark. White noise is pushed through the volume element the player used to have and
+ *  through gplayergain, in S16 and F32, at unity gain, at a balance of different left and right gains
+ *  (averaged for volume, which has only one) and, for gplayergain, while the gains keep changing. Probes
+ *  on both pads of the element time each buffer in the streaming thread. Reports cycles (on x86, from the
+ *  time stamp counter) and nanoseconds per sample as JSON.
+ *
+ *  Usage: bench-gain [-n buffers] [-s samples-per-buffer]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gst/gst.h>
+#include "gain.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define BALANCE_LEFT 0.8
+#define BALANCE_RIGHT 0.5
+/* Buffers between gain changes of the ramping case */
+#define RAMP_PERIOD 4
+
+typedef enum
+{
+	CASE_UNITY,
+	CASE_BALANCE,
+	CASE_RAMPING,
+	CASES
+} GainCase;
+
+static const gchar *case_names[CASES] = { "unity", "balance", "ramping" };
+
+typedef struct _Timing
+{
+	GstElement *element;
+	GainCase gain_case;
+	gint sample_size;
+	guint64 buffers;
+	guint64 samples;
+	guint64 cycles;
+	guint64 nanoseconds;
+	guint64 start_cycles;
+	guint64 start_nanoseconds;
+} Timing;
+
+static guint buffer_count = 20000;
+static guint samples_per_buffer = 1024;
+
+static guint64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static guint64 now_cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* Before the element, also where the ramping case changes the gains */
+static GstPadProbeReturn sink_probe(GstPad *pad, GstPadProbeInfo *info, Timing *timing)
+{
+	if (timing->gain_case == CASE_RAMPING && timing->buffers % RAMP_PERIOD == 0)
+	{
+		gboolean swap = timing->buffers / RAMP_PERIOD % 2;
+
+		g_object_set(timing->element, "left", swap ? BALANCE_RIGHT : BALANCE_LEFT, "right", swap ? BALANCE_LEFT : BALANCE_RIGHT, NULL);
+	}
+	timing->start_nanoseconds = now_ns();
+	timing->start_cycles = now_cycles();
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn src_probe(GstPad *pad, GstPadProbeInfo *info, Timing *timing)
+{
+	guint64 cycles = now_cycles();
+	guint64 nanoseconds = now_ns();
+
+	timing->cycles += cycles - timing->start_cycles;
+	timing->nanoseconds += nanoseconds - timing->start_nanoseconds;
+	timing->samples += gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info)) / timing->sample_size;
+	timing->buffers++;
+	return GST_PAD_PROBE_OK;
+}
+
+static gboolean run(const gchar *factory, const gchar *format, GainCase gain_case, Timing *timing)
+{
+	gchar *description;
+	GstElement *pipeline;
+	GstMessage *message;
+	GstPad *pad;
+	GError *error = NULL;
+	gboolean ok;
+
+	description = g_strdup_printf("audiotestsrc wave=white-noise num-buffers=%u samplesperbuffer=%u "
+			"! audio/x-raw,format=%s,channels=2,rate=44100 ! %s name=gain ! fakesink sync=false",
+			buffer_count, samples_per_buffer, format, factory);
+	pipeline = gst_parse_launch(description, &error);
+	g_free(description);
+	if (!pipeline)
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	memset(timing, 0, sizeof(Timing));
+	timing->element = gst_bin_get_by_name(GST_BIN(pipeline), "gain");
+	timing->gain_case = gain_case;
+	timing->sample_size = g_str_has_prefix(format, "S16") ? 2 : 4;
+	if (gain_case == CASE_BALANCE && strcmp(factory, "volume") == 0)
+		g_object_set(timing->element, "volume", (BALANCE_LEFT + BALANCE_RIGHT) / 2, NULL);
+	else if (gain_case == CASE_BALANCE)
+		g_object_set(timing->element, "left", BALANCE_LEFT, "right", BALANCE_RIGHT, NULL);
+
+	pad = gst_element_get_static_pad(timing->element, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) sink_probe, timing, NULL);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(timing->element, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) src_probe, timing, NULL);
+	gst_object_unref(pad);
+
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	message = gst_bus_timed_pop_filtered(GST_ELEMENT_BUS(pipeline), GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	ok = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+	gst_message_unref(message);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(timing->element);
+	gst_object_unref(pipeline);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	static const gchar *factories[] = { "volume", "gplayergain" };
+	static const gchar *formats[] = { "S16LE", "F32LE" };
+	Timing timing;
+	gboolean first = TRUE;
+	guint f, e, c;
+	int i;
+
+	gst_init(&argc, &argv);
+	gain_init();
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			buffer_count = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			samples_per_buffer = atoi(argv[++i]);
+	}
+	if (buffer_count == 0 || samples_per_buffer == 0)
+	{
+		g_printerr("Usage: %s [-n buffers] [-s samples-per-buffer]\n", argv[0]);
+		return 1;
+	}
+
+	g_print("{\n  \"buffers\": %u, \"samples_per_buffer\": %u, \"channels\": 2,\n  \"results\": [", buffer_count, samples_per_buffer);
+	for (f = 0; f < G_N_ELEMENTS(formats); f++)
+	{
+		for (e = 0; e < G_N_ELEMENTS(factories); e++)
+		{
+			for (c = 0; c < CASES; c++)
+			{
+				if (c == CASE_RAMPING && e == 0)
+					continue;
+				if (!run(factories[e], formats[f], c, &timing) || timing.samples == 0)
+				{
+					g_printerr("%s %s %s: failed\n", factories[e], formats[f], case_names[c]);
+					continue;
+				}
+				g_print("%s\n    { \"element\": \"%s\", \"format\": \"%s\", \"case\": \"%s\", \"ns_per_sample\": %.3f",
+						first ? "" : ",", factories[e], formats[f], case_names[c], (gdouble) timing.nanoseconds / timing.samples);
+#ifdef HAVE_TSC
+				g_print(", \"cycles_per_sample\": %.3f", (gdouble) timing.cycles / timing.samples);
+#endif
+				g_print(" }");
+				first = FALSE;
+			}
+		}
+	}
+	g_print("\n  ]\n}\n");
+	return 0;
+}
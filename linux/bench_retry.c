@@ -0,0 +1,182 @@
+/*
+ * bench_retry.c
+ *
+ *  Flaky network benchmark. A local HTTP server serves a file with range requests, but breaks off every
+ *  connection after a fixed number of bytes. The file is played through gplayer_core to its end, which takes
+ *  a reconnect for every piece of it. Reports the connections, the reconnects and the time they took, and the
+ *  stalls that were heard, as JSON.
+ *
+ *  Usage: bench-retry [-d drop-bytes] [-t seconds] file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include "gplayer_core.h"
+
+static guint drop_bytes = 256 * 1024;
+static guint seconds = 600;
+static gchar *contents;
+static gsize length;
+static gint connections;
+
+static GMainLoop *loop;
+static GPlayerCore *core;
+static gchar *uri;
+static gboolean completed;
+static gint error_code;
+
+/* Answers one GET, from the requested byte on, and closes the connection after drop_bytes */
+static gboolean serve(GThreadedSocketService *service, GSocketConnection *connection, GObject *source_object, gpointer user_data)
+{
+	GDataInputStream *in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+	GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+	gsize start = 0;
+	gchar *line, *header;
+
+	g_data_input_stream_set_newline_type(in, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+	while ((line = g_data_input_stream_read_line(in, NULL, NULL, NULL)) && line[0])
+	{
+		if (g_ascii_strncasecmp(line, "Range: bytes=", 13) == 0)
+			start = MIN(g_ascii_strtoull(line + 13, NULL, 10), length);
+		g_free(line);
+	}
+	g_free(line);
+	g_atomic_int_inc(&connections);
+
+	if (start > 0)
+		header = g_strdup_printf("HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %" G_GSIZE_FORMAT "-%" G_GSIZE_FORMAT "/%"
+				G_GSIZE_FORMAT "\r\n", start, length - 1, length);
+	else
+		header = g_strdup("HTTP/1.1 200 OK\r\n");
+	line = g_strdup_printf("%sContent-Type: application/octet-stream\r\nContent-Length: %" G_GSIZE_FORMAT
+			"\r\nAccept-Ranges: bytes\r\nConnection: close\r\n\r\n", header, length - start);
+	if (g_output_stream_write_all(out, line, strlen(line), NULL, NULL, NULL))
+		g_output_stream_write_all(out, contents + start, MIN(length - start, drop_bytes), NULL, NULL, NULL);
+	g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+
+	g_free(header);
+	g_free(line);
+	g_object_unref(in);
+	return TRUE;
+}
+
+/* Listen on a free port of the loopback interface, the uri to play is returned */
+static gchar *start_server(const gchar *name)
+{
+	GSocketService *service = g_threaded_socket_service_new(4);
+	GSocketAddress *address = g_inet_socket_address_new_from_string("127.0.0.1", 0);
+	GSocketAddress *effective = NULL;
+	GError *error = NULL;
+	gchar *basename, *served;
+
+	if (!g_socket_listener_add_address(G_SOCKET_LISTENER(service), address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL,
+			&effective, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_object_unref(address);
+		return NULL;
+	}
+	g_signal_connect(service, "run", G_CALLBACK(serve), NULL);
+	g_socket_service_start(service);
+
+	/* The extension lets typefinding start from the right guess */
+	basename = g_path_get_basename(name);
+	served = g_strdup_printf("http://127.0.0.1:%u/%s", g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(effective)), basename);
+	g_free(basename);
+	g_object_unref(effective);
+	g_object_unref(address);
+	return served;
+}
+
+static void on_error(gint code, gpointer user_data)
+{
+	if (code < 0)
+	{
+		error_code = code;
+		g_main_loop_quit(loop);
+	}
+}
+
+static void on_playback_complete(gpointer user_data)
+{
+	completed = TRUE;
+	g_main_loop_quit(loop);
+}
+
+static void on_init_complete(gpointer user_data)
+{
+	gplayer_core_set_uri(core, uri, TRUE);
+	gplayer_core_play(core);
+}
+
+static gboolean time_limit_reached(gpointer user_data)
+{
+	g_main_loop_quit(loop);
+	return FALSE;
+}
+
+static const GPlayerCallbacks callbacks = {
+	.error = on_error,
+	.playback_complete = on_playback_complete,
+	.init_complete = on_init_complete
+};
+
+int main(int argc, char *argv[])
+{
+	gint64 snapshot[GPLAYER_SNAPSHOT_SIZE];
+	const gchar *file = NULL;
+	GError *error = NULL;
+	int i;
+
+	gst_init(&argc, &argv);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			drop_bytes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			seconds = atoi(argv[++i]);
+		else
+			file = argv[i];
+	}
+	if (!file || drop_bytes == 0)
+	{
+		g_printerr("Usage: %s [-d drop-bytes] [-t seconds] file\n", argv[0]);
+		return 1;
+	}
+	if (!g_file_get_contents(file, &contents, &length, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	uri = start_server(file);
+	if (!uri)
+		return 1;
+
+	loop = g_main_loop_new(NULL, FALSE);
+	core = gplayer_core_new(&callbacks, NULL);
+	g_timeout_add_seconds(seconds, time_limit_reached, NULL);
+	g_main_loop_run(loop);
+
+	gplayer_core_get_snapshot(core, snapshot, GPLAYER_SNAPSHOT_SIZE);
+	g_print("{\n  \"uri\": \"%s\", \"size\": %" G_GSIZE_FORMAT ", \"drop_bytes\": %u,\n", uri, length, drop_bytes);
+	g_print("  \"completed\": %s, \"error\": %d, \"connections\": %d,\n", completed ? "true" : "false", error_code,
+			g_atomic_int_get(&connections));
+	g_print("  \"retries\": %lld, \"recoveries\": %lld, \"recovery_ms_avg\": %.1f,\n", (long long) snapshot[GPLAYER_SNAPSHOT_RETRIES],
+			(long long) snapshot[GPLAYER_SNAPSHOT_RECOVERIES],
+			snapshot[GPLAYER_SNAPSHOT_RECOVERIES] ? snapshot[GPLAYER_SNAPSHOT_RECOVERY_TIME] / 1000.0 / snapshot[GPLAYER_SNAPSHOT_RECOVERIES] : 0.0);
+	g_print("  \"played_seconds\": %.3f, \"underruns\": %lld, \"rebuffers\": %lld, \"stall_ms\": %.1f\n}\n",
+			snapshot[GPLAYER_SNAPSHOT_PLAYED_TIME] / 1e6, (long long) snapshot[GPLAYER_SNAPSHOT_UNDERRUNS],
+			(long long) snapshot[GPLAYER_SNAPSHOT_REBUFFERS], snapshot[GPLAYER_SNAPSHOT_STALL_TIME] / 1000.0);
+
+	gplayer_core_free(core);
+	g_main_loop_unref(loop);
+	g_free(uri);
+	g_free(contents);
+	return completed ? 0 : 1;
+}
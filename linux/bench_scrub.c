@@ -0,0 +1,236 @@
+/*
+ * bench_scrub.c
+ *
+ *  Scrub storm benchmark. A seek bar drag is replayed as a burst of seeks, every few milliseconds to a
+ *  slightly later position, once straight into a bare pipeline the way the player used to send them, and
+ *  once through gplayer_core_seek, which coalesces them. Reports the flushing seeks that reached the
+ *  pipeline and the time from the last of them to its first audio at the sink, as JSON.
+ *
+ *  Usage: bench-scrub [-n seeks] [-i interval-ms] uri|file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include "gplayer_core.h"
+
+#define CHAIN "queue2 name=buffer use-buffering=true max-size-bytes=10000000 max-size-buffers=1024 max-size-time=15000000000 " \
+	"! typefind ! audioconvert ! audioresample ! volume ! fakesink name=sink sync=true"
+
+/* Where the drag starts and how far it moves per seek */
+#define SCRUB_START (5 * GST_SECOND)
+#define SCRUB_STEP (250 * GST_MSECOND)
+/* Time left after the storm for the last seek to produce audio */
+#define SETTLE_TIME (3 * G_USEC_PER_SEC)
+
+typedef struct _ScrubResult
+{
+	gboolean ok;
+	guint64 requests;
+	guint64 seeks;
+	gdouble latency_ms;
+	gdouble wall_seconds;
+} ScrubResult;
+
+static guint seek_count = 50;
+static guint interval_ms = 20;
+static gchar *uri;
+
+/* Direct mode, first audio after a flush at the sink */
+static gint64 seek_issued = -1;
+static gboolean seek_flushed;
+static gint64 seek_latency = -1;
+static guint64 flushes;
+
+static GstClockTime scrub_position(guint i, GstClockTime duration)
+{
+	GstClockTime position = SCRUB_START + i * SCRUB_STEP;
+
+	if (GST_CLOCK_TIME_IS_VALID(duration) && duration > 0)
+		position %= duration;
+	return position;
+}
+
+static GstPadProbeReturn sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_FLUSH)
+	{
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_FLUSH_STOP)
+		{
+			flushes++;
+			seek_flushed = seek_issued >= 0;
+		}
+		return GST_PAD_PROBE_OK;
+	}
+	if (seek_flushed)
+	{
+		seek_latency = g_get_monotonic_time() - seek_issued;
+		seek_flushed = FALSE;
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+/* Every seek is sent as it comes, from the thread that asked for it */
+static void run_direct(ScrubResult *result)
+{
+	GError *error = NULL;
+	GstElement *pipeline, *source, *sink;
+	GstPad *pad;
+	gint64 duration = GST_CLOCK_TIME_NONE;
+	gint64 start_time;
+	guint i;
+
+	pipeline = gst_parse_launch("uridecodebin name=source ! " CHAIN, &error);
+	if (!pipeline)
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return;
+	}
+	source = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+	sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+	g_object_set(source, "uri", uri, NULL);
+
+	pad = gst_element_get_static_pad(sink, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH, sink_probe, NULL, NULL);
+	gst_object_unref(pad);
+
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	if (gst_element_get_state(pipeline, NULL, NULL, 10 * GST_SECOND) == GST_STATE_CHANGE_SUCCESS)
+	{
+		gst_element_query_duration(pipeline, GST_FORMAT_TIME, &duration);
+		start_time = g_get_monotonic_time();
+		for (i = 0; i < seek_count; i++)
+		{
+			seek_issued = g_get_monotonic_time();
+			seek_flushed = FALSE;
+			gst_element_seek_simple(pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, scrub_position(i, duration));
+			result->requests++;
+			g_usleep(interval_ms * 1000);
+		}
+		g_usleep(SETTLE_TIME);
+
+		result->seeks = flushes;
+		result->latency_ms = seek_latency / 1000.0;
+		result->wall_seconds = (g_get_monotonic_time() - start_time) / 1e6;
+		result->ok = seek_latency >= 0;
+	}
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(source);
+	gst_object_unref(sink);
+	gst_object_unref(pipeline);
+}
+
+/* Engine mode, the storm comes from its own thread like the UI of an application */
+static GMainLoop *loop;
+static GPlayerCore *core;
+static ScrubResult *engine_result;
+static gboolean storm_started;
+
+static gpointer storm_thread(gpointer user_data)
+{
+	GPlayerStats stats;
+	gint64 duration = gplayer_core_get_duration(core) * GST_MSECOND;
+	gint64 start_time = g_get_monotonic_time();
+	guint i;
+
+	for (i = 0; i < seek_count; i++)
+	{
+		gplayer_core_seek(core, scrub_position(i, duration > 0 ? duration : GST_CLOCK_TIME_NONE) / GST_MSECOND);
+		g_usleep(interval_ms * 1000);
+	}
+	g_usleep(SETTLE_TIME);
+
+	gplayer_core_get_stats(core, &stats);
+	engine_result->requests = stats.seek_requests;
+	engine_result->seeks = stats.seeks;
+	engine_result->latency_ms = stats.seek_latency / 1000.0;
+	engine_result->wall_seconds = (g_get_monotonic_time() - start_time) / 1e6;
+	engine_result->ok = stats.seek_latency >= 0;
+
+	g_main_loop_quit(loop);
+	return NULL;
+}
+
+static void on_error(gint code, gpointer user_data)
+{
+	if (code < 0)
+		g_main_loop_quit(loop);
+}
+
+static void on_playback_running(gpointer user_data)
+{
+	if (storm_started)
+		return;
+	storm_started = TRUE;
+	g_thread_unref(g_thread_new("scrub", storm_thread, NULL));
+}
+
+static void on_init_complete(gpointer user_data)
+{
+	gplayer_core_set_uri(core, uri, TRUE);
+	gplayer_core_play(core);
+}
+
+static const GPlayerCallbacks callbacks = {
+	.error = on_error,
+	.playback_running = on_playback_running,
+	.init_complete = on_init_complete
+};
+
+static void run_engine(ScrubResult *result)
+{
+	engine_result = result;
+	loop = g_main_loop_new(NULL, FALSE);
+	core = gplayer_core_new(&callbacks, NULL);
+
+	g_main_loop_run(loop);
+
+	gplayer_core_free(core);
+	g_main_loop_unref(loop);
+}
+
+static void print_result(const gchar *mode, const ScrubResult *r, gboolean last)
+{
+	g_print("    \"%s\": { \"ok\": %s, \"requests\": %llu, \"seeks\": %llu, \"last_seek_latency_ms\": %.1f, \"wall_seconds\": %.3f }%s\n",
+			mode, r->ok ? "true" : "false", (unsigned long long) r->requests, (unsigned long long) r->seeks, r->latency_ms,
+			r->wall_seconds, last ? "" : ",");
+}
+
+int main(int argc, char *argv[])
+{
+	ScrubResult direct = { 0 }, engine = { 0 };
+	int i;
+
+	gst_init(&argc, &argv);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			seek_count = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			interval_ms = atoi(argv[++i]);
+		else if (gst_uri_is_valid(argv[i]))
+			uri = g_strdup(argv[i]);
+		else
+			uri = gst_filename_to_uri(argv[i], NULL);
+	}
+	if (!uri || seek_count == 0)
+	{
+		g_printerr("Usage: %s [-n seeks] [-i interval-ms] uri|file\n", argv[0]);
+		return 1;
+	}
+
+	run_direct(&direct);
+	run_engine(&engine);
+
+	g_print("{\n  \"uri\": \"%s\", \"interval_ms\": %u,\n  \"modes\": {\n", uri, interval_ms);
+	print_result("direct", &direct, FALSE);
+	print_result("engine", &engine, TRUE);
+	g_print("  }\n}\n");
+
+	g_free(uri);
+	return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * bench_seek.c
+ *
+ *  Seek latency and accuracy benchmark over MP3 and ADTS files. Every file is decoded once in full as the
+ *  reference, then seeked to spread out positions with a key unit seek, an accurate seek and a seek through
+ *  the frame index. The time from the seek to its first audio is measured, and the audio found at the
+ *  target is located in the reference to tell how far from the target it really is. Files are read in push
+ *  mode, the way the player reads cached copies. Results are printed as JSON.
+ *
+ *  Usage: bench-seek [-n seeks] file|directory...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include "customdata.h"
+#include "cache.h"
+
+#define CHAIN "audioconvert name=convert ! audio/x-raw,format=S16LE,channels=1 ! fakesink name=sink sync=false"
+/* Samples compared with the reference, and how far around the target they are looked for */
+#define MATCH_WINDOW 256
+#define MATCH_RANGE (2 * GST_SECOND)
+/* Quieter windows match anywhere, such targets are skipped */
+#define MIN_WINDOW_LEVEL 64
+#define SEEK_TIMEOUT (5 * G_USEC_PER_SEC)
+
+typedef enum
+{
+	METHOD_KEY_UNIT,
+	METHOD_ACCURATE,
+	METHOD_INDEXED,
+	METHODS
+} SeekMethod;
+
+static const gchar *method_names[METHODS] = { "key_unit", "accurate", "indexed" };
+
+typedef struct _MethodResult
+{
+	guint seeks;
+	guint failed;
+	gdouble latency_ms;
+	gdouble max_latency_ms;
+	gdouble error_ms;
+	gdouble max_error_ms;
+} MethodResult;
+
+typedef struct _Bench
+{
+	GMutex lock;
+	GCond cond;
+	GstElement *pipeline;
+	GArray *samples;
+	gint rate;
+	/* Collecting the audio of one seek */
+	gboolean armed;
+	gboolean collecting;
+	gboolean done;
+	gint64 seek_time;
+	gint64 first_time;
+	GstClockTime first_pts;
+	guint needed;
+	GstClockTime target;
+	IndexedSeek indexed_seek;
+} Bench;
+
+static guint seek_count = 10;
+
+static GstPadProbeReturn collect_probe(GstPad *pad, GstPadProbeInfo *info, Bench *bench)
+{
+	GstMapInfo map;
+	GstBuffer *buffer;
+	GstCaps *caps;
+
+	g_mutex_lock(&bench->lock);
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_FLUSH)
+	{
+		if (bench->armed && GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_FLUSH_STOP)
+		{
+			bench->armed = FALSE;
+			bench->collecting = TRUE;
+			g_array_set_size(bench->samples, 0);
+			bench->first_pts = GST_CLOCK_TIME_NONE;
+		}
+		g_mutex_unlock(&bench->lock);
+		return GST_PAD_PROBE_OK;
+	}
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	if (bench->rate == 0 && (caps = gst_pad_get_current_caps(pad)))
+	{
+		gst_structure_get_int(gst_caps_get_structure(caps, 0), "rate", &bench->rate);
+		gst_caps_unref(caps);
+	}
+	if (bench->collecting)
+	{
+		if (!GST_CLOCK_TIME_IS_VALID(bench->first_pts))
+		{
+			bench->first_time = g_get_monotonic_time();
+			bench->first_pts = GST_BUFFER_PTS(buffer);
+			bench->needed = MATCH_WINDOW;
+			if (GST_CLOCK_TIME_IS_VALID(bench->target) && bench->target > bench->first_pts)
+				bench->needed += gst_util_uint64_scale(bench->target - bench->first_pts, bench->rate, GST_SECOND);
+		}
+		gst_buffer_map(buffer, &map, GST_MAP_READ);
+		g_array_append_vals(bench->samples, map.data, map.size / sizeof(gint16));
+		gst_buffer_unmap(buffer, &map);
+		if (GST_CLOCK_TIME_IS_VALID(bench->target) && bench->samples->len >= bench->needed)
+		{
+			bench->collecting = FALSE;
+			bench->done = TRUE;
+			g_cond_broadcast(&bench->cond);
+		}
+	}
+	g_mutex_unlock(&bench->lock);
+	return GST_PAD_PROBE_OK;
+}
+
+static GstElement *open_file(const gchar *path, Bench *bench)
+{
+	GstElement *pipeline, *source, *element;
+	GstPad *pad;
+	gchar *file_uri, *uri;
+
+	pipeline = gst_parse_launch("uridecodebin name=source ! " CHAIN, NULL);
+	if (!pipeline)
+		return NULL;
+
+	file_uri = gst_filename_to_uri(path, NULL);
+	uri = g_strconcat(CACHE_SCHEME_PREFIX, file_uri, NULL);
+	source = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+	g_object_set(source, "uri", uri, NULL);
+	gst_object_unref(source);
+	g_free(file_uri);
+	g_free(uri);
+
+	element = gst_bin_get_by_name(GST_BIN(pipeline), "convert");
+	pad = gst_element_get_static_pad(element, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+			(GstPadProbeCallback) indexed_seek_probe, &bench->indexed_seek, NULL);
+	gst_object_unref(pad);
+	gst_object_unref(element);
+
+	element = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+	pad = gst_element_get_static_pad(element, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) collect_probe, bench, NULL);
+	gst_object_unref(pad);
+	gst_object_unref(element);
+
+	return pipeline;
+}
+
+/* The whole file, decoded without seeking */
+static GArray *decode_reference(const gchar *path, Bench *bench)
+{
+	GstElement *pipeline = open_file(path, bench);
+	GstMessage *msg;
+	GstBus *bus;
+	GArray *reference = NULL;
+
+	if (!pipeline)
+		return NULL;
+
+	bench->collecting = TRUE;
+	bench->target = GST_CLOCK_TIME_NONE;
+	g_array_set_size(bench->samples, 0);
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	bus = gst_element_get_bus(pipeline);
+	msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS && bench->rate > 0)
+	{
+		reference = bench->samples;
+		bench->samples = g_array_new(FALSE, FALSE, sizeof(gint16));
+	}
+	bench->collecting = FALSE;
+	gst_message_unref(msg);
+	gst_object_unref(bus);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+	return reference;
+}
+
+/* Where in the reference the window of audio played for the target really starts, -1 if it is not found */
+static gint64 locate(GArray *reference, const gint16 *window, gint64 around, gint rate)
+{
+	gint64 range = gst_util_uint64_scale(MATCH_RANGE, rate, GST_SECOND), first = MAX(around - range, 0);
+	gint64 last = MIN(around + range, (gint64) reference->len - MATCH_WINDOW), position, best = -1;
+	const gint16 *ref = (const gint16 *) reference->data;
+	guint64 best_difference = G_MAXUINT64;
+
+	for (position = first; position <= last; position++)
+	{
+		guint64 difference = 0;
+		guint i;
+
+		for (i = 0; i < MATCH_WINDOW && difference < best_difference; i++)
+			difference += ABS(ref[position + i] - window[i]);
+		if (difference < best_difference)
+		{
+			best_difference = difference;
+			best = position;
+		}
+	}
+	return best;
+}
+
+static gboolean loud_enough(const gint16 *window)
+{
+	guint64 level = 0;
+	guint i;
+
+	for (i = 0; i < MATCH_WINDOW; i++)
+		level += ABS(window[i]);
+	return level >= MATCH_WINDOW * MIN_WINDOW_LEVEL;
+}
+
+static gboolean send_seek(Bench *bench, SeekMethod method, FrameIndex *index, GstClockTime target)
+{
+	switch (method)
+	{
+	case METHOD_KEY_UNIT:
+		return gst_element_seek_simple(bench->pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, target);
+	case METHOD_ACCURATE:
+		return gst_element_seek_simple(bench->pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, target);
+	default:
+		return indexed_seek_start(&bench->indexed_seek, bench->pipeline, index, target);
+	}
+}
+
+/* Seeks the paused pipeline and lets it play until the audio at the target arrived */
+static void bench_seek(Bench *bench, SeekMethod method, FrameIndex *index, GArray *reference, GstClockTime target, MethodResult *result)
+{
+	gint64 deadline, claimed, found;
+	guint start;
+	gboolean ok;
+	gdouble latency_ms, error_ms;
+
+	g_mutex_lock(&bench->lock);
+	bench->armed = TRUE;
+	bench->done = FALSE;
+	bench->target = target;
+	bench->seek_time = g_get_monotonic_time();
+	g_mutex_unlock(&bench->lock);
+
+	ok = send_seek(bench, method, index, target);
+	gst_element_set_state(bench->pipeline, GST_STATE_PLAYING);
+
+	g_mutex_lock(&bench->lock);
+	deadline = g_get_monotonic_time() + SEEK_TIMEOUT;
+	while (ok && !bench->done)
+	{
+		if (!g_cond_wait_until(&bench->cond, &bench->lock, deadline))
+			break;
+	}
+	bench->armed = FALSE;
+	bench->collecting = FALSE;
+	g_mutex_unlock(&bench->lock);
+
+	gst_element_set_state(bench->pipeline, GST_STATE_PAUSED);
+	gst_element_get_state(bench->pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+	result->seeks++;
+	if (!ok || !bench->done)
+	{
+		result->failed++;
+		return;
+	}
+
+	/* The audio the stream claims to be at the target, or its first sample if it starts later */
+	start = bench->needed - MATCH_WINDOW;
+	claimed = gst_util_uint64_scale(MAX(target, bench->first_pts), bench->rate, GST_SECOND);
+	if (!loud_enough((const gint16 *) bench->samples->data + start))
+	{
+		result->seeks--;
+		return;
+	}
+	found = locate(reference, (const gint16 *) bench->samples->data + start, claimed, bench->rate);
+	if (found < 0)
+	{
+		result->failed++;
+		return;
+	}
+
+	/* Starting after the target misses audio as much as playing the wrong audio does */
+	error_ms = ABS(found - claimed) * 1000.0 / bench->rate;
+	if (bench->first_pts > target)
+		error_ms += (bench->first_pts - target) / (gdouble) GST_MSECOND;
+	latency_ms = (bench->first_time - bench->seek_time) / 1000.0;
+
+	result->latency_ms += latency_ms;
+	result->max_latency_ms = MAX(result->max_latency_ms, latency_ms);
+	result->error_ms += error_ms;
+	result->max_error_ms = MAX(result->max_error_ms, error_ms);
+}
+
+static gboolean bench_file(const gchar *path, Bench *bench, MethodResult *results)
+{
+	FrameIndex *index = frame_index_scan_file(path);
+	GArray *reference;
+	GstClockTime duration, target;
+	guint i, method;
+
+	if (!index)
+		return FALSE;
+
+	bench->rate = 0;
+	reference = decode_reference(path, bench);
+	if (!reference)
+	{
+		frame_index_unref(index);
+		return FALSE;
+	}
+	duration = gst_util_uint64_scale(reference->len, GST_SECOND, bench->rate);
+
+	bench->pipeline = open_file(path, bench);
+	gst_element_set_state(bench->pipeline, GST_STATE_PAUSED);
+	gst_element_get_state(bench->pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+	memset(results, 0, sizeof(MethodResult) * METHODS);
+	for (i = 0; i < seek_count; i++)
+	{
+		/* Spread over the file, off the frame grid */
+		target = duration * (i + 1) / (seek_count + 1) + (i * 37 + 11) * GST_MSECOND;
+		for (method = 0; method < METHODS; method++)
+			bench_seek(bench, method, index, reference, target, &results[method]);
+	}
+
+	gst_element_set_state(bench->pipeline, GST_STATE_NULL);
+	gst_object_unref(bench->pipeline);
+	bench->pipeline = NULL;
+	g_array_free(reference, TRUE);
+	frame_index_unref(index);
+	return TRUE;
+}
+
+static void print_results(const MethodResult *results)
+{
+	guint method;
+
+	for (method = 0; method < METHODS; method++)
+	{
+		const MethodResult *r = &results[method];
+		guint measured = r->seeks - r->failed;
+
+		g_print("%s\"%s\": { \"seeks\": %u, \"failed\": %u, \"latency_ms\": %.1f, \"max_latency_ms\": %.1f, \"error_ms\": %.2f, "
+				"\"max_error_ms\": %.2f }", method ? ", " : "", method_names[method], r->seeks, r->failed,
+				measured ? r->latency_ms / measured : 0, r->max_latency_ms, measured ? r->error_ms / measured : 0, r->max_error_ms);
+	}
+}
+
+static void collect(const gchar *path, GPtrArray *files)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+
+	if (!dir)
+	{
+		g_ptr_array_add(files, g_strdup(path));
+		return;
+	}
+	while ((name = g_dir_read_name(dir)))
+	{
+		gchar *child = g_build_filename(path, name, NULL);
+		collect(child, files);
+		g_free(child);
+	}
+	g_dir_close(dir);
+}
+
+int main(int argc, char *argv[])
+{
+	GPtrArray *files = g_ptr_array_new();
+	MethodResult results[METHODS], totals[METHODS];
+	Bench bench;
+	gboolean first = TRUE;
+	guint i, method;
+	int arg;
+
+	gst_init(&argc, &argv);
+	cache_init();
+
+	for (arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+			seek_count = atoi(argv[++arg]);
+		else
+			collect(argv[arg], files);
+	}
+	if (files->len == 0 || seek_count == 0)
+	{
+		g_printerr("Usage: %s [-n seeks] file|directory...\n", argv[0]);
+		return 1;
+	}
+
+	memset(&bench, 0, sizeof(bench));
+	g_mutex_init(&bench.lock);
+	g_cond_init(&bench.cond);
+	bench.samples = g_array_new(FALSE, FALSE, sizeof(gint16));
+	memset(totals, 0, sizeof(totals));
+
+	g_print("{\n  \"files\": [");
+	for (i = 0; i < files->len; i++)
+	{
+		const gchar *path = g_ptr_array_index(files, i);
+
+		if (!bench_file(path, &bench, results))
+		{
+			g_printerr("%s: skipped, no MP3 or ADTS stream\n", path);
+			continue;
+		}
+		g_print("%s\n    { \"file\": \"%s\", ", first ? "" : ",", path);
+		print_results(results);
+		g_print(" }");
+		first = FALSE;
+
+		for (method = 0; method < METHODS; method++)
+		{
+			totals[method].seeks += results[method].seeks;
+			totals[method].failed += results[method].failed;
+			totals[method].latency_ms += results[method].latency_ms;
+			totals[method].error_ms += results[method].error_ms;
+			totals[method].max_latency_ms = MAX(totals[method].max_latency_ms, results[method].max_latency_ms);
+			totals[method].max_error_ms = MAX(totals[method].max_error_ms, results[method].max_error_ms);
+		}
+	}
+	g_print("\n  ],\n  \"total\": { ");
+	print_results(totals);
+	g_print(" }\n}\n");
+
+	return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * bench_startup.c
+ *
+ *  Cold start benchmark of plugin registration. For every plugin profile of jni/Android.mk a fresh process
+ *  initializes GStreamer with a plugin directory holding only the plugins of that profile and an empty
+ *  registry, so each of them is loaded and registered the way the static plugins are in GStreamer.init on
+ *  Android. The system profile takes every installed plugin. Reports the time gst_init took, the resident
+ *  memory before and after it, and whatever the pipeline needs that is missing, as JSON.
+ *
+ *  Usage: bench-startup [-n runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#ifndef PLUGINS_DIR
+#define PLUGINS_DIR "/usr/lib/gstreamer-1.0"
+#endif
+
+typedef struct _Profile
+{
+	const gchar *name;
+	/* As in jni/Android.mk, NULL for all installed plugins */
+	const gchar *plugins;
+} Profile;
+
+static const Profile profiles[] = {
+	{ "audio", "coreelements audioconvert audioresample typefindfunctions autodetect playback soup opensles "
+			"ogg vorbis audioparsers flac icydemux id3demux apetag isomp4 wavparse fragmented mad faad" },
+	{ "baseline", "coreelements audioconvert audioresample typefindfunctions volume autodetect playback tcp soup "
+			"opensles ogg vorbis audioparsers flac icydemux id3demux isomp4 wavparse fragmented id3tag mad faad" },
+	{ "system", NULL }
+};
+
+/* What build_pipeline and the network source create by name */
+static const gchar * const pipeline_elements[] = {
+	"uridecodebin", "queue2", "typefind", "audioconvert", "audioresample", "autoaudiosink", "souphttpsrc"
+};
+
+typedef struct _StartupResult
+{
+	gboolean ok;
+	gint64 init_us;
+	gint64 rss_before_kb;
+	gint64 rss_after_kb;
+	guint plugins;
+	gchar missing_plugins[512];
+	gchar missing_elements[256];
+} StartupResult;
+
+static gint64 resident_kb(void)
+{
+	gchar *status = NULL, *line;
+	gint64 kb = 0;
+
+	if (g_file_get_contents("/proc/self/status", &status, NULL, NULL) && (line = strstr(status, "VmRSS:")))
+		kb = g_ascii_strtoll(line + 6, NULL, 10);
+	g_free(status);
+	return kb;
+}
+
+static void append_name(gchar *list, gsize size, const gchar *name)
+{
+	if (list[0])
+		g_strlcat(list, ",", size);
+	g_strlcat(list, name, size);
+}
+
+/* Link the file of a plugin into dir, the HLS plugin was renamed after 1.6 */
+static gboolean link_plugin(const gchar *name, const gchar *dir)
+{
+	const gchar *file_names[] = { name, strcmp(name, "fragmented") == 0 ? "hls" : NULL };
+	gchar *file, *source, *target;
+	gboolean linked = FALSE;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(file_names) && file_names[i] && !linked; i++)
+	{
+		file = g_strdup_printf("libgst%s.so", file_names[i]);
+		source = g_build_filename(PLUGINS_DIR, file, NULL);
+		target = g_build_filename(dir, file, NULL);
+		linked = g_file_test(source, G_FILE_TEST_EXISTS) && symlink(source, target) == 0;
+		g_free(file);
+		g_free(source);
+		g_free(target);
+	}
+	return linked;
+}
+
+static void remove_dir(const gchar *path)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+	gchar *child;
+
+	while (dir && (name = g_dir_read_name(dir)))
+	{
+		child = g_build_filename(path, name, NULL);
+		if (g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_SYMLINK))
+			remove_dir(child);
+		else
+			g_unlink(child);
+		g_free(child);
+	}
+	if (dir)
+		g_dir_close(dir);
+	g_rmdir(path);
+}
+
+/* Runs in the child process, GStreamer is initialized only here */
+static void run_profile(const Profile *profile, StartupResult *result)
+{
+	gchar *dir = g_dir_make_tmp("bench-startup-XXXXXX", NULL);
+	gchar *plugin_dir, *registry, **names;
+	GstElementFactory *factory;
+	GList *plugins;
+	gint64 start_time;
+	guint i;
+
+	if (!dir)
+		return;
+	plugin_dir = g_build_filename(dir, "plugins", NULL);
+	registry = g_build_filename(dir, "registry.bin", NULL);
+	g_mkdir(plugin_dir, 0700);
+
+	if (profile->plugins)
+	{
+		names = g_strsplit(profile->plugins, " ", -1);
+		for (i = 0; names[i]; i++)
+			if (names[i][0] && !link_plugin(names[i], plugin_dir))
+				append_name(result->missing_plugins, sizeof(result->missing_plugins), names[i]);
+		g_strfreev(names);
+	}
+
+	/* Scanned in this process into a registry of its own, as nothing is cached at a cold start */
+	g_setenv("GST_PLUGIN_SYSTEM_PATH_1_0", profile->plugins ? plugin_dir : PLUGINS_DIR, TRUE);
+	g_unsetenv("GST_PLUGIN_PATH_1_0");
+	g_unsetenv("GST_PLUGIN_PATH");
+	g_setenv("GST_REGISTRY_1_0", registry, TRUE);
+	g_setenv("GST_REGISTRY_FORK", "no", TRUE);
+
+	result->rss_before_kb = resident_kb();
+	start_time = g_get_monotonic_time();
+	gst_init(NULL, NULL);
+	result->init_us = g_get_monotonic_time() - start_time;
+	result->rss_after_kb = resident_kb();
+
+	plugins = gst_registry_get_plugin_list(gst_registry_get());
+	result->plugins = g_list_length(plugins);
+	gst_plugin_list_free(plugins);
+	for (i = 0; i < G_N_ELEMENTS(pipeline_elements); i++)
+	{
+		factory = gst_element_factory_find(pipeline_elements[i]);
+		if (factory)
+			gst_object_unref(factory);
+		else
+			append_name(result->missing_elements, sizeof(result->missing_elements), pipeline_elements[i]);
+	}
+	result->ok = TRUE;
+
+	remove_dir(dir);
+	g_free(registry);
+	g_free(plugin_dir);
+	g_free(dir);
+}
+
+static gboolean bench_profile(const Profile *profile, StartupResult *result)
+{
+	int fds[2];
+	pid_t pid;
+
+	memset(result, 0, sizeof(StartupResult));
+	if (pipe(fds) != 0)
+		return FALSE;
+
+	pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		run_profile(profile, result);
+		if (write(fds[1], result, sizeof(StartupResult)) != sizeof(StartupResult))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	if (pid < 0 || read(fds[0], result, sizeof(StartupResult)) != sizeof(StartupResult))
+		result->ok = FALSE;
+	close(fds[0]);
+	if (pid > 0)
+		waitpid(pid, NULL, 0);
+
+	return result->ok;
+}
+
+static gint compare_times(gconstpointer a, gconstpointer b)
+{
+	gint64 ta = *(const gint64 *) a, tb = *(const gint64 *) b;
+
+	return ta < tb ? -1 : ta > tb;
+}
+
+int main(int argc, char *argv[])
+{
+	StartupResult r, last;
+	gint64 *times;
+	gint64 rss_before, rss_after;
+	guint runs = 5, done, printed = 0, i, j;
+
+	for (i = 1; i < (guint) argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < (guint) argc)
+			runs = atoi(argv[++i]);
+		else
+			runs = 0;
+	}
+	if (runs == 0)
+	{
+		g_printerr("Usage: %s [-n runs]\n", argv[0]);
+		return 1;
+	}
+
+	times = g_new(gint64, runs);
+	g_print("{\n  \"plugins_dir\": \"%s\", \"runs\": %u,\n  \"profiles\": {", PLUGINS_DIR, runs);
+	for (i = 0; i < G_N_ELEMENTS(profiles); i++)
+	{
+		rss_before = rss_after = 0;
+		for (j = 0, done = 0; j < runs; j++)
+		{
+			if (!bench_profile(&profiles[i], &r))
+				continue;
+			times[done++] = r.init_us;
+			last = r;
+			rss_before += r.rss_before_kb;
+			rss_after += r.rss_after_kb;
+		}
+		if (done == 0)
+		{
+			g_printerr("%s: failed\n", profiles[i].name);
+			continue;
+		}
+		qsort(times, done, sizeof(gint64), compare_times);
+		g_print("%s\n    \"%s\": { \"plugins\": %u, \"init_ms_median\": %.2f, \"init_ms_min\": %.2f, \"rss_before_kb\": %lld, "
+				"\"rss_after_kb\": %lld, \"missing_plugins\": \"%s\", \"missing_elements\": \"%s\" }", printed++ ? "," : "",
+				profiles[i].name, last.plugins, times[done / 2] / 1000.0, times[0] / 1000.0, (long long) (rss_before / done),
+				(long long) (rss_after / done), last.missing_plugins, last.missing_elements);
+	}
+	g_print("\n  }\n}\n");
+
+	g_free(times);
+	return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * bench_tap.c
+ *
+ *  PCM tap overhead benchmark. A file is decoded through the chain of the player as fast as it goes, once
+ *  without the tap and once with the probe the player installs on the volume element feeding the ring,
+ *  while another thread drains it the way a visualizer polls it. Reports the CPU time per second of audio
+ *  of both runs, the difference per buffer and the audio the reader missed, as JSON. The best of a few runs
+ *  is kept so the figures do not depend on a cold page cache.
+ *
+ *  Usage: bench-tap [-r runs] [-p poll-ms] [-c capacity] uri|file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+#include "pcmtap.h"
+
+#define CHAIN "queue2 max-size-bytes=10000000 max-size-buffers=1024 max-size-time=15000000000 " \
+	"! typefind ! audioconvert ! audioresample ! volume name=volume ! fakesink name=sink sync=false"
+
+typedef struct _TapResult
+{
+	gboolean ok;
+	gdouble cpu_seconds;
+	gdouble media_seconds;
+	guint64 buffers;
+	guint64 read_bytes;
+	guint64 dropped_bytes;
+} TapResult;
+
+static guint runs = 3;
+static guint poll_ms = 16;
+static gsize capacity = PCM_TAP_DEFAULT_CAPACITY;
+static gchar *uri;
+
+static PcmTap *tap;
+static volatile gint reader_running;
+static guint64 buffers;
+
+static gdouble cpu_time(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/* The same work as pcm_tap_probe of the player, without the checks on its state */
+static GstPadProbeReturn tap_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	GstBuffer *buffer;
+	GstMapInfo map;
+	GstCaps *caps;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+	{
+		if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_CAPS)
+		{
+			gst_event_parse_caps(GST_PAD_PROBE_INFO_EVENT(info), &caps);
+			pcm_tap_set_format(tap, pad, caps);
+		}
+		return GST_PAD_PROBE_OK;
+	}
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	gst_buffer_map(buffer, &map, GST_MAP_READ);
+	pcm_tap_write(tap, map.data, map.size);
+	gst_buffer_unmap(buffer, &map);
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn count_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	buffers++;
+	return GST_PAD_PROBE_OK;
+}
+
+static gpointer reader_thread(gpointer user_data)
+{
+	TapResult *result = user_data;
+	guint8 *frame = g_malloc(capacity);
+
+	while (g_atomic_int_get(&reader_running))
+	{
+		result->read_bytes += pcm_tap_read(tap, frame, capacity);
+		g_usleep(poll_ms * 1000);
+	}
+	result->read_bytes += pcm_tap_read(tap, frame, capacity);
+	g_free(frame);
+	return NULL;
+}
+
+static void run(gboolean with_tap, TapResult *result)
+{
+	GError *error = NULL;
+	GstElement *pipeline, *source, *volume;
+	GstMessage *message;
+	GstPad *pad;
+	GThread *reader = NULL;
+	gint64 position = 0;
+	gdouble start;
+
+	pipeline = gst_parse_launch("uridecodebin name=source ! " CHAIN, &error);
+	if (!pipeline)
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return;
+	}
+	source = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+	volume = gst_bin_get_by_name(GST_BIN(pipeline), "volume");
+	g_object_set(source, "uri", uri, NULL);
+
+	buffers = 0;
+	pad = gst_element_get_static_pad(volume, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, count_probe, NULL, NULL);
+	if (with_tap)
+	{
+		tap = pcm_tap_new(capacity);
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, tap_probe, NULL, NULL);
+		g_atomic_int_set(&reader_running, TRUE);
+		reader = g_thread_new("reader", reader_thread, result);
+	}
+	gst_object_unref(pad);
+
+	start = cpu_time();
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	message = gst_bus_timed_pop_filtered(GST_ELEMENT_BUS(pipeline), GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	result->cpu_seconds = cpu_time() - start;
+	result->ok = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+	gst_message_unref(message);
+
+	gst_element_query_position(pipeline, GST_FORMAT_TIME, &position);
+	result->media_seconds = (gdouble) position / GST_SECOND;
+	result->buffers = buffers;
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	if (reader)
+	{
+		g_atomic_int_set(&reader_running, FALSE);
+		g_thread_join(reader);
+		result->dropped_bytes = tap->header->dropped_bytes;
+		pcm_tap_free(tap);
+		tap = NULL;
+	}
+	gst_object_unref(source);
+	gst_object_unref(volume);
+	gst_object_unref(pipeline);
+}
+
+/* Keeps the run that took the least CPU */
+static void best_of(gboolean with_tap, TapResult *best)
+{
+	TapResult result;
+	guint i;
+
+	for (i = 0; i < runs; i++)
+	{
+		memset(&result, 0, sizeof(result));
+		run(with_tap, &result);
+		if (result.ok && (!best->ok || result.cpu_seconds < best->cpu_seconds))
+			*best = result;
+	}
+}
+
+static gdouble cpu_ms_per_second(const TapResult *r)
+{
+	return r->media_seconds > 0 ? r->cpu_seconds * 1000 / r->media_seconds : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	TapResult off = { 0 }, on = { 0 };
+	int i;
+
+	gst_init(&argc, &argv);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			runs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			poll_ms = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			capacity = atoi(argv[++i]);
+		else if (gst_uri_is_valid(argv[i]))
+			uri = g_strdup(argv[i]);
+		else
+			uri = gst_filename_to_uri(argv[i], NULL);
+	}
+	if (!uri || runs == 0 || capacity == 0)
+	{
+		g_printerr("Usage: %s [-r runs] [-p poll-ms] [-c capacity] uri|file\n", argv[0]);
+		return 1;
+	}
+
+	best_of(FALSE, &off);
+	best_of(TRUE, &on);
+	if (!off.ok || !on.ok)
+	{
+		g_printerr("%s: decoding failed\n", uri);
+		return 1;
+	}
+
+	g_print("{\n  \"uri\": \"%s\", \"poll_ms\": %u, \"capacity\": %lu,\n", uri, poll_ms, (unsigned long) capacity);
+	g_print("  \"off\": { \"cpu_ms_per_media_second\": %.2f, \"buffers\": %llu },\n", cpu_ms_per_second(&off),
+			(unsigned long long) off.buffers);
+	g_print("  \"tap\": { \"cpu_ms_per_media_second\": %.2f, \"buffers\": %llu, \"read_bytes\": %llu, \"dropped_bytes\": %llu },\n",
+			cpu_ms_per_second(&on), (unsigned long long) on.buffers, (unsigned long long) on.read_bytes,
+			(unsigned long long) on.dropped_bytes);
+	g_print("  \"overhead_percent\": %.2f, \"overhead_us_per_buffer\": %.2f\n}\n",
+			cpu_ms_per_second(&off) > 0 ? (cpu_ms_per_second(&on) / cpu_ms_per_second(&off) - 1) * 100 : 0,
+			on.buffers > 0 ? (on.cpu_seconds - off.cpu_seconds * on.media_seconds / off.media_seconds) * 1e6 / on.buffers : 0);
+
+	g_free(uri);
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * gplayer_cli.c
+ *
+ *  Plays a uri through the player engine on a desktop, printing its events and stats.
+ *
+ *  Usage: gplayer-cli [-v] [-c] [-t seconds] [-T trace-file] uri [next-uri]
+ *    -c  buffer compressed data before decoding
+ *    -T  write the trace of the engine to trace-file at exit
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+#include "gplayer_core.h"
+
+static GMainLoop *loop;
+static GPlayerCore *core;
+static const gchar *uri;
+static const gchar *next_uri;
+
+static void on_error(gint code, gpointer user_data)
+{
+	g_print("error: %d\n", code);
+	/* Negative codes are fatal, the others are buffering notifications */
+	if (code < 0)
+		g_main_loop_quit(loop);
+}
+
+static void on_playback_complete(gpointer user_data)
+{
+	g_print("playback complete\n");
+	g_main_loop_quit(loop);
+}
+
+static void on_playback_running(gpointer user_data)
+{
+	g_print("playing\n");
+}
+
+static void on_init_complete(gpointer user_data)
+{
+	gplayer_core_set_uri(core, uri, TRUE);
+	if (next_uri)
+		gplayer_core_set_next_uri(core, next_uri, TRUE);
+	gplayer_core_play(core);
+}
+
+static void on_metadata_update(const GPlayerMetadata *metadata, gpointer user_data)
+{
+	g_print("metadata: title '%s', artist '%s', album '%s', %u bps", metadata->title ? metadata->title : "",
+			metadata->artist ? metadata->artist : "", metadata->album ? metadata->album : "", metadata->bitrate);
+	if (metadata->cover)
+		g_print(", %s cover of %" G_GSIZE_FORMAT " bytes", metadata->cover_type ? metadata->cover_type : "image",
+				gst_buffer_get_size(metadata->cover));
+	g_print("\n");
+}
+
+static void on_track_changed(gpointer user_data)
+{
+	g_print("track changed\n");
+}
+
+static const GPlayerCallbacks callbacks = {
+	.error = on_error,
+	.playback_complete = on_playback_complete,
+	.playback_running = on_playback_running,
+	.init_complete = on_init_complete,
+	.metadata_update = on_metadata_update,
+	.track_changed = on_track_changed
+};
+
+static const gchar *stall_names[GPLAYER_STALL_CAUSES] = { "network", "decode", "seek" };
+
+static const gchar *conversion_names(guint conversions)
+{
+	static gchar names[64];
+
+	names[0] = '\0';
+	if (conversions & GPLAYER_CONVERSION_BYPASSED)
+		g_strlcat(names, "+bypassed", sizeof(names));
+	if (conversions & GPLAYER_CONVERSION_FORMAT)
+		g_strlcat(names, "+format", sizeof(names));
+	if (conversions & GPLAYER_CONVERSION_RESAMPLE)
+		g_strlcat(names, "+resample", sizeof(names));
+	if (conversions & GPLAYER_CONVERSION_GAIN)
+		g_strlcat(names, "+gain", sizeof(names));
+	return names[0] ? names + 1 : "none";
+}
+
+static gboolean print_stats(gpointer user_data)
+{
+	GPlayerStats stats;
+
+	gplayer_core_get_stats(core, &stats);
+	g_print("state: %s, position: %" GST_TIME_FORMAT ", buffer: %3i%% (%u/%u bytes), network: %lld bit/s (%i), worker wakeups: %llu, "
+			"seeks: %llu of %llu requested, %llu indexed (%lld us), conversions: %s\n", gst_element_state_get_name(stats.state), GST_TIME_ARGS(stats.position),
+			stats.buffering_level, stats.queue_level_bytes, stats.queue_max_bytes, (long long) stats.network_bitrate,
+			stats.network_confidence, (unsigned long long) stats.worker_wakeups, (unsigned long long) stats.seeks,
+			(unsigned long long) stats.seek_requests, (unsigned long long) stats.indexed_seeks, (long long) stats.seek_latency,
+			conversion_names(stats.conversions));
+	return TRUE;
+}
+
+static gboolean time_limit_reached(gpointer user_data)
+{
+	g_main_loop_quit(loop);
+	return FALSE;
+}
+
+static gchar *to_uri(const gchar *arg)
+{
+	if (gst_uri_is_valid(arg))
+		return g_strdup(arg);
+	return gst_filename_to_uri(arg, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	guint seconds = 0;
+	const gchar *trace_file = NULL;
+	gboolean compressed = FALSE;
+	GPlayerHttpStats http_stats;
+	gint64 snapshot[GPLAYER_SNAPSHOT_SIZE];
+	guint stalls[GPLAYER_STALL_CAUSES * GPLAYER_STALL_BUCKETS];
+	int i, j;
+
+	gst_init(&argc, &argv);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+			gplayer_core_enable_logging(TRUE);
+		else if (strcmp(argv[i], "-c") == 0)
+			compressed = TRUE;
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			seconds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+			trace_file = argv[++i];
+		else if (!uri)
+			uri = to_uri(argv[i]);
+		else
+			next_uri = to_uri(argv[i]);
+	}
+	if (!uri)
+	{
+		g_printerr("Usage: %s [-v] [-c] [-t seconds] [-T trace-file] uri [next-uri]\n", argv[0]);
+		return 1;
+	}
+
+	loop = g_main_loop_new(NULL, FALSE);
+	core = gplayer_core_new(&callbacks, NULL);
+	gplayer_core_set_compressed_buffering(core, compressed);
+	g_timeout_add_seconds(1, print_stats, NULL);
+	if (seconds > 0)
+		g_timeout_add_seconds(seconds, time_limit_reached, NULL);
+
+	g_main_loop_run(loop);
+
+	gplayer_core_get_snapshot(core, snapshot, GPLAYER_SNAPSHOT_SIZE);
+	g_print("playback: %lld us played, %lld underruns, %lld rebuffers (%lld us stalled, ratio %.4f%%), %lld bytes downloaded, "
+			"decoding %lld us of cpu\n", (long long) snapshot[GPLAYER_SNAPSHOT_PLAYED_TIME], (long long) snapshot[GPLAYER_SNAPSHOT_UNDERRUNS],
+			(long long) snapshot[GPLAYER_SNAPSHOT_REBUFFERS], (long long) snapshot[GPLAYER_SNAPSHOT_STALL_TIME],
+			snapshot[GPLAYER_SNAPSHOT_REBUFFER_RATIO] / 10000.0, (long long) snapshot[GPLAYER_SNAPSHOT_BYTES_DOWNLOADED],
+			(long long) snapshot[GPLAYER_SNAPSHOT_DECODE_CPU_TIME]);
+	g_print("network: %lld reconnects, recovered %lld times in %lld us\n", (long long) snapshot[GPLAYER_SNAPSHOT_RETRIES],
+			(long long) snapshot[GPLAYER_SNAPSHOT_RECOVERIES], (long long) snapshot[GPLAYER_SNAPSHOT_RECOVERY_TIME]);
+	if (next_uri)
+		g_print("gapless: %lld us of silence between the tracks\n", (long long) snapshot[GPLAYER_SNAPSHOT_TRACK_GAP]);
+	gplayer_core_get_stall_histogram(core, stalls);
+	for (i = 0; i < GPLAYER_STALL_CAUSES; i++)
+	{
+		g_print("stalls, %s:", stall_names[i]);
+		for (j = 0; j < GPLAYER_STALL_BUCKETS; j++)
+			g_print(" %u", stalls[i * GPLAYER_STALL_BUCKETS + j]);
+		g_print("\n");
+	}
+	gplayer_core_get_http_stats(&http_stats);
+	g_print("http: %llu requests, %llu connections (resolve %llu us, connect %llu us), %llu tls handshakes (%llu us), "
+			"%llu playback requests\n", (unsigned long long) http_stats.requests, (unsigned long long) http_stats.connections,
+			(unsigned long long) http_stats.resolve_time, (unsigned long long) http_stats.connect_time,
+			(unsigned long long) http_stats.tls_handshakes, (unsigned long long) http_stats.handshake_time,
+			(unsigned long long) http_stats.playback_requests);
+	if (trace_file && !gplayer_core_dump_trace(trace_file))
+		g_printerr("Could not write %s\n", trace_file);
+	gplayer_core_free(core);
+	g_main_loop_unref(loop);
+	return 0;
+}
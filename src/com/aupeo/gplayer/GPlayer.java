@@ -2,6 +2,8 @@ package com.aupeo.gplayer;
 
 import java.io.File;
 import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.text.SimpleDateFormat;
 import java.util.Date;
 import java.util.Locale;
@@ -21,6 +23,87 @@ public class GPlayer {
 	public static final int UNKNOWN_ERROR = -1;
 	public static final int NOT_FOUND = -2;
 	public static final int NOT_SUPPORTED = -3;
+
+	// Startup phases, indexes into getStartupTimes()
+	public static final int STARTUP_SET_DATA_SOURCE = 0;
+	public static final int STARTUP_PIPELINE_READY = 1;
+	public static final int STARTUP_FIRST_BYTE = 2;
+	public static final int STARTUP_TYPE_FOUND = 3;
+	public static final int STARTUP_FIRST_AUDIO = 4;
+	public static final int STARTUP_PLAYING = 5;
+	public static final int STARTUP_PHASES = 6;
+	// Bucket i of the startup histogram counts phases reached within 50 * 2^i
+	// ms, the last bucket everything slower
+	public static final int STARTUP_BUCKETS = 10;
+
+	// Indexes into getStats(), times in microseconds, rates in bits per
+	// second, counters since the player was created
+	public static final int STATS_STATE = 0;
+	public static final int STATS_QUEUE_BYTES = 1;
+	public static final int STATS_QUEUE_TIME = 2;
+	public static final int STATS_BANDWIDTH = 3;
+	public static final int STATS_BANDWIDTH_CONFIDENCE = 4;
+	public static final int STATS_STREAM_BITRATE = 5;
+	// Audio played, times the sink ran dry while playing, times playback
+	// paused to refill, the time lost to both and its share of the played
+	// and stalled time in parts per million. Seeks are left out.
+	public static final int STATS_PLAYED_TIME = 6;
+	public static final int STATS_UNDERRUNS = 7;
+	public static final int STATS_REBUFFERS = 8;
+	public static final int STATS_STALL_TIME = 9;
+	public static final int STATS_REBUFFER_RATIO = 10;
+	// Position in the track, duration and STALL_* cause of the last stall,
+	// -1 before the first
+	public static final int STATS_LAST_STALL_POSITION = 11;
+	public static final int STATS_LAST_STALL_DURATION = 12;
+	public static final int STATS_LAST_STALL_CAUSE = 13;
+	public static final int STATS_BYTES_DOWNLOADED = 14;
+	public static final int STATS_SEEKS = 15;
+	public static final int STATS_SEEK_LATENCY = 16;
+	public static final int STATS_DECODE_CPU_TIME = 17;
+	// Reconnects of the network source after transient errors, the failures
+	// it recovered from and the time from those to the first bytes after
+	// reconnecting
+	public static final int STATS_RETRIES = 18;
+	public static final int STATS_RECOVERIES = 19;
+	public static final int STATS_RECOVERY_TIME = 20;
+	public static final int STATS_CONVERSIONS = 21;
+	// Silence between two tracks at the last switch to the next uri, in
+	// microseconds, -1 before any
+	public static final int STATS_TRACK_GAP = 22;
+	// Followed by the STARTUP_PHASES values of getStartupTimes()
+	public static final int STATS_STARTUP_TIMES = 23;
+	public static final int STATS_SIZE = STATS_STARTUP_TIMES + STARTUP_PHASES;
+	// Flags of STATS_CONVERSIONS
+	public static final int CONVERSION_FORMAT = 1;
+	public static final int CONVERSION_RESAMPLE = 2;
+	public static final int CONVERSION_GAIN = 4;
+	public static final int CONVERSION_BYPASSED = 8;
+
+	// Causes of a stall, see getStallHistogram()
+	public static final int STALL_NETWORK = 0;
+	public static final int STALL_DECODE = 1;
+	public static final int STALL_SEEK = 2;
+	public static final int STALL_CAUSES = 3;
+	// Bucket i of the stall histogram counts stalls shorter than 20 * 2^i ms,
+	// the last bucket everything longer
+	public static final int STALL_BUCKETS = 10;
+
+	// Indexes into getPrefetchStats()
+	public static final int PREFETCH_REQUESTS = 0;
+	public static final int PREFETCH_HITS = 1;
+	public static final int PREFETCH_WASTED_BYTES = 2;
+
+	// Indexes into getHttpStats(), times in microseconds summed over the new
+	// connections
+	public static final int HTTP_REQUESTS = 0;
+	public static final int HTTP_CONNECTIONS = 1;
+	public static final int HTTP_TLS_HANDSHAKES = 2;
+	public static final int HTTP_RESOLVE_TIME = 3;
+	public static final int HTTP_CONNECT_TIME = 4;
+	public static final int HTTP_HANDSHAKE_TIME = 5;
+	// Of the requests, those made playing tracks
+	public static final int HTTP_PLAYBACK_REQUESTS = 6;
 	
 	public interface OnTimeListener {
 		void onTime(int time);
@@ -34,6 +117,15 @@ public class GPlayer {
 		void onGPlayerMetadata(String title, String artist);
 	}
 
+	/**
+	 * All tags of the current stream whenever they change. Strings are null
+	 * while unknown, the bitrate 0. The cover is read-only native memory,
+	 * valid only until the call returns, and null without an image.
+	 */
+	public interface OnGPlayerTagsListener {
+		void onGPlayerTags(String title, String artist, String album, int bitrate, ByteBuffer cover, String coverType);
+	}
+
 	public interface OnPreparedListener {
 		void onPrepared();
 	}
@@ -58,6 +150,10 @@ public class GPlayer {
 		boolean onError(int errorCode);
 	}
 
+	public interface OnTrackChangedListener {
+		void onTrackChanged();
+	}
+
 	public void setOnErrorListener(OnErrorListener listener) {
 		mOnErrorListener = listener;
 	}
@@ -112,6 +208,18 @@ public class GPlayer {
 
 	private OnGPlayerMetadataListener mOnGPlayerMetadataListener;
 
+	public void setOnGPlayerTagsListener(OnGPlayerTagsListener listener) {
+		mOnGPlayerTagsListener = listener;
+	}
+
+	private OnGPlayerTagsListener mOnGPlayerTagsListener;
+
+	public void setOnTrackChangedListener(OnTrackChangedListener listener) {
+		mOnTrackChangedListener = listener;
+	}
+
+	private OnTrackChangedListener mOnTrackChangedListener;
+
 	private native void nativeInit(); // Initialize native code, build pipeline,
 										// etc
 
@@ -131,6 +239,14 @@ public class GPlayer {
 																// of the media
 																// to play
 
+	private native void nativeSetNextUri(String uri, boolean seek); // Pre-roll
+																	// the next
+																	// track
+
+	private native void nativeSetNextUrl(String url, boolean seek); // Pre-roll
+																	// the next
+																	// track
+
 	private native void nativeSetNotifyTime(int time);
 
 	private native int nativeGetPosition();
@@ -153,8 +269,38 @@ public class GPlayer {
 
 	private native void nativeEnableLogging(boolean enable);
 
+	private static native boolean nativeDumpTrace(String path);
+
+	private static native void nativeSetCacheSize(long bytes);
+
+	private static native void nativePrefetch(String url, int amount, boolean seconds);
+
+	private static native void nativeGetPrefetchStats(long[] stats);
+
+	private static native void nativeGetHttpStats(long[] stats);
+
 	private native void nativeNetworkChange(boolean fast);
 
+	private native void nativeSetCompressedBuffering(boolean enable);
+
+	private native ByteBuffer nativeEnablePcmTap(int capacity);
+
+	private native void nativeDisablePcmTap();
+
+	private static native long nativePcmTapWriteIndex(ByteBuffer memory);
+
+	private static native void nativePcmTapSetReadIndex(ByteBuffer memory, long read);
+
+	private static native long nativePcmTapDroppedBytes(ByteBuffer memory);
+
+	private native void nativeGetStartupTimes(long[] times);
+
+	private native void nativeGetStartupHistogram(int[] counts);
+
+	private native void nativeGetStallHistogram(int[] counts);
+
+	private native void nativeGetStats(long[] stats);
+
 	private static native boolean nativeClassInit(); // Initialize native class:
 														// cache Method IDs for
 														// callbacks
@@ -168,6 +314,8 @@ public class GPlayer {
 
 	private Process logcat_process;
 
+	private PcmTap pcmTap;
+
 	public GPlayer(Context context) {
 		this.context = context;
 		instance = this;
@@ -235,6 +383,22 @@ public class GPlayer {
 		}
 	}
 
+	/*
+	 * Prepares the track that follows the current one. It is played without a
+	 * gap when the current track ends, onTrackChanged is called instead of
+	 * onPlayComplete then. setDataSource drops it.
+	 */
+	public void setNextDataSource(String uri, boolean seek) {
+		if (uri.contains("mms://")) {
+			onError(NOT_SUPPORTED);
+		}
+		if (uri.contains("http://") || uri.contains("https://")) {
+			nativeSetNextUrl(uri, seek);
+		} else {
+			nativeSetNextUri(uri, seek);
+		}
+	}
+
 	public void setNotifyTime(int time) {
 		nativeSetNotifyTime(time);
 	}
@@ -285,6 +449,13 @@ public class GPlayer {
 		mOnCompletionListener.onCompletion();
 	}
 
+	public void onTrackChanged() {
+		Log.d("GPlayer", "onTrackChanged");
+		if (mOnTrackChangedListener != null) {
+			mOnTrackChangedListener.onTrackChanged();
+		}
+	}
+
 	public void onGPlayerReady() {
 		Log.d("GPlayer", "onGPlayerReady");
 		mOnGPlayerReadyListener.onGPlayerReady();
@@ -300,13 +471,16 @@ public class GPlayer {
 		mOnPlayStartedListener.onPlayback();
 	}
 
-	public void onMetadata(String string) {
-		Log.d("GPlayer", "onMetadata '" + string + "'");
+	// Called from native code with the merged tags, an ICY title is already
+	// split into artist and title
+	public void onMetadata(String title, String artist, String album, int bitrate, ByteBuffer cover, String coverType) {
+		Log.d("GPlayer", "onMetadata '" + artist + "' - '" + title + "'");
 		if (mOnGPlayerMetadataListener != null) {
-			String meta[] = string.split("\\ \\-\\ ");
-			mOnGPlayerMetadataListener.onGPlayerMetadata(meta[1], meta[0]);
-		} else {
-			Log.d("GPlayer", "onMetadata NO mOnGPlayerMetadataListener");
+			mOnGPlayerMetadataListener.onGPlayerMetadata(title, artist);
+		}
+		if (mOnGPlayerTagsListener != null) {
+			mOnGPlayerTagsListener.onGPlayerTags(title, artist, album, bitrate, cover != null ? cover.asReadOnlyBuffer() : null,
+					coverType);
 		}
 	}
 
@@ -322,6 +496,48 @@ public class GPlayer {
 		return duration;
 	}
 
+	/*
+	 * Microseconds from setDataSource to each STARTUP_* phase of the current
+	 * track, -1 for phases not reached yet.
+	 */
+	public long[] getStartupTimes() {
+		long[] times = new long[STARTUP_PHASES];
+		nativeGetStartupTimes(times);
+		return times;
+	}
+
+	/*
+	 * Histogram of the startup phases over all tracks of this player,
+	 * STARTUP_BUCKETS counters for each STARTUP_* phase.
+	 */
+	public int[] getStartupHistogram() {
+		int[] counts = new int[STARTUP_PHASES * STARTUP_BUCKETS];
+		nativeGetStartupHistogram(counts);
+		return counts;
+	}
+
+	/*
+	 * Histogram of the stalls over all tracks of this player, STALL_BUCKETS
+	 * counters for each STALL_* cause.
+	 */
+	public int[] getStallHistogram() {
+		int[] counts = new int[STALL_CAUSES * STALL_BUCKETS];
+		nativeGetStallHistogram(counts);
+		return counts;
+	}
+
+	/**
+	 * Fill stats with the STATS_* values in one call, which neither allocates
+	 * nor waits for the streaming threads, so it can be polled. A shorter
+	 * array gets the first values; without one a new array is returned.
+	 */
+	public long[] getStats(long[] stats) {
+		if (stats == null)
+			stats = new long[STATS_SIZE];
+		nativeGetStats(stats);
+		return stats;
+	}
+
 	public void reset() {
 		nativeStop();
 		nativeSetPosition(0);
@@ -337,10 +553,185 @@ public class GPlayer {
 		nativeNetworkChange(fast);
 	}
 
+	/**
+	 * Buffer the stream before decoding it, from the next data source on. The
+	 * size given to setBufferSize() is then in bytes of the stream, so the same
+	 * memory buffers minutes ahead instead of 15 seconds.
+	 */
+	public void setCompressedBuffering(boolean enable) {
+		Log.d("GPlayer", "setCompressedBuffering: " + enable);
+		nativeSetCompressedBuffering(enable);
+	}
+
+	/**
+	 * Start copying the decoded audio into a ring buffer in native memory, for
+	 * a visualizer. The capacity in bytes is fixed by the first call, 0 picks
+	 * 64 KiB. The returned tap stays valid as long as this player.
+	 */
+	public PcmTap enablePcmTap(int capacityBytes) {
+		Log.d("GPlayer", "enablePcmTap: " + capacityBytes);
+		if (pcmTap == null) {
+			ByteBuffer memory = nativeEnablePcmTap(capacityBytes);
+			if (memory != null)
+				pcmTap = new PcmTap(memory);
+		} else
+			nativeEnablePcmTap(capacityBytes);
+		return pcmTap;
+	}
+
+	public void disablePcmTap() {
+		Log.d("GPlayer", "disablePcmTap");
+		nativeDisablePcmTap();
+	}
+
+	/**
+	 * Reader of the decoded audio, to be polled from a single thread. Audio not
+	 * read in time is dropped by the player and counted in getDroppedBytes().
+	 * Layout shared with jni/include/pcmtap.h. The 64 bit indices go through
+	 * native calls, a long read from the buffer may tear on 32 bit ARM and is
+	 * not ordered against the atomics of the writer.
+	 */
+	public static class PcmTap {
+		private static final int READ_INDEX = 8;
+		private static final int FORMAT_SEQUENCE = 24;
+		private static final int RATE = 28;
+		private static final int CHANNELS = 32;
+		private static final int SAMPLE_BITS = 36;
+		private static final int IS_FLOAT = 40;
+		private static final int CAPACITY = 44;
+		private static final int HEADER_SIZE = 64;
+
+		private final ByteBuffer header;
+		private final ByteBuffer ring;
+		private final int capacity;
+		// Only this reader moves it, the native side loads it
+		private long readIndex;
+
+		PcmTap(ByteBuffer memory) {
+			header = memory.order(ByteOrder.nativeOrder());
+			capacity = header.getInt(CAPACITY);
+			readIndex = header.getLong(READ_INDEX);
+			memory.position(HEADER_SIZE);
+			ring = memory.slice();
+			memory.position(0);
+		}
+
+		public int getSampleRate() {
+			return header.getInt(RATE);
+		}
+
+		public int getChannels() {
+			return header.getInt(CHANNELS);
+		}
+
+		public int getSampleBits() {
+			return header.getInt(SAMPLE_BITS);
+		}
+
+		public boolean isFloat() {
+			return header.getInt(IS_FLOAT) != 0;
+		}
+
+		/**
+		 * Changes whenever the format getters do; audio read after a change
+		 * may still be in the previous format for the length of the ring.
+		 */
+		public int getFormatSequence() {
+			return header.getInt(FORMAT_SEQUENCE);
+		}
+
+		public long getDroppedBytes() {
+			return nativePcmTapDroppedBytes(header);
+		}
+
+		/**
+		 * Copy the available audio into dst, interleaved samples in native byte
+		 * order, and return the number of bytes copied. With latest set, older
+		 * audio not fitting into dst is skipped, in whole frames.
+		 */
+		public int read(byte[] dst, boolean latest) {
+			long write = nativePcmTapWriteIndex(header);
+			long read = readIndex;
+			int size = (int) Math.min(write - read, dst.length);
+			int position, first;
+
+			if (latest && write - read > size) {
+				int frame = Math.max(getChannels() * getSampleBits() / 8, 1);
+				size -= size % frame;
+				read = write - size;
+			}
+			position = (int) (read & (capacity - 1));
+			first = Math.min(size, capacity - position);
+			ring.position(position);
+			ring.get(dst, 0, first);
+			ring.position(0);
+			ring.get(dst, first, size - first);
+
+			readIndex = read + size;
+			nativePcmTapSetReadIndex(header, readIndex);
+			return size;
+		}
+	}
+
+	/**
+	 * Limit the cache of downloaded tracks, shared by all players, to the given
+	 * number of bytes. Replayed tracks are then served from the cache directory
+	 * of the application. 0 disables the cache.
+	 */
+	public static void setCacheSize(long bytes) {
+		nativeSetCacheSize(bytes);
+	}
+
+	/**
+	 * Download the first seconds of a track likely to be played soon, so it
+	 * starts almost instantly. Downloads run one at a time in the background
+	 * and wait while any player fills its buffer.
+	 */
+	public static void prefetch(String url, int seconds) {
+		nativePrefetch(url, seconds, true);
+	}
+
+	/**
+	 * Like prefetch(), with the amount given in bytes.
+	 */
+	public static void prefetchBytes(String url, int bytes) {
+		nativePrefetch(url, bytes, false);
+	}
+
+	/**
+	 * Returns PREFETCH_REQUESTS, PREFETCH_HITS and PREFETCH_WASTED_BYTES, over
+	 * all players.
+	 */
+	public static long[] getPrefetchStats() {
+		long[] stats = new long[3];
+		nativeGetPrefetchStats(stats);
+		return stats;
+	}
+
+	/**
+	 * Returns the HTTP_* counters of the session shared by the prefetch and the
+	 * cache. Requests beyond HTTP_CONNECTIONS reused a kept alive connection.
+	 */
+	public static long[] getHttpStats() {
+		long[] stats = new long[7];
+		nativeGetHttpStats(stats);
+		return stats;
+	}
+
 	public void enableLogging(boolean enable) {
 		nativeEnableLogging(enable);
 	}
 
+	/**
+	 * Write the trace of recent engine events, kept for every native thread
+	 * whether logging is enabled or not, to the file at path, or to logcat
+	 * under the tag gplayer-trace when path is null. Returns false if the
+	 * file could not be written.
+	 */
+	public static boolean dumpTrace(String path) {
+		return nativeDumpTrace(path);
+	}
+
 	static {
 		System.loadLibrary("gstreamer_android");
 		System.loadLibrary("gplayer");